@@ -3,16 +3,44 @@
 #include "nob.h"
 
 #define SRC_FOLDER "src/"
-#define CFLAGS "-Wall", "-Wextra", "-lncurses"
+#define CFLAGS "-Wall", "-Wextra", "-lncurses", "-lpthread"
 
 int main(int argc, char **argv) {
     NOB_GO_REBUILD_URSELF(argc, argv);
     Cmd cmd = {0};
 
-    cmd_append(&cmd, "cc", "src/main.c", CFLAGS, "-o", "tired");
+    cmd_append(&cmd, "cc", SRC_FOLDER "main.c", SRC_FOLDER "listing.c", SRC_FOLDER "native.c", SRC_FOLDER "uring.c", SRC_FOLDER "watch.c", SRC_FOLDER "arena.c", SRC_FOLDER "table.c", SRC_FOLDER "sort.c", SRC_FOLDER "du.c", SRC_FOLDER "view.c", SRC_FOLDER "index.c", SRC_FOLDER "walk.c", SRC_FOLDER "find.c", SRC_FOLDER "grep.c", SRC_FOLDER "fuzzy.c", SRC_FOLDER "trigram.c", SRC_FOLDER "hits.c", SRC_FOLDER "ansi.c", SRC_FOLDER "preview.c", SRC_FOLDER "pager.c", CFLAGS, "-o", "tired");
 
     if (!nob_cmd_run_sync_and_reset(&cmd))
         return 1;
 
+    /* ./nob test builds and runs the tests as well */
+    if (argc > 1 && strcmp(argv[1], "test") == 0) {
+
+        cmd_append(&cmd, "cc", "tests/grep_test.c", SRC_FOLDER "grep.c", "-Wall", "-Wextra", "-o", "tests/grep_test");
+        if (!nob_cmd_run_sync_and_reset(&cmd))
+            return 1;
+
+        cmd_append(&cmd, "./tests/grep_test");
+        if (!nob_cmd_run_sync_and_reset(&cmd))
+            return 1;
+
+        cmd_append(&cmd, "cc", "tests/trigram_test.c", SRC_FOLDER "trigram.c", SRC_FOLDER "table.c", SRC_FOLDER "arena.c", SRC_FOLDER "grep.c", "-Wall", "-Wextra", "-o", "tests/trigram_test");
+        if (!nob_cmd_run_sync_and_reset(&cmd))
+            return 1;
+
+        cmd_append(&cmd, "./tests/trigram_test");
+        if (!nob_cmd_run_sync_and_reset(&cmd))
+            return 1;
+
+        cmd_append(&cmd, "cc", "tests/hits_test.c", SRC_FOLDER "hits.c", SRC_FOLDER "fuzzy.c", SRC_FOLDER "trigram.c", SRC_FOLDER "table.c", SRC_FOLDER "arena.c", SRC_FOLDER "grep.c", "-Wall", "-Wextra", "-o", "tests/hits_test");
+        if (!nob_cmd_run_sync_and_reset(&cmd))
+            return 1;
+
+        cmd_append(&cmd, "./tests/hits_test");
+        if (!nob_cmd_run_sync_and_reset(&cmd))
+            return 1;
+    }
+
     return 0;
 }
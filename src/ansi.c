@@ -0,0 +1,390 @@
+/* Copyright 2025 Henryk Szenkowicz Holtman
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files(the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in all copies
+    or
+    substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED “AS IS”,
+    WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "ansi.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define STYLE_MASK (A_BOLD | A_UNDERLINE | A_REVERSE)
+
+/* unchanged cells up to this far apart are written again instead of moving over them */
+#define MAX_BRIDGE 4
+
+static int blank(const ansi_cell *c) {
+
+    return c->ch == ' ' && c->attr == A_NORMAL;
+}
+
+static void emit(ansi_screen *s, const char *bytes, size_t len) {
+
+    if (s->len + len > s->capacity) {
+
+        size_t capacity = s->capacity ? s->capacity : 4096;
+
+        while (s->len + len > capacity) {
+            capacity *= 2;
+        }
+
+        char *out = realloc(s->out, capacity);
+
+        if (!out) {
+            return;
+        }
+
+        s->out = out;
+        s->capacity = capacity;
+    }
+
+    memcpy(s->out + s->len, bytes, len);
+    s->len += len;
+}
+
+static void colors(attr_t attr, short *fg, short *bg) {
+
+    *fg = *bg = -1;
+
+    if (PAIR_NUMBER(attr) != 0) {
+        pair_content(PAIR_NUMBER(attr), fg, bg);
+    }
+}
+
+static int color_code(char *buf, int base, short color) {
+
+    if (color < 0) {
+        return sprintf(buf, ";%d", base + 9);
+    }
+
+    if (color < 8) {
+        return sprintf(buf, ";%d", base + color);
+    }
+
+    return sprintf(buf, ";%d;5;%d", base + 8, color);
+}
+
+/* one SGR sequence from the current attributes to attr. it only adds what attr has in addition,
+ * unless something has to be turned off, then it starts over from 0 */
+static void set_attr(ansi_screen *s, attr_t attr) {
+
+    if (s->attr_known && s->attr == attr) {
+        return;
+    }
+
+    char seq[64] = "\033[";
+    int n = 2;
+    attr_t had = A_NORMAL;
+    short fg, bg, had_fg = -1, had_bg = -1;
+
+    colors(attr, &fg, &bg);
+
+    if (!s->attr_known || (s->attr & ~attr & STYLE_MASK)) {
+
+        n += sprintf(seq + n, "0");
+
+    } else {
+
+        had = s->attr;
+        colors(had, &had_fg, &had_bg);
+    }
+
+    if ((attr & A_BOLD) && !(had & A_BOLD)) {
+        n += sprintf(seq + n, ";1");
+    }
+
+    if ((attr & A_UNDERLINE) && !(had & A_UNDERLINE)) {
+        n += sprintf(seq + n, ";4");
+    }
+
+    if ((attr & A_REVERSE) && !(had & A_REVERSE)) {
+        n += sprintf(seq + n, ";7");
+    }
+
+    if (fg != had_fg) {
+        n += color_code(seq + n, 30, fg);
+    }
+
+    if (bg != had_bg) {
+        n += color_code(seq + n, 40, bg);
+    }
+
+    /* without the leading 0 the list starts with a separator */
+    if (seq[2] == ';') {
+
+        memmove(seq + 2, seq + 3, n - 3);
+        n--;
+    }
+
+    seq[n++] = 'm';
+    emit(s, seq, n);
+
+    s->attr = attr;
+    s->attr_known = 1;
+}
+
+static void move_to(ansi_screen *s, int y, int x) {
+
+    char seq[32];
+
+    if (s->y == y && s->x == x) {
+        return;
+    }
+
+    if (s->y == y && s->x >= 0 && x > s->x) {
+        emit(s, seq, sprintf(seq, "\033[%dC", x - s->x));
+    } else {
+        emit(s, seq, sprintf(seq, "\033[%d;%dH", y + 1, x + 1));
+    }
+
+    s->y = y;
+    s->x = x;
+}
+
+static void put_cell(ansi_screen *s, const ansi_cell *c) {
+
+    set_attr(s, c->attr);
+    emit(s, &c->ch, 1);
+
+    /* past the last column the terminal waits to wrap, where the cursor is depends on it */
+    if (++s->x >= s->cols) {
+        s->x = -1;
+    }
+}
+
+int ansi_open(ansi_screen *s, int rows, int cols) {
+
+    memset(s, 0, sizeof(*s));
+
+    char *cup = tigetstr("cup");
+    char *el = tigetstr("el");
+
+    if (cup == NULL || cup == (char *)-1 || strcmp(cup, "\033[%i%p1%d;%p2%dH") != 0 ||
+        el == NULL || el == (char *)-1 || strcmp(el, "\033[K") != 0) {
+        return -1;
+    }
+
+    ansi_reset(s, rows, cols);
+    return s->shown ? 0 : -1;
+}
+
+void ansi_reset(ansi_screen *s, int rows, int cols) {
+
+    if (rows < 1 || cols < 1) {
+        rows = cols = 1;
+    }
+
+    if (rows != s->rows || cols != s->cols) {
+
+        free(s->shown);
+        free(s->next);
+        free(s->touched);
+        s->shown = malloc((size_t)rows * cols * sizeof(*s->shown));
+        s->next = malloc((size_t)rows * cols * sizeof(*s->next));
+        s->touched = malloc(rows);
+
+        if (!s->shown || !s->next || !s->touched) {
+
+            free(s->shown);
+            free(s->next);
+            free(s->touched);
+            s->shown = s->next = NULL;
+            s->touched = NULL;
+            s->rows = s->cols = 0;
+            return;
+        }
+
+        s->rows = rows;
+        s->cols = cols;
+    }
+
+    for (int i = 0; i < rows * cols; i++) {
+
+        s->shown[i].ch = ' ';
+        s->shown[i].attr = A_NORMAL;
+    }
+
+    memset(s->touched, 0, rows);
+    s->cleared = 1;
+}
+
+static ansi_cell *touch(ansi_screen *s, int y) {
+
+    ansi_cell *line = s->next + (size_t)y * s->cols;
+
+    if (!s->touched[y]) {
+
+        memcpy(line, s->shown + (size_t)y * s->cols, s->cols * sizeof(*line));
+        s->touched[y] = 1;
+    }
+
+    return line;
+}
+
+void ansi_clear(ansi_screen *s, int y, int x, int width) {
+
+    if (y < 0 || y >= s->rows || x < 0) {
+        return;
+    }
+
+    ansi_cell *line = touch(s, y);
+
+    for (int end = x + width < s->cols ? x + width : s->cols; x < end; x++) {
+
+        line[x].ch = ' ';
+        line[x].attr = A_NORMAL;
+    }
+}
+
+void ansi_put(ansi_screen *s, int y, int x, const char *text, int len, attr_t attr) {
+
+    if (y < 0 || y >= s->rows || x < 0) {
+        return;
+    }
+
+    ansi_cell *line = touch(s, y);
+
+    /* a character in the bottom right corner would scroll some terminals */
+    int end = y == s->rows - 1 ? s->cols - 1 : s->cols;
+
+    for (int i = 0; i < len && x < end; i++, x++) {
+
+        unsigned char ch = text[i];
+
+        line[x].ch = ch < 0x20 || ch >= 0x7f ? '?' : ch;
+        line[x].attr = attr & (STYLE_MASK | A_COLOR);
+    }
+}
+
+int ansi_flush(ansi_screen *s, int fd) {
+
+    s->len = 0;
+
+    if (!s->shown) {
+        return -1;
+    }
+
+    /* curses leaves the terminal with normal attributes after a refresh, and so does a flush */
+    s->y = getcury(curscr);
+    s->x = getcurx(curscr);
+    s->attr = A_NORMAL;
+    s->attr_known = 1;
+
+    if (s->cleared) {
+
+        set_attr(s, A_NORMAL);
+        emit(s, "\033[H\033[2J", 7);
+        s->y = s->x = 0;
+        s->cleared = 0;
+    }
+
+    for (int y = 0; y < s->rows; y++) {
+
+        if (!s->touched[y]) {
+            continue;
+        }
+
+        ansi_cell *want = s->next + (size_t)y * s->cols;
+        ansi_cell *has = s->shown + (size_t)y * s->cols;
+
+        /* past its last character the line is cleared with one EL if the terminal has anything there */
+        int end = s->cols;
+
+        while (end > 0 && blank(&want[end - 1])) {
+            end--;
+        }
+
+        for (int x = 0; x < end; x++) {
+
+            if (want[x].ch == has[x].ch && want[x].attr == has[x].attr) {
+                continue;
+            }
+
+            /* a short run of cells that did not change costs less to write again than to skip,
+             * as long as it needs no SGR change of its own */
+            int gap = s->y == y && s->x >= 0 ? x - s->x : -1;
+
+            if (gap > 0 && gap <= MAX_BRIDGE) {
+
+                int same = 1;
+
+                for (int i = s->x; i < x; i++) {
+                    same &= want[i].attr == s->attr;
+                }
+
+                if (same) {
+
+                    for (int i = s->x; i < x; i++) {
+                        put_cell(s, &want[i]);
+                    }
+                }
+            }
+
+            move_to(s, y, x);
+            put_cell(s, &want[x]);
+        }
+
+        for (int x = end; x < s->cols; x++) {
+
+            if (!blank(&has[x])) {
+
+                move_to(s, y, end);
+                set_attr(s, A_NORMAL);
+                emit(s, "\033[K", 3);
+                break;
+            }
+        }
+
+        memcpy(has, want, s->cols * sizeof(*has));
+        s->touched[y] = 0;
+    }
+
+    if (s->len == 0) {
+        return 0;
+    }
+
+    /* curses goes on from where it left the terminal, it is not told about any of this */
+    set_attr(s, A_NORMAL);
+    move_to(s, getcury(curscr), getcurx(curscr));
+
+    size_t done = 0;
+
+    while (done < s->len) {
+
+        ssize_t n = write(fd, s->out + done, s->len - done);
+
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (n < 0) {
+            return -1;
+        }
+
+        done += n;
+        s->writes++;
+    }
+
+    s->frames++;
+    s->bytes += s->len;
+    return 0;
+}
+
+void ansi_close(ansi_screen *s) {
+
+    free(s->shown);
+    free(s->next);
+    free(s->touched);
+    free(s->out);
+    memset(s, 0, sizeof(*s));
+}
@@ -0,0 +1,50 @@
+#ifndef ANSI_H
+#define ANSI_H
+
+#include <ncurses.h>
+
+/* draws the main screen without curses. a frame is built in a copy of the terminal's cells and
+ * only the cells that differ from what the terminal shows are sent, with as few SGR changes as
+ * the attributes allow, in a single write(). curses still reads the keys, draws the popups and
+ * looks the terminal up in terminfo, see DIRECT_OUTPUT in config.h */
+
+typedef struct ansi_cell {
+    attr_t attr; /* A_BOLD, A_UNDERLINE and A_REVERSE with a COLOR_PAIR() */
+    char ch;
+} ansi_cell;
+
+typedef struct ansi_screen {
+    int rows, cols;
+    ansi_cell *shown; /* what the terminal shows */
+    ansi_cell *next;  /* the frame being built, valid in the rows marked in touched */
+    char *touched;
+    int cleared; /* the terminal shows something unknown, the next flush starts by clearing it */
+    char *out;   /* bytes of the frame being sent */
+    size_t len, capacity;
+    int y, x;    /* terminal cursor while they are made, x is -1 when unknown */
+    attr_t attr; /* terminal attributes while they are made */
+    int attr_known;
+    long long frames, bytes, writes;
+} ansi_screen;
+
+/* returns -1 if terminfo does not describe the terminal as one that takes ANSI cursor addressing,
+ * the caller then keeps drawing with curses. call after initscr() */
+int ansi_open(ansi_screen *s, int rows, int cols);
+
+/* forgets what the terminal shows and takes its new size, the next flush clears it */
+void ansi_reset(ansi_screen *s, int rows, int cols);
+
+/* blanks `width` cells of line y from column x on */
+void ansi_clear(ansi_screen *s, int y, int x, int width);
+
+/* writes len bytes of text from column x on, cut at the right edge. anything but printable
+ * ASCII shows as '?', so a name can't send the terminal control sequences */
+void ansi_put(ansi_screen *s, int y, int x, const char *text, int len, attr_t attr);
+
+/* sends what changed since the last flush to fd and leaves the cursor and the attributes where
+ * curses expects them. returns -1 if the write fails */
+int ansi_flush(ansi_screen *s, int fd);
+
+void ansi_close(ansi_screen *s);
+
+#endif
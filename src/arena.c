@@ -0,0 +1,105 @@
+/* Copyright 2025 Henryk Szenkowicz Holtman
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files(the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in all copies
+    or
+    substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED “AS IS”,
+    WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "arena.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* blocks start small so tiny directories stay tiny, and double up to ARENA_MAX_BLOCK */
+#define ARENA_MIN_BLOCK (16 * 1024)
+#define ARENA_MAX_BLOCK (1024 * 1024)
+
+struct arena_block {
+    arena_block *next;
+    size_t size, used;
+    char data[];
+};
+
+void *arena_alloc(arena *a, size_t size) {
+
+    size = (size + 7) & ~(size_t)7;
+
+    arena_block *b = a->head;
+
+    if (!b || b->size - b->used < size) {
+
+        size_t block = b ? b->size * 2 : ARENA_MIN_BLOCK;
+        if (block > ARENA_MAX_BLOCK) {
+            block = ARENA_MAX_BLOCK;
+        }
+        if (block < size) {
+            block = size;
+        }
+
+        b = malloc(sizeof(arena_block) + block);
+        if (!b) {
+            return NULL;
+        }
+
+        b->size = block;
+        b->used = 0;
+        b->next = a->head;
+        a->head = b;
+        a->reserved += sizeof(arena_block) + block;
+    }
+
+    void *p = b->data + b->used;
+    b->used += size;
+    a->used += size;
+    return p;
+}
+
+char *arena_strndup(arena *a, const char *s, size_t len) {
+
+    char *p = arena_alloc(a, len + 1);
+    if (p) {
+        memcpy(p, s, len);
+        p[len] = '\0';
+    }
+    return p;
+}
+
+void arena_merge(arena *into, arena *from) {
+
+    arena_block *tail = from->head;
+    if (!tail) {
+        return;
+    }
+
+    while (tail->next) {
+        tail = tail->next;
+    }
+
+    /* the head of `from` goes first, it is the one with room left */
+    tail->next = into->head;
+    into->head = from->head;
+    into->used += from->used;
+    into->reserved += from->reserved;
+
+    *from = (arena){0};
+}
+
+void arena_free(arena *a) {
+
+    arena_block *b = a->head;
+
+    while (b) {
+
+        arena_block *next = b->next;
+        free(b);
+        b = next;
+    }
+
+    a->head = NULL;
+    a->used = a->reserved = 0;
+}
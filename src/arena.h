@@ -0,0 +1,26 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/* a bump allocator for everything that lives exactly as long as one listing. entries are carved
+ * out of a few big blocks and the whole listing is released with one arena_free() */
+
+typedef struct arena_block arena_block;
+
+typedef struct arena {
+    arena_block *head; /* the block being filled, older ones follow it */
+    size_t used;       /* bytes handed out so far */
+    size_t reserved;   /* bytes held in blocks */
+} arena;
+
+/* 8 byte aligned, never NULL unless malloc fails */
+void *arena_alloc(arena *a, size_t size);
+char *arena_strndup(arena *a, const char *s, size_t len);
+
+/* moves every block of `from` into `into`, what was allocated in either stays where it is */
+void arena_merge(arena *into, arena *from);
+
+void arena_free(arena *a);
+
+#endif
@@ -15,6 +15,114 @@ Configuration file
 /* just keep in mind that it works best with the default flags on (or atleast -F and -l)
  * and requires a '\' (escaped) at the start to ignore any flags in your .bashrc or any shell you might have. */
 
+#define USE_NATIVE_LISTING 1
+
+/* 1 reads directories directly (getdents64 + fstatat) and renders the same columns as LS_COMMAND,
+ * 0 goes back to running LS_COMMAND through a shell for every listing. */
+
+#define USE_IO_URING 0
+#define IO_URING_BATCH 512
+
+/* with the native listing, stat every entry through io_uring (IORING_OP_STATX) keeping up to
+ * IO_URING_BATCH requests in flight. Falls back to plain fstatat() when io_uring is unavailable.
+ * Worth turning on for NFS and other high latency volumes. On a local disk the kernel just runs the
+ * statx calls on its worker threads: with the inodes cached plain fstatat() was 15-50% faster, cold
+ * io_uring only won on a million entries, by about 15%. */
+
+#define LISTING_FIRST_PAINT_MS 50
+#define LISTING_CHUNK 1024
+
+/* listings load on a background thread. Directories that take longer than LISTING_FIRST_PAINT_MS
+ * are shown while they load (unsorted until the listing is complete), LISTING_CHUNK is how many
+ * lines the LS_COMMAND loader hands over at a time. */
+
+#define LISTING_CACHE_BYTES (64 * 1024 * 1024)
+
+/* memory budget for listings of recently visited directories, reused when navigating back as long as
+ * the directory's inode, mtime and ctime did not change. F5 always re-reads. 0 disables it. */
+
+#define USE_INOTIFY 1
+#define WATCH_DEBOUNCE_MS 40
+#define WATCH_MAX_DELAY_MS 1000
+#define WATCH_STORM_EVENTS 512
+
+/* watch the current directory and patch the listing in place when entries are created, deleted,
+ * moved or changed, by tired or any other process. Updates wait for WATCH_DEBOUNCE_MS of quiet
+ * (but no longer than WATCH_MAX_DELAY_MS), more than WATCH_STORM_EVENTS changed names at once
+ * are handled by listing the directory again. */
+
+#define USE_PREFETCH 1
+#define PREFETCH_DELAY_MS 150
+#define PREFETCH_MAX_ENTRIES 20000
+#define PREFETCH_NICE 10
+
+/* list the highlighted directory in the background once the cursor rests on it for PREFETCH_DELAY_MS,
+ * so Enter opens it straight away. Directories with more than PREFETCH_MAX_ENTRIES entries are left
+ * alone, it never runs while the current directory is still loading. Hit rate is on the help screen. */
+
+#define SORT_THREADS 0
+
+/* threads used to sort big listings when changing the sort order with KEY_SORT, 0 means one per
+ * online CPU. Listings below 64k entries are always sorted on one thread. */
+
+#define USE_INDEX 0
+#define INDEX_MIN_ENTRIES 10000
+#define INDEX_MAX_BYTES (512 * 1024 * 1024)
+
+/* keep listings of directories with at least INDEX_MIN_ENTRIES entries in an on-disk index
+ * ($XDG_CACHE_HOME/tired/index) of at most INDEX_MAX_BYTES, so they show up immediately the next
+ * time tired starts in them or opens them. A directory whose mtime moved since is shown from the
+ * index while it is listed again in the background. Format and rules are described in src/index.h. */
+
+#define DU_THREADS 0
+#define DU_REFRESH_MS 250
+
+/* KEY_DU adds up the disk usage of everything below the current directory on DU_THREADS background
+ * threads (0 means four per online CPU, they spend most of their time waiting for the disk) and
+ * shows it next to each directory, updated every DU_REFRESH_MS while it runs. Totals are kept for
+ * the rest of the session, pressing KEY_DU again rescans. */
+
+#define FIND_THREADS 0
+#define FIND_PRUNE ".git:.hg:.svn:node_modules"
+
+/* KEY_FIND_TREE searches every directory below the current one for names containing what was typed, on
+ * FIND_THREADS background threads (0 means four per online CPU). Matches stream in as a listing of
+ * paths that opens like any other, KEY_STOP_FIND stops the search. Directories named in the colon
+ * separated FIND_PRUNE list are not searched, symlinks are never followed. */
+
+#define GREP_MAX_FILE_BYTES (1024LL * 1024 * 1024)
+#define GREP_OPEN_COMMAND "vi +%d %s"
+
+/* KEY_GREP lists every line containing what was typed in the files below the current directory,
+ * KEY_GREP_REGEX every line matching it as an extended regex. Searching shares FIND_THREADS and
+ * FIND_PRUNE. Binary files, files over GREP_MAX_FILE_BYTES (0 for no limit) and files whose path
+ * below the directory is 256 bytes or longer are skipped. Enter on a line runs GREP_OPEN_COMMAND
+ * with its line number and path. */
+
+#define TRIGRAM_MIN_ROWS 50000
+
+/* A search (KEY_SEARCH_1) starting with ' matches the rest of the query as a substring of the names.
+ * Listings of at least TRIGRAM_MIN_ROWS entries (0 for never) answer it from a trigram index of
+ * their names, built by the first such search and kept up to date as entries come and go. */
+
+#define SHOW_PREVIEW 0
+#define PREVIEW_WIDTH 50
+#define PREVIEW_BYTES (16 * 1024)
+#define PREVIEW_CACHE_ENTRIES 64
+
+/* KEY_PREVIEW splits the screen and shows what the highlighted entry holds in the right PREVIEW_WIDTH
+ * percent of it, SHOW_PREVIEW 1 starts with it shown. Files show their first PREVIEW_BYTES, read on a
+ * background thread, directories their names once the prefetch (USE_PREFETCH) listed them. The last
+ * PREVIEW_CACHE_ENTRIES previews are kept while their size and mtime stay the same. */
+
+#define USE_PAGER 1
+#define PAGER_INDEX_STRIDE 256
+
+/* Enter on a text file no command above is set for opens it in the built-in pager instead of xdg-open.
+ * The first screen shows at once however big the file is, its lines are numbered on a background
+ * thread that keeps the offset of every PAGER_INDEX_STRIDE-th one, 8 bytes each, and lets go of the
+ * pages it read. KEY_JUMP goes to a line number there, or with a % that far into the file. */
+
 #define CUSTOM_HOME_PATH "/home/leaomartelo/"
 #define IMAGE_VIEWER_COMMAND "gwenview %s"
 #define VIDEO_PLAYER_COMMAND "mpv %s"
@@ -26,7 +134,24 @@ Configuration file
 /* Change the command to open the file type, you can change the program and add your custom flags.
  * Make sure it has the %s where the file name is supposed to be when you run the command.*/
 
-#define ENTRIES_PER_PAGE 20
+#define ENTRIES_PER_PAGE 0
+/* Entries shown at once. 0 uses every line of the terminal between the top line and the info bar,
+ * and follows the window when it is resized. Any other number is kept as long as the terminal has
+ * room for it. */
+
+#define CONTINUOUS_SCROLL 0
+/* 1 scrolls the listing a line at a time when the cursor leaves the screen, next/previous page then
+ * move by a screenful. 0 flips whole pages. */
+
+#define FRAME_MIN_MS 16
+/* Cursor keys that arrive within this many milliseconds of the last frame are applied together
+ * before the next one is drawn, which caps a held down key at about 60 frames a second. Over a slow
+ * link a bigger value keeps the terminal from falling behind, 100 is fine for a few KB/s. */
+
+#define DIRECT_OUTPUT 0
+/* 1 draws the listing, the info bar and the top and bottom lines without curses: only the cells
+ * that changed go out, with ANSI escapes, in one write() a frame. Popups and key input still go
+ * through curses. Terminals whose terminfo entry has no ANSI cursor addressing keep using curses. */
 
 #define COLOR_DIRECTORY COLOR_BLUE
 #define COLOR_EXECUTABLE COLOR_GREEN
@@ -54,6 +179,16 @@ Configuration file
 #define KEY_OPEN_LOCATION 'l'
 #define KEY_COPY_PATH key_ctrl('a')
 #define KEY_GOTO_PATH key_ctrl('g')
+#define KEY_SORT 's'
+#define KEY_DU 'u'
+#define KEY_FIND_TREE 'F'
+#define KEY_STOP_FIND 'c'
+#define KEY_GREP 'G'
+#define KEY_GREP_REGEX 'R'
+#define KEY_NEXT_MATCH 'N'
+#define KEY_PREV_MATCH 'P'
+#define KEY_REDRAW key_ctrl('l')
+#define KEY_PREVIEW 'v'
 
 /* Ncurses color list:
     COLOR_BLACK
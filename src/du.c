@@ -0,0 +1,589 @@
+/* Copyright 2025 Henryk Szenkowicz Holtman
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files(the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in all copies
+    or
+    substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED “AS IS”,
+    WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "du.h"
+#include "arena.h"
+#include "config.h"
+#include "native.h"
+#include "walk.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define DU_INODE_SHARDS 64
+#define DU_RESULTS_MIN 1024
+
+/* one directory of a scan. the scan reads it once and adds what it found to it and every
+ * directory above, so bytes is always the subtree total as far as it was read */
+typedef struct du_node {
+    struct du_node *parent;
+    struct du_node *next; /* chain of the result table */
+    struct du_scan *scan;
+    uint64_t hash;
+    long long bytes; /* atomic */
+    int pending;     /* its own entries plus child directories still being read, atomic */
+    int rel;         /* where the path below the scan root starts, for openat() */
+    char path[];
+} du_node;
+
+/* (dev, ino) of every multiply linked file seen, so a hard link counts once like with du.
+ * split in shards with their own lock so the workers rarely wait for each other */
+typedef struct inode_shard {
+    pthread_mutex_t lock;
+    uint64_t *keys; /* dev, ino pairs, ino 0 marks a free slot */
+    size_t count, capacity;
+} inode_shard;
+
+typedef struct du_scan {
+    walk walk; /* tasks are du_node */
+    struct du_scan *next;
+    unsigned id;
+    int root_fd;
+    du_node *root;
+    long long dirs; /* directories read, atomic */
+    inode_shard inodes[DU_INODE_SHARDS];
+} du_scan;
+
+/* every node of every scan by absolute path. a node of a newer scan replaces the one of an
+ * older scan, nodes go away together with their scan */
+static pthread_mutex_t results_lock = PTHREAD_MUTEX_INITIALIZER;
+static du_node **results;
+static size_t results_size, results_count;
+
+static du_scan *scans; /* newest first */
+static unsigned last_scan_id;
+static long long last_poll = -1;
+
+static uint64_t hash_bytes(uint64_t hash, const char *s, size_t len) {
+
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ (unsigned char)s[i]) * 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+static uint64_t hash_path(const char *path) {
+
+    return hash_bytes(1469598103934665603ULL, path, strlen(path));
+}
+
+/* dir + "/" + name without doubling the slash after "/" */
+static int join_path(char *out, size_t size, const char *dir, const char *name, int len) {
+
+    size_t dir_len = strlen(dir);
+    int slash = dir_len == 0 || dir[dir_len - 1] != '/';
+
+    if (dir_len + slash + len + 1 > size) {
+        return -1;
+    }
+
+    memcpy(out, dir, dir_len);
+    if (slash) {
+        out[dir_len++] = '/';
+    }
+    memcpy(out + dir_len, name, len);
+    out[dir_len + len] = '\0';
+    return 0;
+}
+
+static void results_grow(void) {
+
+    size_t size = results_size ? results_size * 2 : DU_RESULTS_MIN;
+    du_node **grown = calloc(size, sizeof(du_node *));
+
+    /* chains just get longer without it */
+    if (!grown) {
+        return;
+    }
+
+    for (size_t i = 0; i < results_size; i++) {
+
+        du_node *node = results[i];
+
+        while (node) {
+
+            du_node *next = node->next;
+            size_t bucket = node->hash & (size - 1);
+
+            node->next = grown[bucket];
+            grown[bucket] = node;
+            node = next;
+        }
+    }
+
+    free(results);
+    results = grown;
+    results_size = size;
+}
+
+static void results_insert(du_node *node) {
+
+    pthread_mutex_lock(&results_lock);
+
+    if (results_count >= results_size) {
+        results_grow();
+    }
+
+    if (results_size == 0) {
+
+        pthread_mutex_unlock(&results_lock);
+        return;
+    }
+
+    du_node **link = &results[node->hash & (results_size - 1)];
+
+    for (; *link; link = &(*link)->next) {
+
+        du_node *old = *link;
+        if (old->hash != node->hash || strcmp(old->path, node->path) != 0) {
+            continue;
+        }
+
+        /* a scan above this one that is still running doesn't get to overwrite it */
+        if (old->scan->id > node->scan->id) {
+
+            pthread_mutex_unlock(&results_lock);
+            return;
+        }
+
+        *link = old->next;
+        results_count--;
+        break;
+    }
+
+    size_t bucket = node->hash & (results_size - 1);
+    node->next = results[bucket];
+    results[bucket] = node;
+    results_count++;
+
+    pthread_mutex_unlock(&results_lock);
+}
+
+static void results_remove_scan(du_scan *scan) {
+
+    pthread_mutex_lock(&results_lock);
+
+    for (size_t i = 0; i < results_size; i++) {
+
+        du_node **link = &results[i];
+
+        while (*link) {
+
+            if ((*link)->scan == scan) {
+
+                *link = (*link)->next;
+                results_count--;
+
+            } else {
+
+                link = &(*link)->next;
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&results_lock);
+}
+
+/* returns 1 the first time (dev, ino) shows up in this scan */
+static int inode_first_seen(du_scan *scan, uint64_t dev, uint64_t ino) {
+
+    uint64_t hash = (ino * 0x9e3779b97f4a7c15ULL) ^ (dev * 0xc2b2ae3d27d4eb4fULL);
+    inode_shard *shard = &scan->inodes[hash % DU_INODE_SHARDS];
+    int first = 1;
+
+    pthread_mutex_lock(&shard->lock);
+
+    if (shard->count * 2 >= shard->capacity) {
+
+        size_t capacity = shard->capacity ? shard->capacity * 2 : 256;
+        uint64_t *keys = calloc(capacity * 2, sizeof(uint64_t));
+
+        if (keys) {
+
+            for (size_t i = 0; i < shard->capacity; i++) {
+
+                if (shard->keys[2 * i + 1] == 0) {
+                    continue;
+                }
+
+                uint64_t h = (shard->keys[2 * i + 1] * 0x9e3779b97f4a7c15ULL) ^
+                             (shard->keys[2 * i] * 0xc2b2ae3d27d4eb4fULL);
+                size_t slot = (h >> 6) & (capacity - 1);
+
+                while (keys[2 * slot + 1] != 0) {
+                    slot = (slot + 1) & (capacity - 1);
+                }
+
+                keys[2 * slot] = shard->keys[2 * i];
+                keys[2 * slot + 1] = shard->keys[2 * i + 1];
+            }
+
+            free(shard->keys);
+            shard->keys = keys;
+            shard->capacity = capacity;
+        }
+    }
+
+    /* out of memory with a full shard, counting a link twice beats hanging */
+    if (shard->count + 1 >= shard->capacity) {
+
+        pthread_mutex_unlock(&shard->lock);
+        return 1;
+    }
+
+    size_t slot = (hash >> 6) & (shard->capacity - 1);
+
+    while (shard->keys[2 * slot + 1] != 0) {
+
+        if (shard->keys[2 * slot] == dev && shard->keys[2 * slot + 1] == ino) {
+
+            first = 0;
+            break;
+        }
+
+        slot = (slot + 1) & (shard->capacity - 1);
+    }
+
+    if (first) {
+
+        shard->keys[2 * slot] = dev;
+        shard->keys[2 * slot + 1] = ino;
+        shard->count++;
+    }
+
+    pthread_mutex_unlock(&shard->lock);
+    return first;
+}
+
+/* what du counts for one entry: the blocks it occupies */
+static long long usage(du_scan *scan, const struct stat *st) {
+
+    if (!S_ISDIR(st->st_mode) && st->st_nlink > 1 && st->st_ino != 0 &&
+        !inode_first_seen(scan, st->st_dev, st->st_ino)) {
+        return 0;
+    }
+
+    return (long long)st->st_blocks * 512;
+}
+
+/* a directory was read completely, and maybe with it the last one its parent waited for */
+static void node_finish(du_node *node) {
+
+    while (node && __atomic_sub_fetch(&node->pending, 1, __ATOMIC_ACQ_REL) == 0) {
+        node = node->parent;
+    }
+}
+
+static du_node *node_new(walk_worker *w, du_node *parent, const char *name, int len) {
+
+    du_scan *scan = w->walk->data;
+    char path[PATH_MAX];
+
+    if (join_path(path, sizeof(path), parent->path, name, len) != 0) {
+        return NULL;
+    }
+
+    size_t path_len = strlen(path);
+    du_node *node = arena_alloc(&w->arena, sizeof(du_node) + path_len + 1);
+
+    if (!node) {
+        return NULL;
+    }
+
+    memcpy(node->path, path, path_len + 1);
+    node->parent = parent;
+    node->next = NULL;
+    node->scan = scan;
+    node->hash = hash_path(node->path);
+    node->bytes = 0;
+    node->pending = 1;
+    node->rel = parent == scan->root ? (int)(path_len - len) : parent->rel;
+
+    return node;
+}
+
+static void scan_directory(walk_worker *w, void *task) {
+
+    du_node *node = task;
+    du_scan *scan = w->walk->data;
+    const char *rel = node == scan->root ? "." : node->path + node->rel;
+    long long bytes = 0;
+
+    int dfd = openat(scan->root_fd, rel, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+
+    if (dfd >= 0) {
+
+        struct stat st;
+        if (fstat(dfd, &st) == 0) {
+            bytes += usage(scan, &st);
+        }
+
+        long nread;
+
+        while (!walk_cancelled(&scan->walk) &&
+               (nread = syscall(SYS_getdents64, dfd, w->buf, GETDENTS_BUF_SIZE)) > 0) {
+
+            for (long pos = 0; pos < nread;) {
+
+                struct linux_dirent64 *d = (struct linux_dirent64 *)(w->buf + pos);
+                pos += d->d_reclen;
+
+                const char *name = d->d_name;
+                if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+                    continue;
+                }
+
+                int is_dir = d->d_type == DT_DIR;
+
+                /* directories count their own blocks when they are read */
+                if (!is_dir) {
+
+                    if (fstatat(dfd, name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+                        continue;
+                    }
+
+                    is_dir = S_ISDIR(st.st_mode);
+                    if (!is_dir) {
+
+                        bytes += usage(scan, &st);
+                        continue;
+                    }
+                }
+
+                du_node *child = node_new(w, node, name, strlen(name));
+                if (!child) {
+                    continue;
+                }
+
+                __atomic_add_fetch(&node->pending, 1, __ATOMIC_RELAXED);
+                results_insert(child);
+
+                /* it can't be read, but the total above it still has to finish */
+                if (walk_push(w, child) != 0) {
+                    node_finish(child);
+                }
+            }
+        }
+
+        close(dfd);
+    }
+
+    for (du_node *n = node; n; n = n->parent) {
+        __atomic_add_fetch(&n->bytes, bytes, __ATOMIC_RELAXED);
+    }
+
+    __atomic_add_fetch(&scan->dirs, 1, __ATOMIC_RELAXED);
+    node_finish(node);
+}
+
+static int scan_running(du_scan *scan) {
+
+    return __atomic_load_n(&scan->root->pending, __ATOMIC_ACQUIRE) > 0 && !walk_cancelled(&scan->walk);
+}
+
+static void scan_free(du_scan *scan) {
+
+    /* no worker may add a node once they are taken out, and they live in the workers' arenas */
+    walk_cancel(&scan->walk);
+    walk_join(&scan->walk);
+    results_remove_scan(scan);
+    walk_free(&scan->walk);
+
+    for (int i = 0; i < DU_INODE_SHARDS; i++) {
+
+        pthread_mutex_destroy(&scan->inodes[i].lock);
+        free(scan->inodes[i].keys);
+    }
+
+    if (scan->root_fd >= 0) {
+        close(scan->root_fd);
+    }
+
+    free(scan);
+}
+
+int du_start(const char *path) {
+
+    char root[PATH_MAX];
+
+    if (!realpath(path, root)) {
+        return -1;
+    }
+
+    size_t root_len = strlen(root);
+
+    /* a new scan of this directory or one above replaces whatever was scanned below it */
+    for (du_scan **link = &scans; *link;) {
+
+        du_scan *old = *link;
+        const char *old_root = old->root->path;
+
+        int below = strncmp(old_root, root, root_len) == 0 &&
+                    (old_root[root_len] == '\0' || old_root[root_len] == '/' || root[root_len - 1] == '/');
+
+        if (below) {
+
+            *link = old->next;
+            scan_free(old);
+
+        } else {
+
+            link = &old->next;
+        }
+    }
+
+    du_scan *scan = calloc(1, sizeof(du_scan));
+    if (!scan) {
+        return -1;
+    }
+
+    walk_init(&scan->walk, walk_threads(DU_THREADS), scan_directory, scan);
+
+    for (int i = 0; i < DU_INODE_SHARDS; i++) {
+        pthread_mutex_init(&scan->inodes[i].lock, NULL);
+    }
+
+    scan->id = ++last_scan_id;
+    scan->root_fd = open(root, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    scan->root = arena_alloc(&scan->walk.workers[0].arena, sizeof(du_node) + root_len + 1);
+
+    if (scan->root_fd < 0 || !scan->root) {
+
+        scan_free(scan);
+        return -1;
+    }
+
+    du_node *node = scan->root;
+    memset(node, 0, sizeof(du_node));
+    memcpy(node->path, root, root_len + 1);
+    node->scan = scan;
+    node->hash = hash_path(root);
+    node->pending = 1;
+    node->rel = root_len;
+
+    results_insert(node);
+
+    if (walk_start(&scan->walk, node) != 0) {
+
+        scan_free(scan);
+        return -1;
+    }
+
+    scan->next = scans;
+    scans = scan;
+    return 0;
+}
+
+int du_lookup(const char *dir, const char *name, int len, long long *bytes) {
+
+    char path[PATH_MAX];
+
+    if (len == 1 && name[0] == '.') {
+
+        if (strlen(dir) >= sizeof(path)) {
+            return -1;
+        }
+
+        strcpy(path, dir);
+
+    } else if (join_path(path, sizeof(path), dir, name, len) != 0) {
+
+        return -1;
+    }
+
+    uint64_t hash = hash_path(path);
+    int found = -1;
+
+    pthread_mutex_lock(&results_lock);
+
+    if (results_size > 0) {
+
+        for (du_node *node = results[hash & (results_size - 1)]; node; node = node->next) {
+
+            if (node->hash == hash && strcmp(node->path, path) == 0) {
+
+                *bytes = __atomic_load_n(&node->bytes, __ATOMIC_RELAXED);
+                found = __atomic_load_n(&node->pending, __ATOMIC_ACQUIRE) == 0;
+                break;
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&results_lock);
+    return found;
+}
+
+int du_progress(long long *dirs, long long *bytes) {
+
+    if (!scans) {
+        return -1;
+    }
+
+    *dirs = __atomic_load_n(&scans->dirs, __ATOMIC_RELAXED);
+    *bytes = __atomic_load_n(&scans->root->bytes, __ATOMIC_RELAXED);
+    return scan_running(scans);
+}
+
+int du_poll(void) {
+
+    long long seen = 0;
+
+    for (du_scan *scan = scans; scan; scan = scan->next) {
+
+        seen += __atomic_load_n(&scan->dirs, __ATOMIC_RELAXED) + !scan_running(scan);
+
+        /* finished workers are gone already, joining just collects them */
+        if (!scan_running(scan)) {
+            walk_join(&scan->walk);
+        }
+    }
+
+    int changed = seen != last_poll;
+    last_poll = seen;
+    return changed;
+}
+
+int du_poll_timeout(void) {
+
+    for (du_scan *scan = scans; scan; scan = scan->next) {
+        if (scan_running(scan)) {
+            return DU_REFRESH_MS;
+        }
+    }
+
+    return -1;
+}
+
+void du_stop(void) {
+
+    while (scans) {
+
+        du_scan *scan = scans;
+        scans = scan->next;
+        scan_free(scan);
+    }
+
+    pthread_mutex_lock(&results_lock);
+    free(results);
+    results = NULL;
+    results_size = results_count = 0;
+    pthread_mutex_unlock(&results_lock);
+}
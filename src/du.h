@@ -0,0 +1,27 @@
+#ifndef DU_H
+#define DU_H
+
+/* disk usage of whole subtrees, counted like du: allocated blocks, every hard linked file once.
+ * a scan runs on a pool of background threads and its per directory totals stay cached, so
+ * directories below a scanned one show their size right away when visited */
+
+/* starts scanning `path`, previous results for it and everything below it are dropped */
+int du_start(const char *path);
+
+/* looks up the total of `name` in `dir`, name is len bytes long and "." is dir itself.
+ * returns -1 if it was never scanned, 0 while it is still being added up, 1 once bytes is final */
+int du_lookup(const char *dir, const char *name, int len, long long *bytes);
+
+/* progress of the last scan started. returns 1 while it runs, 0 when done, -1 if there is none */
+int du_progress(long long *dirs, long long *bytes);
+
+/* returns 1 if results changed since the last call */
+int du_poll(void);
+
+/* milliseconds until du_poll() may have something new, -1 if no scan is running */
+int du_poll_timeout(void);
+
+/* cancels running scans and frees every result */
+void du_stop(void);
+
+#endif
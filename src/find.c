@@ -0,0 +1,562 @@
+/* Copyright 2025 Henryk Szenkowicz Holtman
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files(the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in all copies
+    or
+    substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED “AS IS”,
+    WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "find.h"
+#include "config.h"
+#include "grep.h"
+#include "native.h"
+#include "walk.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+/* matches are stat'ed and stored this many at a time */
+#define FIND_BATCH 64
+
+/* rows kept at most, later matches are only counted */
+#define FIND_MAX_RESULTS 1000000
+
+#define FIND_MAX_PRUNE 32
+
+/* a file with a NUL byte this close to its start is taken for binary, like grep does */
+#define GREP_BINARY_PROBE 8192
+
+/* longest "path:line: text" row, the text is cut short to fit */
+#define GREP_ROW_MAX 512
+#define GREP_BATCH 32
+
+struct ls_find {
+    walk walk; /* tasks are paths relative to root_fd, "" for the root itself */
+    int root_fd;
+    find_mode mode;
+    char *pattern; /* lowercase, for names */
+    size_t pattern_len;
+    grep_pattern grep; /* for contents */
+    char *prune_list;
+    const char *prune[FIND_MAX_PRUNE];
+    int prune_count;
+    struct timespec started;
+    int finished;
+    long long finished_ms; /* how long it ran, once finished */
+
+    long long entries, dirs, matches, files, bytes, skipped; /* atomic */
+
+    /* everything below is guarded by lock */
+    pthread_mutex_t lock;
+    ls_table pending; /* rows without an arena of their own */
+    arena names;
+    int kept; /* rows handed out so far, pending included. atomic, grep_collect() reads it without the lock */
+};
+
+static long long find_elapsed_ms(const ls_find *f) {
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - f->started.tv_sec) * 1000LL + (now.tv_nsec - f->started.tv_nsec) / 1000000;
+}
+
+static int find_pruned(const ls_find *f, const char *name) {
+
+    for (int i = 0; i < f->prune_count; i++) {
+        if (strcmp(f->prune[i], name) == 0) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/* case folding is ASCII only, like the pattern */
+static int find_matches(const ls_find *f, const char *name) {
+
+    if (f->pattern_len == 0) {
+        return 1;
+    }
+
+    char folded[NAME_MAX + 1];
+    size_t len = 0;
+
+    for (; name[len] && len < NAME_MAX; len++) {
+
+        char c = name[len];
+        folded[len] = c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+    }
+
+    if (len < f->pattern_len) {
+        return 0;
+    }
+
+    /* memchr() skips to the candidates for the first byte, most names have none */
+    const char *end = folded + len - f->pattern_len + 1;
+
+    for (const char *p = folded; p < end; p++) {
+
+        p = memchr(p, f->pattern[0], end - p);
+        if (!p) {
+            return 0;
+        }
+
+        if (memcmp(p + 1, f->pattern + 1, f->pattern_len - 1) == 0) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/* stats a batch of matching names of directory dfd and hands them to the main thread by path */
+static void find_flush(ls_find *f, int dfd, const char *rel, native_entry *batch, int n) {
+
+    int widths[6] = {1, 1, 1, 1, 1, 1};
+    char path[PATH_MAX];
+
+    stat_native_entries(dfd, batch, n);
+
+    /* names that vanished between getdents64 and the stat are dropped, like the native loader does */
+    int found = 0;
+
+    for (int i = 0; i < n; i++) {
+
+        if (batch[i].stat_ok) {
+
+            batch[found++] = batch[i];
+
+        } else {
+
+            free(batch[i].link_target);
+        }
+    }
+
+    n = found;
+    measure_widths(batch, n, widths);
+
+    pthread_mutex_lock(&f->lock);
+
+    int keep = FIND_MAX_RESULTS - f->kept;
+    keep = keep < n ? keep : n;
+
+    if (keep > 0 && table_insert_rows(&f->pending, f->pending.count, keep) == 0) {
+
+        int row = f->pending.count - keep;
+
+        for (int i = 0; i < keep; i++) {
+
+            char *name = batch[i].name;
+
+            /* the row is named by its path from the root, the stat went by name */
+            if (rel[0]) {
+
+                snprintf(path, sizeof(path), "%s/%s", rel, name);
+                batch[i].name = path;
+            }
+
+            if (store_native_entry(&f->pending, row, &batch[i], &f->names) == 0) {
+                row++;
+            }
+
+            batch[i].name = name;
+        }
+
+        __atomic_add_fetch(&f->kept, row - (f->pending.count - keep), __ATOMIC_RELAXED);
+        f->pending.count = row;
+    }
+
+    for (int i = 0; i < 6; i++) {
+        if (widths[i] > f->pending.widths[i]) {
+            f->pending.widths[i] = widths[i];
+        }
+    }
+
+    pthread_mutex_unlock(&f->lock);
+
+    for (int i = 0; i < n; i++) {
+        free(batch[i].link_target);
+    }
+}
+
+/* the hits of one file on their way into the listing */
+typedef struct grep_batch {
+    ls_find *f;
+    const char *path;
+    size_t path_len;
+    int n;
+    char rows[GREP_BATCH][GREP_ROW_MAX];
+} grep_batch;
+
+static void grep_flush(grep_batch *b) {
+
+    ls_find *f = b->f;
+
+    pthread_mutex_lock(&f->lock);
+
+    int keep = FIND_MAX_RESULTS - f->kept;
+    keep = keep < b->n ? keep : b->n;
+
+    if (keep > 0 && table_insert_rows(&f->pending, f->pending.count, keep) == 0) {
+
+        int row = f->pending.count - keep;
+
+        for (int i = 0; i < keep; i++) {
+
+            char *text = arena_strndup(&f->names, b->rows[i], strlen(b->rows[i]));
+            if (!text) {
+                continue;
+            }
+
+            /* the bare name is the path, what follows it is shown like ls output after a name */
+            f->pending.fname[row] = text;
+            f->pending.prefix[row] = text;
+            f->pending.name_len[row] = b->path_len;
+            f->pending.type[row] = file_reg;
+            row++;
+        }
+
+        __atomic_add_fetch(&f->kept, row - (f->pending.count - keep), __ATOMIC_RELAXED);
+        f->pending.count = row;
+    }
+
+    pthread_mutex_unlock(&f->lock);
+    b->n = 0;
+}
+
+static int grep_stopped(ls_find *f) {
+    return walk_cancelled(&f->walk) || __atomic_load_n(&f->kept, __ATOMIC_RELAXED) >= FIND_MAX_RESULTS;
+}
+
+static int grep_collect(void *ctx, long line, const char *text, size_t len) {
+
+    grep_batch *b = ctx;
+
+    if (!text) {
+        return grep_stopped(b->f);
+    }
+
+    char *row = b->rows[b->n];
+    int at = snprintf(row, GREP_ROW_MAX, "%s:%ld: ", b->path, line);
+
+    if (at < 0 || at >= GREP_ROW_MAX) {
+        return 0;
+    }
+
+    len = len < (size_t)(GREP_ROW_MAX - at - 1) ? len : (size_t)(GREP_ROW_MAX - at - 1);
+
+    /* tabs and other control bytes would throw the columns off */
+    for (size_t i = 0; i < len; i++) {
+
+        unsigned char c = text[i];
+        row[at + i] = c < ' ' || c == 0x7f ? ' ' : c;
+    }
+    row[at + len] = '\0';
+
+    if (++b->n == GREP_BATCH) {
+        grep_flush(b);
+    }
+
+    return grep_stopped(b->f);
+}
+
+/* searches one regular file through a read only mapping, no copy of it is ever made */
+static void grep_file(ls_find *f, int dfd, const char *rel, const char *name) {
+
+    char path[PATH_MAX];
+    int len = rel[0] ? snprintf(path, sizeof(path), "%s/%s", rel, name) : snprintf(path, sizeof(path), "%s", name);
+
+    /* a row with the path cut short would open the wrong file */
+    if (len < 0 || len >= GREP_ROW_MAX / 2) {
+
+        __atomic_add_fetch(&f->skipped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    int fd = openat(dfd, name, O_RDONLY | O_NOFOLLOW | O_NOCTTY | O_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+
+    struct stat st;
+
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+
+        close(fd);
+        return;
+    }
+
+    if (GREP_MAX_FILE_BYTES > 0 && st.st_size > GREP_MAX_FILE_BYTES) {
+
+        __atomic_add_fetch(&f->skipped, 1, __ATOMIC_RELAXED);
+        close(fd);
+        return;
+    }
+
+    const char *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED) {
+        return;
+    }
+
+    madvise((void *)data, st.st_size, MADV_SEQUENTIAL);
+
+    size_t probe = st.st_size < GREP_BINARY_PROBE ? st.st_size : GREP_BINARY_PROBE;
+
+    if (memchr(data, '\0', probe)) {
+
+        __atomic_add_fetch(&f->skipped, 1, __ATOMIC_RELAXED);
+
+    } else {
+
+        grep_batch *b = malloc(sizeof(grep_batch));
+
+        if (b) {
+
+            b->f = f;
+            b->path = path;
+            b->path_len = len;
+            b->n = 0;
+
+            long hits = grep_buffer(&f->grep, data, st.st_size, grep_collect, b);
+
+            if (b->n > 0) {
+                grep_flush(b);
+            }
+
+            free(b);
+            __atomic_add_fetch(&f->matches, hits, __ATOMIC_RELAXED);
+        }
+
+        __atomic_add_fetch(&f->files, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&f->bytes, st.st_size, __ATOMIC_RELAXED);
+    }
+
+    munmap((void *)data, st.st_size);
+}
+
+static void find_directory(walk_worker *w, void *task) {
+
+    ls_find *f = w->walk->data;
+    const char *rel = task;
+    size_t rel_len = strlen(rel);
+    native_entry batch[FIND_BATCH];
+    long long entries = 0, matches = 0;
+    int n = 0;
+
+    int dfd = openat(f->root_fd, rel[0] ? rel : ".", O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (dfd < 0) {
+        return;
+    }
+
+    long nread;
+
+    while (!walk_cancelled(&f->walk) && (nread = syscall(SYS_getdents64, dfd, w->buf, GETDENTS_BUF_SIZE)) > 0) {
+
+        /* a buffer holds hundreds of names and every file may be searched, cancelling can't wait for all of them */
+        for (long pos = 0; pos < nread && !walk_cancelled(&f->walk);) {
+
+            struct linux_dirent64 *d = (struct linux_dirent64 *)(w->buf + pos);
+            pos += d->d_reclen;
+
+            const char *name = d->d_name;
+            if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+                continue;
+            }
+
+            entries++;
+
+            if (f->mode != find_names) {
+
+                /* DT_UNKNOWN is sorted out by the open */
+                if (d->d_type == DT_REG || d->d_type == DT_UNKNOWN) {
+                    grep_file(f, dfd, rel, name);
+                }
+
+            } else if (find_matches(f, name)) {
+
+                memset(&batch[n], 0, sizeof(batch[n]));
+                batch[n].name = (char *)name;
+                matches++;
+
+                if (++n == FIND_BATCH) {
+
+                    find_flush(f, dfd, rel, batch, n);
+                    n = 0;
+                }
+            }
+
+            int is_dir = d->d_type == DT_DIR;
+
+            if (d->d_type == DT_UNKNOWN) {
+
+                struct stat st;
+                is_dir = fstatat(dfd, name, &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(st.st_mode);
+            }
+
+            if (!is_dir || find_pruned(f, name)) {
+                continue;
+            }
+
+            size_t name_len = strlen(name);
+            char *child = arena_alloc(&w->arena, rel_len + name_len + 2);
+
+            if (!child) {
+                continue;
+            }
+
+            if (rel_len > 0) {
+
+                memcpy(child, rel, rel_len);
+                child[rel_len] = '/';
+                memcpy(child + rel_len + 1, name, name_len + 1);
+
+            } else {
+
+                memcpy(child, name, name_len + 1);
+            }
+
+            walk_push(w, child);
+        }
+
+        /* the names point into the buffer the next getdents64 overwrites */
+        if (n > 0) {
+
+            find_flush(f, dfd, rel, batch, n);
+            n = 0;
+        }
+    }
+
+    close(dfd);
+
+    __atomic_add_fetch(&f->entries, entries, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&f->matches, matches, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&f->dirs, 1, __ATOMIC_RELAXED);
+}
+
+ls_find *find_start(const char *path, const char *pattern, find_mode mode) {
+
+    ls_find *f = calloc(1, sizeof(ls_find));
+    if (!f) {
+        return NULL;
+    }
+
+    f->mode = mode;
+    f->root_fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    f->pattern = strdup(pattern);
+    f->prune_list = strdup(FIND_PRUNE);
+    clock_gettime(CLOCK_MONOTONIC, &f->started);
+    pthread_mutex_init(&f->lock, NULL);
+    table_init(&f->pending, mode == find_names);
+    walk_init(&f->walk, walk_threads(FIND_THREADS), find_directory, f);
+
+    if (f->root_fd < 0 || !f->pattern || !f->prune_list ||
+        (mode != find_names && grep_compile(&f->grep, pattern, mode == find_regex) != 0)) {
+
+        find_free(f, NULL);
+        return NULL;
+    }
+
+    for (char *p = f->pattern; *p; p++) {
+        *p = *p >= 'A' && *p <= 'Z' ? *p + ('a' - 'A') : *p;
+    }
+    f->pattern_len = strlen(f->pattern);
+
+    char *save;
+    for (char *dir = strtok_r(f->prune_list, ":", &save); dir && f->prune_count < FIND_MAX_PRUNE;
+         dir = strtok_r(NULL, ":", &save)) {
+        f->prune[f->prune_count++] = dir;
+    }
+
+    if (walk_start(&f->walk, "") != 0) {
+
+        find_free(f, NULL);
+        return NULL;
+    }
+
+    return f;
+}
+
+int find_take(ls_find *f, ls_table *chunk) {
+
+    /* a cancelled walk may still be in the middle of a directory, its rows come in before the end */
+    int done = !walk_running(&f->walk);
+
+    if (done) {
+        walk_join(&f->walk);
+    }
+
+    pthread_mutex_lock(&f->lock);
+    *chunk = f->pending;
+    table_init(&f->pending, f->mode == find_names);
+    memcpy(f->pending.widths, chunk->widths, sizeof(chunk->widths));
+    pthread_mutex_unlock(&f->lock);
+
+    if (done && !f->finished) {
+
+        f->finished = 1;
+        f->finished_ms = find_elapsed_ms(f);
+    }
+
+    return done;
+}
+
+void find_progress(ls_find *f, find_stats *stats) {
+
+    long long ms = f->finished ? f->finished_ms : find_elapsed_ms(f);
+
+    stats->entries = __atomic_load_n(&f->entries, __ATOMIC_RELAXED);
+    stats->dirs = __atomic_load_n(&f->dirs, __ATOMIC_RELAXED);
+    stats->matches = __atomic_load_n(&f->matches, __ATOMIC_RELAXED);
+    stats->files = __atomic_load_n(&f->files, __ATOMIC_RELAXED);
+    stats->bytes = __atomic_load_n(&f->bytes, __ATOMIC_RELAXED);
+    stats->skipped = __atomic_load_n(&f->skipped, __ATOMIC_RELAXED);
+    stats->per_second = ms > 0 ? stats->entries * 1000 / ms : 0;
+    stats->bytes_per_second = ms > 0 ? stats->bytes * 1000 / ms : 0;
+    stats->mode = f->mode;
+    stats->running = !f->finished;
+}
+
+void find_cancel(ls_find *f) {
+
+    walk_cancel(&f->walk);
+}
+
+void find_free(ls_find *f, arena *names) {
+
+    walk_free(&f->walk);
+
+    if (names) {
+
+        *names = f->names;
+        f->names = (arena){0};
+    }
+
+    table_free(&f->pending);
+    arena_free(&f->names);
+    pthread_mutex_destroy(&f->lock);
+
+    if (f->root_fd >= 0) {
+        close(f->root_fd);
+    }
+
+    grep_free(&f->grep);
+    free(f->pattern);
+    free(f->prune_list);
+    free(f);
+}
@@ -0,0 +1,50 @@
+#ifndef FIND_H
+#define FIND_H
+
+#include "table.h"
+
+/* a recursive search below a directory, for names or for file contents. the tree is walked on a
+ * pool of background threads. in find_names mode every entry whose name contains the pattern
+ * (ignoring ASCII case) comes out as a native row named by its path relative to where the search
+ * started. the other modes search every regular file and give one text row per matching line,
+ * "path:line: text" with the path as its bare name */
+
+typedef struct ls_find ls_find;
+
+typedef enum {
+    find_names,
+    find_literal, /* lines containing the pattern */
+    find_regex,   /* lines matching the pattern as an extended regex */
+} find_mode;
+
+typedef struct find_stats {
+    long long entries;    /* names looked at */
+    long long dirs;       /* directories read */
+    long long matches;    /* including the ones past FIND_MAX_RESULTS that were not kept */
+    long long files;      /* files whose contents were searched */
+    long long bytes;      /* in those files */
+    long long skipped;    /* binary files, ones over GREP_MAX_FILE_BYTES and ones with paths too long to list */
+    long long per_second; /* entries per second since the start */
+    long long bytes_per_second;
+    find_mode mode;
+    int running;
+} find_stats;
+
+/* starts searching `path`. directories named in FIND_PRUNE are skipped, symlinks are not followed.
+ * returns NULL if path can't be opened or the regex does not compile */
+ls_find *find_start(const char *path, const char *pattern, find_mode mode);
+
+/* moves the rows found since the last call into chunk, which is initialized here. their names live
+ * in the find until find_free(). returns 1 once the search is over and nothing more will come */
+int find_take(ls_find *f, ls_table *chunk);
+
+void find_progress(ls_find *f, find_stats *stats);
+
+/* stops handing out directories, find_take() reports the end once the workers left */
+void find_cancel(ls_find *f);
+
+/* stops the search and frees it. the names of the rows it handed out go to *names, or are freed with
+ * it if names is NULL */
+void find_free(ls_find *f, arena *names);
+
+#endif
@@ -0,0 +1,686 @@
+/* Copyright 2025 Henryk Szenkowicz Holtman
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files(the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in all copies
+    or
+    substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED “AS IS”,
+    WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "fuzzy.h"
+#include "config.h"
+#include "grep.h"
+#include "trigram.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* scores, roughly fzf's: every matched character earns SCORE_MATCH plus a bonus when it starts a
+ * word, gaps cost a little for the first skipped character and less for the rest */
+#define SCORE_MATCH 16
+#define SCORE_GAP_START -3
+#define SCORE_GAP_EXTENSION -1
+#define BONUS_BOUNDARY 8
+#define BONUS_CAMEL 7
+#define BONUS_CONSECUTIVE 4
+#define BONUS_FIRST_CHAR_MULTIPLIER 2
+
+/* the pool ends in this many zero bytes, so 16 byte loads past the last name stay inside it */
+#define POOL_PADDING 16
+
+static inline char fold(char c) {
+
+    return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+}
+
+/* letters get a bit each, the rest share the last six. c is folded */
+static inline unsigned char_bit(char c) {
+
+    if (c >= 'a' && c <= 'z') {
+        return 1u << (c - 'a');
+    } else if (c >= '0' && c <= '4') {
+        return 1u << 26;
+    } else if (c >= '5' && c <= '9') {
+        return 1u << 27;
+    } else if (c == '.') {
+        return 1u << 28;
+    } else if (c == '-') {
+        return 1u << 29;
+    } else if (c == '_') {
+        return 1u << 30;
+    }
+
+    return 1u << 31;
+}
+
+static int is_separator(char c) {
+
+    return c == '/' || c == '_' || c == '-' || c == '.' || c == ' ';
+}
+
+/* name is the original, the case of its letters tells camelCase humps apart */
+static int bonus_at(const char *name, int i) {
+
+    if (i == 0 || is_separator(name[i - 1])) {
+        return BONUS_BOUNDARY;
+    }
+
+    if (name[i] >= 'A' && name[i] <= 'Z' && name[i - 1] >= 'a' && name[i - 1] <= 'z') {
+        return BONUS_CAMEL;
+    }
+
+    return 0;
+}
+
+/* folded is name folded, query is folded too. -1 if it does not match */
+static int score(const char *folded, const char *name, int len, const char *query, int qlen) {
+
+    /* one character needs no window, only its best place */
+    if (qlen == 1) {
+
+        int best = -1;
+
+        for (int i = 0; i < len; i++) {
+
+            if (folded[i] == query[0]) {
+
+                int bonus = bonus_at(name, i);
+                best = bonus > best ? bonus : best;
+            }
+        }
+
+        return best < 0 ? -1 : SCORE_MATCH + best * BONUS_FIRST_CHAR_MULTIPLIER;
+    }
+
+    int qi = 0, end = -1;
+
+    /* the first occurrence that holds the whole query ends here */
+    for (int i = 0; i < len; i++) {
+
+        if (folded[i] == query[qi] && ++qi == qlen) {
+
+            end = i;
+            break;
+        }
+    }
+
+    if (end < 0) {
+        return -1;
+    }
+
+    /* and going back from there finds the shortest window ending at it */
+    int start = end;
+    qi = qlen - 1;
+
+    for (int i = end; i >= 0; i--) {
+
+        if (folded[i] == query[qi] && --qi < 0) {
+
+            start = i;
+            break;
+        }
+    }
+
+    int total = 0, prev = -2, gap = 0;
+    qi = 0;
+
+    for (int i = start; i <= end; i++) {
+
+        if (qi < qlen && folded[i] == query[qi]) {
+
+            int bonus = bonus_at(name, i);
+
+            if (prev == i - 1) {
+                bonus += BONUS_CONSECUTIVE;
+            }
+
+            if (qi == 0) {
+                bonus *= BONUS_FIRST_CHAR_MULTIPLIER;
+            }
+
+            total += SCORE_MATCH + bonus;
+            prev = i;
+            gap = 0;
+            qi++;
+
+        } else {
+
+            total += gap++ ? SCORE_GAP_EXTENSION : SCORE_GAP_START;
+        }
+    }
+
+    /* long gaps can take it below zero, which would read as no match */
+    return total > 0 ? total : 0;
+}
+
+int fuzzy_positions(const char *name, int len, const char *query, int *positions) {
+
+    char q[FUZZY_MAX_QUERY];
+    int qlen = 0;
+
+    for (; query[qlen] && qlen < FUZZY_MAX_QUERY; qlen++) {
+        q[qlen] = fold(query[qlen]);
+    }
+
+    /* a substring, where it first occurs */
+    if (qlen > 0 && q[0] == '\'') {
+
+        const char *needle = q + 1;
+        int n = qlen - 1;
+
+        for (int at = 0; at + n <= len; at++) {
+
+            int i = 0;
+            while (i < n && fold(name[at + i]) == needle[i]) {
+                i++;
+            }
+
+            if (i == n) {
+
+                for (i = 0; i < n; i++) {
+                    positions[i] = at + i;
+                }
+                return n;
+            }
+        }
+
+        return -1;
+    }
+
+    /* the same window score() rates: the first one holding the query, shrunk from its end */
+    int qi = 0, end = -1;
+
+    for (int i = 0; i < len && qi < qlen; i++) {
+        if (fold(name[i]) == q[qi] && ++qi == qlen) {
+            end = i;
+        }
+    }
+
+    if (qlen == 0) {
+        return 0;
+    } else if (end < 0) {
+        return -1;
+    }
+
+    int start = end;
+    qi = qlen - 1;
+
+    for (int i = end; i >= 0 && qi >= 0; i--) {
+        if (fold(name[i]) == q[qi] && --qi < 0) {
+            start = i;
+        }
+    }
+
+    qi = 0;
+    for (int i = start; i <= end && qi < qlen; i++) {
+        if (fold(name[i]) == q[qi]) {
+            positions[qi++] = i;
+        }
+    }
+
+    return qlen;
+}
+
+/* whether the query's characters appear in folded in order. the name is read 16 bytes at a time,
+ * each query character is one compare and a bit scan past where the one before it was found */
+static int contains(const char *folded, int len, const char *query, int qlen) {
+
+    int qi = 0;
+
+#ifdef __SSE2__
+    for (int base = 0; base < len && qi < qlen; base += 16) {
+
+        __m128i v = _mm_loadu_si128((const __m128i *)(folded + base));
+        unsigned valid = len - base >= 16 ? 0xffff : (1u << (len - base)) - 1;
+        int from = 0;
+
+        while (qi < qlen && from < 16) {
+
+            unsigned m = _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(query[qi]))) & valid & (0xffffu << from);
+            if (!m) {
+                break;
+            }
+
+            from = __builtin_ctz(m) + 1;
+            qi++;
+        }
+    }
+#else
+    for (int i = 0; i < len && qi < qlen; i++) {
+        qi += folded[i] == query[qi];
+    }
+#endif
+
+    return qi == qlen;
+}
+
+void fuzzy_init(fuzzy *fz) {
+
+    memset(fz, 0, sizeof(*fz));
+}
+
+static void drop_levels(fuzzy *fz, int from) {
+
+    for (int i = from; i <= FUZZY_MAX_QUERY; i++) {
+
+        free(fz->levels[i]);
+        fz->levels[i] = NULL;
+        fz->level_count[i] = 0;
+    }
+}
+
+static void drop_names(fuzzy *fz) {
+
+    drop_levels(fz, 0);
+    free(fz->masks);
+    free(fz->starts);
+    free(fz->offsets);
+    free(fz->pool);
+    fz->masks = fz->starts = NULL;
+    fz->offsets = NULL;
+    fz->pool = NULL;
+    fz->len = 0;
+}
+
+/* the folded bare names in row order back to back, so the passes over candidates read memory in
+ * order wherever the listing's arena put the names, and compare without folding */
+static int build_names(fuzzy *fz, const ls_table *t, unsigned generation) {
+
+    drop_names(fz);
+    fz->table = t;
+    fz->generation = generation;
+
+    size_t bytes = POOL_PADDING;
+    for (int row = 0; row < t->count; row++) {
+        bytes += t->name_len[row] + 1;
+    }
+
+    fz->masks = malloc((t->count > 0 ? t->count : 1) * sizeof(unsigned));
+    fz->starts = malloc((t->count > 0 ? t->count : 1) * sizeof(unsigned));
+    fz->offsets = malloc((t->count + 1) * sizeof(size_t));
+    fz->pool = malloc(bytes);
+
+    if (!fz->masks || !fz->starts || !fz->offsets || !fz->pool) {
+
+        drop_names(fz);
+        return -1;
+    }
+
+    size_t at = 0;
+
+    for (int row = 0; row < t->count; row++) {
+
+        const char *name = t->fname[row];
+        int len = t->name_len[row];
+        unsigned mask = 0, starts = 0;
+
+        fz->offsets[row] = at;
+
+        for (int i = 0; i < len; i++) {
+
+            char c = fold(name[i]);
+
+            fz->pool[at + i] = c;
+            mask |= char_bit(c);
+            starts |= bonus_at(name, i) > 0 ? char_bit(c) : 0;
+        }
+
+        fz->pool[at + len] = '\0';
+        fz->masks[row] = mask;
+        fz->starts[row] = starts;
+        at += len + 1;
+    }
+
+    fz->offsets[t->count] = at;
+    memset(fz->pool + at, 0, POOL_PADDING);
+    return 0;
+}
+
+/* rows whose names hold every character of need, four masks per compare */
+static int presence_scan(const unsigned *masks, int count, unsigned need, int *out) {
+
+    int n = 0, row = 0;
+
+#ifdef __SSE2__
+    const __m128i want = _mm_set1_epi32(need);
+
+    for (; row + 4 <= count; row += 4) {
+
+        __m128i m = _mm_loadu_si128((const __m128i *)(masks + row));
+        int hit = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(m, want), want)));
+
+        /* most rows fail for a selective query, they cost one compare per four */
+        while (hit) {
+
+            out[n++] = row + __builtin_ctz(hit);
+            hit &= hit - 1;
+        }
+    }
+#endif
+
+    for (; row < count; row++) {
+        if ((masks[row] & need) == need) {
+            out[n++] = row;
+        }
+    }
+
+    return n;
+}
+
+/* the best `limit` matches are kept as a min heap on score, ties go to the shorter name, then the lower row */
+static int worse(const ls_table *t, const fuzzy_match *a, const fuzzy_match *b) {
+
+    if (a->score != b->score) {
+        return a->score < b->score;
+    }
+
+    if (t->name_len[a->row] != t->name_len[b->row]) {
+        return t->name_len[a->row] > t->name_len[b->row];
+    }
+
+    return a->row > b->row;
+}
+
+static void heap_sift_down(const ls_table *t, fuzzy_match *h, int n, int i) {
+
+    for (;;) {
+
+        int l = 2 * i + 1, r = l + 1, m = i;
+
+        if (l < n && worse(t, &h[l], &h[m])) {
+            m = l;
+        }
+        if (r < n && worse(t, &h[r], &h[m])) {
+            m = r;
+        }
+        if (m == i) {
+            return;
+        }
+
+        fuzzy_match tmp = h[i];
+        h[i] = h[m];
+        h[m] = tmp;
+        i = m;
+    }
+}
+
+static void heap_offer(const ls_table *t, fuzzy_match *h, int *n, int limit, fuzzy_match m) {
+
+    if (*n < limit) {
+
+        /* sift up */
+        int i = (*n)++;
+        h[i] = m;
+
+        while (i > 0 && worse(t, &h[i], &h[(i - 1) / 2])) {
+
+            fuzzy_match tmp = h[i];
+            h[i] = h[(i - 1) / 2];
+            h[(i - 1) / 2] = tmp;
+            i = (i - 1) / 2;
+        }
+
+    } else if (limit > 0 && worse(t, &h[0], &m)) {
+
+        h[0] = m;
+        heap_sift_down(t, h, *n, 0);
+    }
+}
+
+/* whether row can possibly outrank the worst of a full heap. the best a name can do is every
+ * character consecutive and each one that appears at the start of a word in it getting the bonus */
+static int beats(const fuzzy *fz, int row, int len, const char *query, int qlen) {
+
+    unsigned starts = fz->starts[row];
+    const fuzzy_match *worst = &fz->top[0];
+    int bound = SCORE_MATCH + (starts & char_bit(query[0]) ? BONUS_BOUNDARY * BONUS_FIRST_CHAR_MULTIPLIER : 0);
+
+    for (int i = 1; i < qlen; i++) {
+        bound += SCORE_MATCH + BONUS_CONSECUTIVE + (starts & char_bit(query[i]) ? BONUS_BOUNDARY : 0);
+    }
+
+    if (bound != worst->score) {
+        return bound > worst->score;
+    }
+
+    /* rows come in ascending order, a tie only wins with a shorter name */
+    return len < fz->table->name_len[worst->row];
+}
+
+static void sort_top(fuzzy *fz, const ls_table *t) {
+
+    /* best first */
+    for (int end = fz->top_count - 1; end > 0; end--) {
+
+        fuzzy_match tmp = fz->top[0];
+        fz->top[0] = fz->top[end];
+        fz->top[end] = tmp;
+        heap_sift_down(t, fz->top, end, 0);
+    }
+}
+
+/* q as a substring of the names. big listings look it up in the trigram index, which follows the
+ * table's changes on its own, the others check every name that has all of its characters */
+static int exact_query(fuzzy *fz, const ls_table *t, unsigned generation, const char *q, int qlen, int limit) {
+
+    int *rows = malloc((t->count > 0 ? t->count : 1) * sizeof(int));
+    int n = 0;
+
+    if (!rows) {
+        return -1;
+    }
+
+    free(fz->exact);
+    fz->exact = rows;
+    fz->exact_count = 0;
+
+    if (TRIGRAM_MIN_ROWS > 0 && t->count >= TRIGRAM_MIN_ROWS) {
+
+        if ((!fz->trigrams && !(fz->trigrams = trigram_new())) || trigram_update(fz->trigrams, t) != 0) {
+            return -1;
+        }
+
+        n = trigram_search(fz->trigrams, q, qlen, rows);
+
+        for (int i = 0; i < n; i++) {
+
+            int row = rows[i];
+            int s = score(trigram_folded(fz->trigrams, row), t->fname[row], t->name_len[row], q, qlen);
+            heap_offer(t, fz->top, &fz->top_count, limit, (fuzzy_match){row, s});
+        }
+
+    } else {
+
+        if ((fz->table != t || fz->generation != generation || !fz->masks) && build_names(fz, t, generation) != 0) {
+            return -1;
+        }
+
+        unsigned need = 0;
+        for (int i = 0; i < qlen; i++) {
+            need |= char_bit(q[i]);
+        }
+
+        for (int row = 0; row < t->count; row++) {
+
+            const char *folded = fz->pool + fz->offsets[row];
+            int len = fz->offsets[row + 1] - fz->offsets[row] - 1;
+
+            if ((fz->masks[row] & need) == need && grep_literal(folded, len, q, qlen)) {
+
+                heap_offer(t, fz->top, &fz->top_count, limit, (fuzzy_match){row, score(folded, t->fname[row], len, q, qlen)});
+                rows[n++] = row;
+            }
+        }
+    }
+
+    fz->exact_count = n;
+    sort_top(fz, t);
+    return n;
+}
+
+int fuzzy_query(fuzzy *fz, const ls_table *t, unsigned generation, const char *query, int limit) {
+
+    char q[FUZZY_MAX_QUERY + 1];
+    int qlen = 0;
+
+    for (; query[qlen] && qlen < FUZZY_MAX_QUERY; qlen++) {
+        q[qlen] = fold(query[qlen]);
+    }
+    q[qlen] = '\0';
+
+    int exact = q[0] == '\'';
+
+    if (!exact && (fz->table != t || fz->generation != generation || !fz->masks) && build_names(fz, t, generation) != 0) {
+        return -1;
+    }
+
+    /* the levels of the common prefix still hold, every one past it is rebuilt from the last of them */
+    int keep = 0;
+    while (keep < qlen && keep < fz->len && q[keep] == fz->query[keep]) {
+        keep++;
+    }
+
+    drop_levels(fz, keep + 1);
+    memcpy(fz->query, q, qlen + 1);
+    fz->len = qlen;
+
+    free(fz->top);
+    fz->top = malloc((limit > 0 ? limit : 1) * sizeof(fuzzy_match));
+    fz->top_count = 0;
+
+    if (!fz->top) {
+        return -1;
+    }
+
+    if (qlen == exact) {
+
+        /* nothing typed yet, the listing as it is */
+        for (int row = 0; row < t->count && row < limit; row++) {
+            fz->top[fz->top_count++] = (fuzzy_match){row, 0};
+        }
+
+        return t->count;
+    }
+
+    if (exact) {
+        return exact_query(fz, t, generation, q + 1, qlen - 1, limit);
+    }
+
+    /* the levels in between are not kept, typing several characters at once or a backspace over
+     * them narrows from the closest one below */
+    int level = keep;
+    while (level > 0 && !fz->levels[level]) {
+        level--;
+    }
+
+    unsigned need = 0;
+    for (int i = level; i < qlen; i++) {
+        need |= char_bit(q[i]);
+    }
+
+    const int *from = fz->levels[level];
+    int from_count = fz->level_count[level];
+    int *scanned = NULL;
+
+    /* nothing to narrow from yet, the presence masks pick the candidates out of every row */
+    if (level == 0) {
+
+        scanned = malloc((t->count > 0 ? t->count : 1) * sizeof(int));
+        if (!scanned) {
+            return -1;
+        }
+
+        from = scanned;
+        from_count = presence_scan(fz->masks, t->count, need, scanned);
+    }
+
+    int *out = NULL;
+    int n = 0;
+
+    if (level < qlen) {
+
+        out = malloc((from_count > 0 ? from_count : 1) * sizeof(int));
+        if (!out) {
+
+            free(scanned);
+            return -1;
+        }
+    }
+
+    /* a single letter has a bit of its own, the masks alone tell which names hold it */
+    int by_mask = qlen == 1 && q[0] >= 'a' && q[0] <= 'z';
+
+    for (int i = 0; i < from_count; i++) {
+
+        int row = from[i];
+
+        if ((fz->masks[row] & need) != need) {
+            continue;
+        }
+
+        const char *folded = fz->pool + fz->offsets[row];
+        int len = fz->offsets[row + 1] - fz->offsets[row] - 1;
+        int s = -1;
+
+        /* once the heap is full only names that could still beat its worst entry are scored,
+         * the rest only have to show that they match */
+        if (fz->top_count == limit && limit > 0 && !beats(fz, row, len, q, qlen)) {
+
+            if (!by_mask && !contains(folded, len, q, qlen)) {
+                continue;
+            }
+
+        } else if ((s = score(folded, t->fname[row], len, q, qlen)) < 0) {
+
+            continue;
+        }
+
+        if (out) {
+            out[n] = row;
+        }
+        n++;
+
+        if (s >= 0) {
+            heap_offer(t, fz->top, &fz->top_count, limit, (fuzzy_match){row, s});
+        }
+    }
+
+    free(scanned);
+
+    if (out) {
+
+        fz->levels[qlen] = out;
+        fz->level_count[qlen] = n;
+    }
+
+    sort_top(fz, t);
+    return n;
+}
+
+const int *fuzzy_all(const fuzzy *fz, int *count) {
+
+    if (fz->len > 0 && fz->query[0] == '\'') {
+
+        *count = fz->exact_count;
+        return fz->len > 1 ? fz->exact : NULL;
+    }
+
+    *count = fz->level_count[fz->len];
+    return fz->len > 0 ? fz->levels[fz->len] : NULL;
+}
+
+void fuzzy_free(fuzzy *fz) {
+
+    drop_names(fz);
+    free(fz->top);
+    free(fz->exact);
+    trigram_free(fz->trigrams);
+    fuzzy_init(fz);
+}
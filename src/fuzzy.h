@@ -0,0 +1,54 @@
+#ifndef FUZZY_H
+#define FUZZY_H
+
+#include "table.h"
+
+/* fzf style matching of a query against the names of a table: the query's characters have to
+ * appear in the name in order, ignoring ASCII case, and matches are ranked by how tight they are
+ * and whether they start words. every keystroke only looks at the names that matched the query
+ * without it, and those come out of a SIMD pass over one 32 bit character set per name. a query
+ * starting with ' matches the rest of it as a substring, like fzf's exact match */
+
+#define FUZZY_MAX_QUERY 64
+
+typedef struct fuzzy_match {
+    int row;
+    int score;
+} fuzzy_match;
+
+typedef struct fuzzy {
+    const ls_table *table;
+    unsigned generation; /* of the listing the masks were built for */
+    unsigned *masks;     /* characters present in each name */
+    unsigned *starts;    /* the ones of them that start a word */
+    char *pool;          /* every bare name folded to lowercase, NUL terminated */
+    size_t *offsets;     /* of each row's name in pool, one more for the end */
+    char query[FUZZY_MAX_QUERY + 1];
+    int len;
+    int *levels[FUZZY_MAX_QUERY + 1]; /* rows matching the first i characters where built, 0 is every row */
+    int level_count[FUZZY_MAX_QUERY + 1];
+    fuzzy_match *top; /* best first */
+    int top_count;
+    struct trigram_index *trigrams; /* for substring queries in big listings, built by the first one */
+    int *exact;                     /* rows the last substring query matched */
+    int exact_count;
+} fuzzy;
+
+void fuzzy_init(fuzzy *fz);
+
+/* matches `query` against the names of t, a listing of `generation`. candidates of the longest
+ * query it shares a prefix with are reused. fills top with the best `limit` matches and returns
+ * how many names match, -1 if memory runs out */
+int fuzzy_query(fuzzy *fz, const ls_table *t, unsigned generation, const char *query, int limit);
+
+/* every row the last query matched, in no particular order, and sets *count to how many. NULL
+ * when it was empty and matched every row */
+const int *fuzzy_all(const fuzzy *fz, int *count);
+
+/* matches one name against a query as fuzzy_query() would, without any state. fills positions
+ * with the index of every matched character of name and returns how many, -1 if it does not match */
+int fuzzy_positions(const char *name, int len, const char *query, int *positions);
+
+void fuzzy_free(fuzzy *fz);
+
+#endif
@@ -0,0 +1,303 @@
+/* Copyright 2025 Henryk Szenkowicz Holtman
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files(the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in all copies
+    or
+    substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED “AS IS”,
+    WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "grep.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* shorter required literals let through too many lines to be worth looking for first */
+#define GREP_MUST_MIN 3
+
+/* lines searched between two questions whether to go on, see grep_hit */
+#define GREP_CHUNK (1024 * 1024)
+
+const char *grep_literal(const char *hay, size_t n, const char *needle, size_t m) {
+
+    if (n < m) {
+        return NULL;
+    }
+
+    if (m == 1) {
+        return memchr(hay, needle[0], n);
+    }
+
+    size_t i = 0;
+
+#ifdef __SSE2__
+    /* 16 candidate positions at a time: only where both the first and the last byte of the needle
+     * line up does memcmp() get to look */
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[m - 1]);
+
+    for (; i + m - 1 + 16 <= n; i += 16) {
+
+        __m128i a = _mm_loadu_si128((const __m128i *)(hay + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(hay + i + m - 1));
+        unsigned mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+
+        while (mask) {
+
+            int k = __builtin_ctz(mask);
+            mask &= mask - 1;
+
+            if (memcmp(hay + i + k + 1, needle + 1, m - 2) == 0) {
+                return hay + i + k;
+            }
+        }
+    }
+#endif
+
+    /* what is left, or everything without SSE2 */
+    while (i + m <= n) {
+
+        const char *p = memchr(hay + i, needle[0], n - m + 1 - i);
+        if (!p) {
+            return NULL;
+        }
+
+        if (memcmp(p + 1, needle + 1, m - 1) == 0) {
+            return p;
+        }
+
+        i = p - hay + 1;
+    }
+
+    return NULL;
+}
+
+long grep_count_lines(const char *p, size_t n) {
+
+    long lines = 0;
+    size_t i = 0;
+
+#ifdef __SSE2__
+    const __m128i newline = _mm_set1_epi8('\n');
+
+    for (; i + 16 <= n; i += 16) {
+
+        __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+        lines += __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(v, newline)));
+    }
+#endif
+
+    for (; i < n; i++) {
+        lines += p[i] == '\n';
+    }
+
+    return lines;
+}
+
+/* the longest run of plain characters outside any group of an extended regex. every match has to
+ * contain it, unless the regex has alternatives, then nothing is certain and it is left empty */
+static void regex_must(grep_pattern *p, const char *re) {
+
+    size_t best = 0, best_at = 0, run = 0, run_at = 0;
+    int depth = 0;
+    char *lit = p->literal;
+
+    for (const char *s = re; *s; s++) {
+
+        char c = *s;
+        int plain = 0;
+
+        if (c == '|') {
+
+            best = run = 0;
+            break;
+
+        } else if (c == '\\' && s[1]) {
+
+            /* \. is a dot, \w and friends are classes, \< \> \` \' match no character at all */
+            c = *++s;
+            plain = depth == 0 && !(c >= 'a' && c <= 'z') && !(c >= 'A' && c <= 'Z') && !(c >= '0' && c <= '9') &&
+                    !strchr("<>`'", c);
+
+        } else if (c == '(') {
+
+            depth++;
+
+        } else if (c == ')') {
+
+            depth -= depth > 0;
+
+        } else if (c == '[') {
+
+            /* a bracket expression is one character of a set, a ']' right after the '[' or '^' is in it */
+            s += s[1] == '^';
+            s += s[1] == ']';
+            while (s[1] && s[1] != ']') {
+                s++;
+            }
+            s += s[1] == ']';
+
+        } else if (c == '*' || c == '?' || c == '{') {
+
+            /* the character before may not be there at all */
+            run -= run > 0;
+
+            while (c == '{' && s[1] && s[1] != '}') {
+                s++;
+            }
+
+        } else {
+
+            plain = depth == 0 && !strchr(".^$+}", c);
+        }
+
+        if (plain) {
+
+            if (run == 0) {
+                run_at = s - re;
+            }
+            lit[run_at + run++] = c;
+            continue;
+        }
+
+        if (run > best) {
+
+            best = run;
+            best_at = run_at;
+        }
+        run = 0;
+    }
+
+    if (run > best) {
+
+        best = run;
+        best_at = run_at;
+    }
+
+    p->literal_len = best >= GREP_MUST_MIN ? best : 0;
+    memmove(lit, lit + best_at, p->literal_len);
+    lit[p->literal_len] = '\0';
+}
+
+int grep_compile(grep_pattern *p, const char *pattern, int regex) {
+
+    memset(p, 0, sizeof(*p));
+    p->regex = regex;
+    p->literal = strdup(pattern);
+
+    if (!p->literal) {
+        return -1;
+    }
+
+    p->literal_len = strlen(pattern);
+
+    if (!regex) {
+        return 0;
+    }
+
+    if (regcomp(&p->re, pattern, REG_EXTENDED | REG_NEWLINE) != 0) {
+
+        free(p->literal);
+        p->literal = NULL;
+        return -1;
+    }
+
+    regex_must(p, pattern);
+    return 0;
+}
+
+void grep_free(grep_pattern *p) {
+
+    if (p->regex && p->literal) {
+        regfree(&p->re);
+    }
+
+    free(p->literal);
+    p->literal = NULL;
+}
+
+/* REG_STARTEND bounds the search, so the buffer needs no NUL and lines need no copy */
+static int regex_match(const grep_pattern *p, const char *data, size_t from, size_t to, size_t *at) {
+
+    regmatch_t m[1];
+    m[0].rm_so = from;
+    m[0].rm_eo = to;
+
+    if (regexec(&p->re, data, 1, m, REG_STARTEND) != 0) {
+        return 0;
+    }
+
+    *at = m[0].rm_so;
+    return 1;
+}
+
+long grep_buffer(const grep_pattern *p, const char *data, size_t size, grep_hit hit, void *ctx) {
+
+    size_t pos = 0, counted = 0, limit = 0;
+    long line = 1, hits = 0;
+
+    while (pos < size) {
+
+        /* the search stops at whole lines, a regex does not run past them with REG_NEWLINE */
+        if (pos >= limit) {
+
+            if (pos > 0 && hit(ctx, 0, NULL, 0)) {
+                break;
+            }
+
+            const char *nl = size - pos > GREP_CHUNK ? memchr(data + pos + GREP_CHUNK, '\n', size - pos - GREP_CHUNK) : NULL;
+            limit = nl ? (size_t)(nl - data) + 1 : size;
+        }
+
+        size_t at;
+
+        if (p->literal_len > 0) {
+
+            const char *found = grep_literal(data + pos, limit - pos, p->literal, p->literal_len);
+            if (!found) {
+
+                pos = limit;
+                continue;
+            }
+            at = found - data;
+
+        } else if (!regex_match(p, data, pos, limit, &at) || (at == limit && data[limit - 1] == '\n')) {
+
+            /* an empty match past the last newline is on the next line, if there is one */
+            pos = limit;
+            continue;
+        }
+
+        size_t start = at;
+        while (start > pos && data[start - 1] != '\n') {
+            start--;
+        }
+
+        const char *nl = memchr(data + at, '\n', limit - at);
+        size_t end = nl ? (size_t)(nl - data) : limit;
+
+        pos = end + 1;
+
+        /* the literal only says the line may match */
+        if (p->regex && p->literal_len > 0 && !regex_match(p, data, start, end, &at)) {
+            continue;
+        }
+
+        line += grep_count_lines(data + counted, start - counted);
+        counted = start;
+        hits++;
+
+        if (hit(ctx, line, data + start, end - start)) {
+            break;
+        }
+    }
+
+    return hits;
+}
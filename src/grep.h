@@ -0,0 +1,36 @@
+#ifndef GREP_H
+#define GREP_H
+
+#include <regex.h>
+#include <stddef.h>
+
+/* line by line matching of a literal or an extended regex over a buffer, like grep does over a
+ * file. a literal is looked for with a SIMD prefilter on its first and last byte, a regex only
+ * runs on the lines holding the longest literal every match of it must contain, if it has one */
+
+typedef struct grep_pattern {
+    int regex;
+    regex_t re;
+    char *literal; /* the pattern itself, or what a regex match can't do without. may be empty */
+    size_t literal_len;
+} grep_pattern;
+
+/* returns -1 if the regex does not compile or memory runs out */
+int grep_compile(grep_pattern *p, const char *pattern, int regex);
+void grep_free(grep_pattern *p);
+
+/* called with every matching line, 1 based, text runs up to the newline. return non-zero to stop.
+ * a big buffer is searched a chunk at a time and between two of them hit is called with line 0 and
+ * text NULL, only to ask whether to stop, so a search that finds nothing can still be cut short */
+typedef int (*grep_hit)(void *ctx, long line, const char *text, size_t len);
+
+/* searches data[0, size), which needs no terminating NUL. returns the number of matching lines */
+long grep_buffer(const grep_pattern *p, const char *data, size_t size, grep_hit hit, void *ctx);
+
+/* memmem() for needles of at least one byte */
+const char *grep_literal(const char *hay, size_t n, const char *needle, size_t m);
+
+/* newlines in p[0, n) */
+long grep_count_lines(const char *p, size_t n);
+
+#endif
@@ -0,0 +1,370 @@
+/* Copyright 2025 Henryk Szenkowicz Holtman
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files(the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in all copies
+    or
+    substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED “AS IS”,
+    WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "hits.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void hits_init(ls_hits *h) {
+
+    memset(h, 0, sizeof(*h));
+    h->shown_count = -1;
+    h->current = -1;
+}
+
+void hits_free(ls_hits *h) {
+
+    free(h->bits);
+    free(h->fresh);
+    free(h->shown);
+    hits_init(h);
+}
+
+/* both bitmaps hold at least `rows` bits, the new words are zero */
+static int reserve_bits(ls_hits *h, int rows) {
+
+    int need = (rows + 63) / 64;
+
+    if (need <= h->words) {
+        return 0;
+    }
+
+    int words = h->words ? h->words * 2 : 64;
+    if (words < need) {
+        words = need;
+    }
+
+    unsigned long long *bits = realloc(h->bits, words * sizeof(*bits));
+    if (bits) {
+        h->bits = bits;
+    }
+
+    unsigned long long *fresh = realloc(h->fresh, words * sizeof(*fresh));
+    if (fresh) {
+        h->fresh = fresh;
+    }
+
+    if (!bits || !fresh) {
+        return -1;
+    }
+
+    memset(h->bits + h->words, 0, (words - h->words) * sizeof(*bits));
+    memset(h->fresh + h->words, 0, (words - h->words) * sizeof(*fresh));
+    h->words = words;
+    return 0;
+}
+
+static inline unsigned long long low_mask(int bits) {
+
+    return bits ? ~0ULL >> (64 - bits) : 0;
+}
+
+/* the 64 bits starting at bit p, zero wherever that is outside the first `words` words */
+static unsigned long long bits_at(const unsigned long long *w, int words, long long p) {
+
+    if (p <= -64 || p >= (long long)words * 64) {
+        return 0;
+    } else if (p < 0) {
+        return w[0] << -p;
+    }
+
+    int i = p / 64, shift = p % 64;
+    unsigned long long v = w[i] >> shift;
+
+    if (shift && i + 1 < words) {
+        v |= w[i + 1] << (64 - shift);
+    }
+
+    return v;
+}
+
+static void fill_bits(unsigned long long *w, int at, int n, int on) {
+
+    while (n > 0) {
+
+        int shift = at % 64;
+        int k = 64 - shift < n ? 64 - shift : n;
+        unsigned long long mask = low_mask(k) << shift;
+
+        w[at / 64] = on ? w[at / 64] | mask : w[at / 64] & ~mask;
+        at += k;
+        n -= k;
+    }
+}
+
+/* moves the bits from `at` on up by n, a word at a time from the top. the n opened are zero */
+static void open_bits(unsigned long long *w, int rows, int at, int n) {
+
+    int first = at / 64, last = (rows + n + 63) / 64;
+    unsigned long long below = w[first] & low_mask(at % 64);
+
+    for (int i = last - 1; i >= first; i--) {
+        w[i] = bits_at(w, last, (long long)i * 64 - n);
+    }
+
+    w[first] = (w[first] & ~low_mask(at % 64)) | below;
+    fill_bits(w, at, n, 0);
+}
+
+/* drops n bits at `at`, the ones above move down. the bits past rows are zero, so the top fills with zeros */
+static void close_bits(unsigned long long *w, int rows, int at, int n) {
+
+    int first = at / 64, last = (rows + 63) / 64;
+    unsigned long long below = w[first] & low_mask(at % 64);
+
+    for (int i = first; i < last; i++) {
+        w[i] = bits_at(w, last, (long long)i * 64 + n);
+    }
+
+    w[first] = (w[first] & ~low_mask(at % 64)) | below;
+}
+
+static int matches(const ls_hits *h, const ls_table *t, int row) {
+
+    int positions[FUZZY_MAX_QUERY];
+    return fuzzy_positions(t->fname[row], t->name_len[row], h->query, positions) >= 0;
+}
+
+static void recount(ls_hits *h) {
+
+    h->count = 0;
+    for (int i = 0; i < (h->rows + 63) / 64; i++) {
+        h->count += __builtin_popcountll(h->bits[i]);
+    }
+
+    h->shown_count = -1;
+}
+
+static void follow(ls_hits *h, const ls_table *t) {
+
+    h->table = t;
+    h->serial = t->serial;
+    h->seen = t->change_count;
+}
+
+/* a table that is not the one the bits were made for */
+static int match_all(ls_hits *h, const ls_table *t) {
+
+    if (reserve_bits(h, t->count) != 0) {
+        return -1;
+    }
+
+    memset(h->bits, 0, h->words * sizeof(*h->bits));
+    memset(h->fresh, 0, h->words * sizeof(*h->fresh));
+    h->rows = t->count;
+
+    for (int row = 0; row < t->count; row++) {
+        if (matches(h, t, row)) {
+            h->bits[row / 64] |= 1ULL << (row % 64);
+        }
+    }
+
+    follow(h, t);
+    recount(h);
+    return 0;
+}
+
+int hits_set(ls_hits *h, const ls_table *t, const char *query, const int *rows, int count) {
+
+    hits_free(h);
+
+    if (!rows || !query[0]) {
+        return 0;
+    }
+
+    if (reserve_bits(h, t->count) != 0) {
+
+        hits_free(h);
+        return -1;
+    }
+
+    snprintf(h->query, sizeof(h->query), "%s", query);
+    h->rows = t->count;
+
+    for (int i = 0; i < count; i++) {
+        h->bits[rows[i] / 64] |= 1ULL << (rows[i] % 64);
+    }
+
+    follow(h, t);
+    recount(h);
+    return 0;
+}
+
+/* the changes move the bits, opened rows are marked fresh and matched once they are all in, so
+ * they are read where they ended up. returns -1 if the rows don't add up or memory runs out */
+static int replay(ls_hits *h, const ls_table *t, const table_change *changes, int count) {
+
+    for (int i = 0; i < count; i++) {
+
+        int at = changes[i].at, n = changes[i].rows;
+
+        if (n > 0) {
+
+            if (at > h->rows || reserve_bits(h, h->rows + n) != 0) {
+                return -1;
+            }
+
+            open_bits(h->bits, h->rows, at, n);
+            open_bits(h->fresh, h->rows, at, n);
+            fill_bits(h->fresh, at, n, 1);
+
+        } else {
+
+            if (at - n > h->rows) {
+                return -1;
+            }
+
+            close_bits(h->bits, h->rows, at, -n);
+            close_bits(h->fresh, h->rows, at, -n);
+        }
+
+        h->rows += n;
+    }
+
+    if (h->rows != t->count) {
+        return -1;
+    }
+
+    for (int i = 0; i < (h->rows + 63) / 64; i++) {
+
+        while (h->fresh[i]) {
+
+            int row = i * 64 + __builtin_ctzll(h->fresh[i]);
+            h->fresh[i] &= h->fresh[i] - 1;
+
+            if (matches(h, t, row)) {
+                h->bits[i] |= 1ULL << (row % 64);
+            }
+        }
+    }
+
+    return 0;
+}
+
+int hits_update(ls_hits *h, const ls_table *t) {
+
+    if (!h->query[0]) {
+        return 0;
+    }
+
+    int count = 0;
+    const table_change *changes = h->table == t ? table_changes(t, h->serial, h->seen, &count) : NULL;
+    int ret;
+
+    if (changes && count == 0) {
+        return 0;
+    }
+
+    if (changes && replay(h, t, changes, count) == 0) {
+
+        follow(h, t);
+        recount(h);
+        ret = 0;
+
+    } else {
+
+        ret = match_all(h, t);
+    }
+
+    if (ret != 0) {
+        hits_free(h);
+    }
+
+    return ret;
+}
+
+/* the display indices of the hits, in the listing's current order */
+static int make_shown(ls_hits *h, const ls_listing *listing) {
+
+    int *shown = realloc(h->shown, (h->count > 0 ? h->count : 1) * sizeof(int));
+    if (!shown) {
+        return -1;
+    }
+
+    h->shown = shown;
+    h->shown_count = 0;
+
+    if (listing->order) {
+
+        for (int index = 0; index < listing->table.count; index++) {
+            if (hits_test(h, listing->order[index])) {
+                shown[h->shown_count++] = index;
+            }
+        }
+
+    } else {
+
+        for (int i = 0; i < (h->rows + 63) / 64; i++) {
+
+            for (unsigned long long w = h->bits[i]; w; w &= w - 1) {
+                shown[h->shown_count++] = i * 64 + __builtin_ctzll(w);
+            }
+        }
+    }
+
+    h->shown_generation = listing->generation;
+    h->current = -1;
+    return 0;
+}
+
+int hits_next(ls_hits *h, const ls_listing *listing, int selected, int forward) {
+
+    if (h->count == 0) {
+        return -1;
+    }
+
+    if ((h->shown_count < 0 || h->shown_generation != listing->generation) && make_shown(h, listing) != 0) {
+        return -1;
+    }
+
+    int m = h->shown_count;
+
+    if (m == 0) {
+        return -1;
+    }
+
+    /* pressed again where the last jump went, the neighbour in the list */
+    if (h->current >= 0 && h->current < m && h->shown[h->current] == selected) {
+
+        h->current = forward ? (h->current + 1) % m : (h->current + m - 1) % m;
+        return h->shown[h->current];
+    }
+
+    /* the cursor moved, the first hit past it (or before it) */
+    int lo = 0, hi = m;
+
+    while (lo < hi) {
+
+        int mid = lo + (hi - lo) / 2;
+
+        if (forward ? h->shown[mid] <= selected : h->shown[mid] < selected) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    h->current = forward ? (lo == m ? 0 : lo) : (lo == 0 ? m - 1 : lo - 1);
+    return h->shown[h->current];
+}
+
+int hits_ordinal(const ls_hits *h, const ls_listing *listing, int selected) {
+
+    if (h->shown_count < 0 || h->shown_generation != listing->generation || h->current < 0 ||
+        h->current >= h->shown_count || h->shown[h->current] != selected) {
+        return 0;
+    }
+
+    return h->current + 1;
+}
@@ -0,0 +1,52 @@
+#ifndef HITS_H
+#define HITS_H
+
+#include "fuzzy.h"
+#include "listing.h"
+
+/* the rows a search matched, kept after the finder closed so the cursor can go from one to the next.
+ * they are one bit per row, and the bits follow the table's change log: rows that come and go shift
+ * them, and only rows that came in since are matched again. jumping walks an ascending list of
+ * their display indices, made again only when the listing changed */
+
+typedef struct ls_hits {
+    char query[FUZZY_MAX_QUERY + 1]; /* empty while there is no search */
+    unsigned long long *bits;        /* one per row */
+    unsigned long long *fresh;       /* rows opened since the last update, to be matched */
+    int rows;                        /* bits in use, the ones past them are zero */
+    int words;                       /* allocated in each of the two */
+    int count;                       /* bits set */
+    const ls_table *table;
+    unsigned serial; /* of the table when last updated */
+    int seen;        /* changes of it already followed */
+    int *shown;      /* display indices of the hits, ascending */
+    int shown_count; /* -1 when shown has to be made again */
+    unsigned shown_generation;
+    int current; /* index into shown of the hit last jumped to */
+} ls_hits;
+
+void hits_init(ls_hits *h);
+
+/* searches t for query, starting with the rows the finder matched. NULL rows, for a query that
+ * matched every row, ends the search. returns -1 if memory runs out */
+int hits_set(ls_hits *h, const ls_table *t, const char *query, const int *rows, int count);
+
+/* follows what happened to t since the last call. a table that was replaced or reordered is matched
+ * again from scratch. returns -1 if memory runs out, which ends the search */
+int hits_update(ls_hits *h, const ls_table *t);
+
+static inline int hits_test(const ls_hits *h, int row) {
+
+    return row >= 0 && row < h->rows && (h->bits[row / 64] >> (row % 64) & 1);
+}
+
+/* the display index of the first hit after `selected`, or the last one before it when forward is 0,
+ * going round at either end. -1 when nothing matches. the hits have to be up to date */
+int hits_next(ls_hits *h, const ls_listing *listing, int selected, int forward);
+
+/* which hit, counting from 1, the cursor is on after a jump. 0 if it moved elsewhere since */
+int hits_ordinal(const ls_hits *h, const ls_listing *listing, int selected);
+
+void hits_free(ls_hits *h);
+
+#endif
@@ -0,0 +1,644 @@
+/* Copyright 2025 Henryk Szenkowicz Holtman
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files(the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in all copies
+    or
+    substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED “AS IS”,
+    WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "index.h"
+#include "config.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/* columns are written through a buffer of at most this size */
+#define INDEX_WRITE_BLOCK (1024 * 1024)
+
+#define SLOTS_BYTES (INDEX_SLOTS * sizeof(index_slot))
+#define RECORDS_START (sizeof(index_header) + SLOTS_BYTES)
+
+static size_t pad8(size_t n) {
+
+    return (n + 7) & ~(size_t)7;
+}
+
+static size_t columns_size(size_t count, size_t names_bytes) {
+
+    return 4 * pad8(count * 4) + 2 * pad8(count * 8) + pad8(count * 2) + pad8(count) + pad8(names_bytes);
+}
+
+/* len is a multiple of 8, which every padded column is */
+static uint64_t checksum(uint64_t hash, const unsigned char *p, size_t len) {
+
+    for (size_t i = 0; i < len; i += 8) {
+
+        uint64_t word;
+        memcpy(&word, p + i, 8);
+        hash = (hash ^ word) * 1099511628211ULL;
+        hash ^= hash >> 29;
+    }
+
+    return hash;
+}
+
+static size_t slot_of(uint64_t dev, uint64_t ino) {
+
+    return ((ino * 0x9e3779b97f4a7c15ULL) ^ dev) % INDEX_SLOTS;
+}
+
+/* the slot holding (dev, ino), or the free one it would go into. -1 when the table is full */
+static int find_slot(const index_slot *slots, uint64_t dev, uint64_t ino) {
+
+    size_t slot = slot_of(dev, ino);
+
+    for (int i = 0; i < INDEX_SLOTS; i++) {
+
+        const index_slot *s = &slots[slot];
+
+        if (s->ino == 0 || (s->dev == dev && s->ino == ino)) {
+            return (int)slot;
+        }
+
+        slot = (slot + 1) % INDEX_SLOTS;
+    }
+
+    return -1;
+}
+
+static int index_path(char *out, size_t size, int create) {
+
+    const char *cache = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    char dir[PATH_MAX];
+
+    if (cache && cache[0] == '/') {
+        snprintf(dir, sizeof(dir), "%s", cache);
+    } else if (home && home[0] == '/') {
+        snprintf(dir, sizeof(dir), "%s/.cache", home);
+    } else {
+        return -1;
+    }
+
+    if (create) {
+        mkdir(dir, 0700);
+    }
+
+    size_t len = strlen(dir);
+    snprintf(dir + len, sizeof(dir) - len, "/tired");
+
+    if (create && mkdir(dir, 0700) != 0 && errno != EEXIST) {
+        return -1;
+    }
+
+    int ret = snprintf(out, size, "%s/index", dir);
+    return ret < 0 || (size_t)ret >= size ? -1 : 0;
+}
+
+static int header_valid(const index_header *h) {
+
+    return memcmp(h->magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) == 0 && h->version == INDEX_VERSION &&
+           h->slots == INDEX_SLOTS && h->end >= RECORDS_START;
+}
+
+/* checks a record found in a mapping of file_size bytes and returns its columns, or NULL */
+static const unsigned char *record_columns(const unsigned char *map, size_t file_size, const index_slot *slot) {
+
+    if (slot->offset < RECORDS_START || slot->offset % 8 != 0 || slot->size < sizeof(index_record) ||
+        slot->offset > file_size || slot->size > file_size - slot->offset) {
+        return NULL;
+    }
+
+    const index_record *r = (const index_record *)(map + slot->offset);
+
+    if (r->dev != slot->dev || r->ino != slot->ino ||
+        slot->size != sizeof(index_record) + columns_size(r->count, r->names_bytes)) {
+        return NULL;
+    }
+
+    const unsigned char *columns = (const unsigned char *)(r + 1);
+
+    if (checksum(0, columns, slot->size - sizeof(index_record)) != r->checksum) {
+        return NULL;
+    }
+
+    return columns;
+}
+
+/* copies the columns of a checked record into the table */
+static int fill_table(const index_record *r, const unsigned char *p, ls_table *t) {
+
+    size_t n = r->count;
+
+    if (n > INT_MAX || table_insert_rows(t, 0, (int)n) != 0) {
+        return -1;
+    }
+
+    const uint32_t *mode = (const uint32_t *)p;
+    const uint32_t *nlink = (const uint32_t *)(p += pad8(n * 4));
+    const uint32_t *uid = (const uint32_t *)(p += pad8(n * 4));
+    const uint32_t *gid = (const uint32_t *)(p += pad8(n * 4));
+    const int64_t *size = (const int64_t *)(p += pad8(n * 4));
+    const int64_t *mtime = (const int64_t *)(p += pad8(n * 8));
+    const uint16_t *name_len = (const uint16_t *)(p += pad8(n * 8));
+    const uint8_t *type = (const uint8_t *)(p += pad8(n * 2));
+    const char *names = (const char *)(p += pad8(n));
+
+    char *copy = arena_alloc(&t->arena, r->names_bytes + 1);
+    if (!copy) {
+        return -1;
+    }
+
+    memcpy(copy, names, r->names_bytes);
+    copy[r->names_bytes] = '\0';
+
+    size_t pos = 0;
+
+    for (size_t i = 0; i < n; i++) {
+
+        size_t len = strlen(copy + pos);
+
+        /* every name has to end inside the block and the bare name inside the shown one */
+        if (pos + len >= r->names_bytes || name_len[i] > len || type[i] > file_link) {
+            return -1;
+        }
+
+        t->fname[i] = copy + pos;
+        t->name_len[i] = name_len[i];
+        t->type[i] = type[i];
+        t->mode[i] = mode[i];
+        t->nlink[i] = nlink[i];
+        t->uid[i] = uid[i];
+        t->gid[i] = gid[i];
+        t->size[i] = size[i];
+        t->mtime[i] = mtime[i];
+        pos += len + 1;
+    }
+
+    for (int i = 0; i < 6; i++) {
+        t->widths[i] = r->widths[i];
+    }
+
+    return 0;
+}
+
+int index_load(unsigned long long dev, unsigned long long ino, ls_table *t, listing_key *stored) {
+
+    char path[PATH_MAX];
+
+    if (!USE_INDEX || ino == 0 || index_path(path, sizeof(path), 0) != 0) {
+        return -1;
+    }
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+
+    struct stat st;
+    void *map = MAP_FAILED;
+    int ret = -1;
+
+    if (flock(fd, LOCK_SH) != 0 || fstat(fd, &st) != 0 || (size_t)st.st_size < RECORDS_START) {
+        goto out;
+    }
+
+    /* mapped rather than read, only the pages of the one record that is wanted get touched */
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        goto out;
+    }
+
+    const index_header *h = map;
+    const index_slot *slots = (const index_slot *)(h + 1);
+
+    if (!header_valid(h)) {
+        goto out;
+    }
+
+    int slot = find_slot(slots, dev, ino);
+    if (slot < 0 || slots[slot].ino == 0) {
+        goto out;
+    }
+
+    const unsigned char *columns = record_columns(map, st.st_size, &slots[slot]);
+    if (!columns) {
+        goto out;
+    }
+
+    const index_record *r = (const index_record *)((const unsigned char *)map + slots[slot].offset);
+
+    if (fill_table(r, columns, t) != 0) {
+
+        table_free(t);
+        table_init(t, 1);
+        goto out;
+    }
+
+    stored->dev = r->dev;
+    stored->ino = r->ino;
+    stored->mtime_sec = r->mtime_sec;
+    stored->mtime_nsec = r->mtime_nsec;
+    stored->ctime_sec = r->ctime_sec;
+    stored->ctime_nsec = r->ctime_nsec;
+    ret = 0;
+
+out:
+    if (map != MAP_FAILED) {
+        munmap(map, st.st_size);
+    }
+
+    close(fd);
+    return ret;
+}
+
+/* opens the index for writing and locks it. a rewrite by another process may have renamed a new
+ * file over the one just locked, in that case the new one is tried */
+static int index_lock(const char *path) {
+
+    for (int attempt = 0; attempt < 8; attempt++) {
+
+        int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+        if (fd < 0) {
+            return -1;
+        }
+
+        struct stat locked, current;
+
+        if (flock(fd, LOCK_EX) == 0 && fstat(fd, &locked) == 0 && stat(path, &current) == 0 &&
+            locked.st_ino == current.st_ino && locked.st_dev == current.st_dev) {
+            return fd;
+        }
+
+        close(fd);
+    }
+
+    return -1;
+}
+
+static int write_all(int fd, const void *buf, size_t len, off_t offset) {
+
+    const char *p = buf;
+
+    while (len > 0) {
+
+        ssize_t written = pwrite(fd, p, len, offset);
+        if (written <= 0) {
+            return -1;
+        }
+
+        p += written;
+        len -= written;
+        offset += written;
+    }
+
+    return 0;
+}
+
+static int read_all(int fd, void *buf, size_t len, off_t offset) {
+
+    char *p = buf;
+
+    while (len > 0) {
+
+        ssize_t got = pread(fd, p, len, offset);
+        if (got <= 0) {
+            return -1;
+        }
+
+        p += got;
+        len -= got;
+        offset += got;
+    }
+
+    return 0;
+}
+
+static int write_empty(int fd, index_header *h, index_slot *slots) {
+
+    memset(h, 0, sizeof(*h));
+    memcpy(h->magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    h->version = INDEX_VERSION;
+    h->slots = INDEX_SLOTS;
+    h->end = RECORDS_START;
+    memset(slots, 0, SLOTS_BYTES);
+
+    if (ftruncate(fd, 0) != 0 || write_all(fd, h, sizeof(*h), 0) != 0 ||
+        write_all(fd, slots, SLOTS_BYTES, sizeof(*h)) != 0) {
+        return -1;
+    }
+
+    return 0;
+}
+
+typedef struct live_record {
+    index_slot slot;
+    int64_t stored_at;
+} live_record;
+
+static int newest_first(const void *a, const void *b) {
+
+    const live_record *ra = a;
+    const live_record *rb = b;
+    return (ra->stored_at < rb->stored_at) - (ra->stored_at > rb->stored_at);
+}
+
+/* writes the most recent records that fill half of the limits into a new file and renames it
+ * over the index, fd is the locked old one */
+static int index_compact(int fd, const char *path, const index_slot *slots) {
+
+    char tmp_path[PATH_MAX + 8];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.new", path);
+
+    live_record *live = malloc(INDEX_SLOTS * sizeof(live_record));
+    index_slot *new_slots = malloc(SLOTS_BYTES);
+    char *buf = malloc(INDEX_WRITE_BLOCK);
+    int count = 0, out = -1, ret = -1;
+    index_header h;
+
+    if (!live || !new_slots || !buf) {
+        goto done;
+    }
+
+    for (int i = 0; i < INDEX_SLOTS; i++) {
+
+        index_record r;
+
+        if (slots[i].ino != 0 && read_all(fd, &r, sizeof(r), slots[i].offset) == 0) {
+
+            live[count].slot = slots[i];
+            live[count].stored_at = r.stored_at;
+            count++;
+        }
+    }
+
+    qsort(live, count, sizeof(live_record), newest_first);
+
+    out = open(tmp_path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (out < 0 || write_empty(out, &h, new_slots) != 0) {
+        goto done;
+    }
+
+    int kept = 0;
+
+    for (int i = 0; i < count && kept < INDEX_SLOTS * 3 / 8; i++) {
+
+        const index_slot *s = &live[i].slot;
+
+        if (h.end + s->size > INDEX_MAX_BYTES / 2) {
+            continue;
+        }
+
+        for (uint64_t copied = 0; copied < s->size;) {
+
+            size_t len = s->size - copied < INDEX_WRITE_BLOCK ? s->size - copied : INDEX_WRITE_BLOCK;
+
+            if (read_all(fd, buf, len, s->offset + copied) != 0 || write_all(out, buf, len, h.end + copied) != 0) {
+                goto done;
+            }
+
+            copied += len;
+        }
+
+        int slot = find_slot(new_slots, s->dev, s->ino);
+        new_slots[slot] = *s;
+        new_slots[slot].offset = h.end;
+        h.end += s->size;
+        kept++;
+    }
+
+    if (write_all(out, &h, sizeof(h), 0) != 0 || write_all(out, new_slots, SLOTS_BYTES, sizeof(h)) != 0 ||
+        rename(tmp_path, path) != 0) {
+        goto done;
+    }
+
+    ret = 0;
+
+done:
+    if (out >= 0) {
+
+        close(out);
+        if (ret != 0) {
+            unlink(tmp_path);
+        }
+    }
+
+    free(live);
+    free(new_slots);
+    free(buf);
+    return ret;
+}
+
+/* buffers the columns of a record on their way to the file and checksums them */
+typedef struct column_writer {
+    int fd;
+    off_t offset;
+    unsigned char *buf;
+    size_t fill;
+    uint64_t sum;
+    int failed;
+} column_writer;
+
+static void writer_flush(column_writer *w) {
+
+    w->sum = checksum(w->sum, w->buf, w->fill);
+
+    if (!w->failed && write_all(w->fd, w->buf, w->fill, w->offset) != 0) {
+        w->failed = 1;
+    }
+
+    w->offset += w->fill;
+    w->fill = 0;
+}
+
+/* the block size is a multiple of 8, so only the last flush can see a partial word */
+static void writer_put(column_writer *w, const void *src, size_t len) {
+
+    const unsigned char *from = src;
+
+    while (len > 0) {
+
+        size_t chunk = INDEX_WRITE_BLOCK - w->fill < len ? INDEX_WRITE_BLOCK - w->fill : len;
+
+        memcpy(w->buf + w->fill, from, chunk);
+        w->fill += chunk;
+        from += chunk;
+        len -= chunk;
+
+        if (w->fill == INDEX_WRITE_BLOCK) {
+            writer_flush(w);
+        }
+    }
+}
+
+static void writer_pad(column_writer *w) {
+
+    static const unsigned char zeros[8];
+    writer_put(w, zeros, pad8(w->fill) - w->fill);
+}
+
+/* the table's column types are converted to the fixed width ones of the format */
+#define WRITE_COLUMN(w, t, type, field)                                                                \
+    do {                                                                                               \
+        for (int i = 0; i < (t)->count; i++) {                                                         \
+            type value = (type)(t)->field[i];                                                          \
+            writer_put((w), &value, sizeof(value));                                                    \
+        }                                                                                              \
+        writer_pad(w);                                                                                 \
+    } while (0)
+
+/* writes the columns of t at offset and returns their checksum in sum */
+static int write_columns(int fd, const ls_table *t, off_t offset, uint64_t *sum) {
+
+    column_writer w = {fd, offset, malloc(INDEX_WRITE_BLOCK), 0, 0, 0};
+
+    if (!w.buf) {
+        return -1;
+    }
+
+    WRITE_COLUMN(&w, t, uint32_t, mode);
+    WRITE_COLUMN(&w, t, uint32_t, nlink);
+    WRITE_COLUMN(&w, t, uint32_t, uid);
+    WRITE_COLUMN(&w, t, uint32_t, gid);
+    WRITE_COLUMN(&w, t, int64_t, size);
+    WRITE_COLUMN(&w, t, int64_t, mtime);
+    WRITE_COLUMN(&w, t, uint16_t, name_len);
+    WRITE_COLUMN(&w, t, uint8_t, type);
+
+    for (int i = 0; i < t->count; i++) {
+        writer_put(&w, t->fname[i], strlen(t->fname[i]) + 1);
+    }
+
+    writer_pad(&w);
+    writer_flush(&w);
+    free(w.buf);
+
+    *sum = w.sum;
+    return w.failed ? -1 : 0;
+}
+
+int index_store(const listing_key *key, const ls_table *t) {
+
+    char path[PATH_MAX];
+
+    if (!USE_INDEX || !t->native || key->ino == 0 || index_path(path, sizeof(path), 1) != 0) {
+        return -1;
+    }
+
+    size_t names_bytes = 0;
+    for (int i = 0; i < t->count; i++) {
+        names_bytes += strlen(t->fname[i]) + 1;
+    }
+
+    uint64_t size = sizeof(index_record) + columns_size(t->count, names_bytes);
+
+    if (names_bytes > UINT32_MAX || RECORDS_START + size > INDEX_MAX_BYTES / 2) {
+        return -1;
+    }
+
+    index_slot *slots = malloc(SLOTS_BYTES);
+    if (!slots) {
+        return -1;
+    }
+
+    int ret = -1;
+
+    for (int attempt = 0; attempt < 2; attempt++) {
+
+        int fd = index_lock(path);
+        if (fd < 0) {
+            break;
+        }
+
+        index_header h;
+
+        /* a new, foreign or outdated file starts over */
+        if (read_all(fd, &h, sizeof(h), 0) != 0 || !header_valid(&h) ||
+            read_all(fd, slots, SLOTS_BYTES, sizeof(h)) != 0) {
+
+            if (write_empty(fd, &h, slots) != 0) {
+
+                close(fd);
+                break;
+            }
+        }
+
+        int slot = find_slot(slots, key->dev, key->ino);
+        int used = 0;
+
+        for (int i = 0; i < INDEX_SLOTS; i++) {
+            used += slots[i].ino != 0;
+        }
+
+        int is_new = slot < 0 || slots[slot].ino == 0;
+
+        if (h.end + size > INDEX_MAX_BYTES || (is_new && used + 1 > INDEX_SLOTS * 3 / 4)) {
+
+            int compacted = attempt == 0 && index_compact(fd, path, slots) == 0;
+            close(fd);
+
+            if (compacted) {
+                continue;
+            }
+
+            break;
+        }
+
+        index_record r = {0};
+        r.dev = key->dev;
+        r.ino = key->ino;
+        r.mtime_sec = key->mtime_sec;
+        r.mtime_nsec = key->mtime_nsec;
+        r.ctime_sec = key->ctime_sec;
+        r.ctime_nsec = key->ctime_nsec;
+        r.stored_at = time(NULL);
+        r.count = t->count;
+        r.names_bytes = names_bytes;
+
+        for (int i = 0; i < 6; i++) {
+            r.widths[i] = t->widths[i];
+        }
+
+        off_t offset = h.end;
+
+        if (write_columns(fd, t, offset + sizeof(r), &r.checksum) != 0 || write_all(fd, &r, sizeof(r), offset) != 0) {
+
+            close(fd);
+            break;
+        }
+
+        /* the space is taken before the slot points there, whatever happens in between only
+         * leaves garbage or a record that fails its checksum */
+        if (!is_new) {
+            h.garbage += slots[slot].size;
+        }
+
+        h.end += size;
+
+        index_slot s = {key->dev, key->ino, offset, size};
+
+        if (write_all(fd, &h, sizeof(h), 0) == 0 &&
+            write_all(fd, &s, sizeof(s), sizeof(h) + slot * sizeof(index_slot)) == 0) {
+            ret = 0;
+        }
+
+        close(fd);
+        break;
+    }
+
+    free(slots);
+    return ret;
+}
@@ -0,0 +1,78 @@
+#ifndef INDEX_H
+#define INDEX_H
+
+#include "listing.h"
+#include <stdint.h>
+
+/* a persistent index of big directory listings (USE_INDEX), so a directory that takes seconds to
+ * list shows up straight away the next time tired is started in it.
+ *
+ * file: $XDG_CACHE_HOME/tired/index, or ~/.cache/tired/index. Integers are in host byte order, the
+ * index is a cache of this machine's filesystems and is never moved. Offsets count from the start
+ * of the file and are multiples of 8.
+ *
+ *   header        index_header, see below
+ *   slots         INDEX_SLOTS index_slot, an open addressing hash on (dev, ino), ino 0 is free
+ *   records       appended one after the other up to header.end
+ *
+ * a record is an index_record followed by its columns, each padded to 8 bytes:
+ *   mode u32[count], nlink u32[count], uid u32[count], gid u32[count], size i64[count],
+ *   mtime i64[count], name_len u16[count], type u8[count], then count NUL terminated names
+ *   (names_bytes in total) as the native listing shows them, "dir/" or "link -> target".
+ * Rows are in name order, the way every listing is stored.
+ *
+ * rules:
+ * - a directory is looked up by (dev, ino). If its mtime and ctime still match the stored key,
+ *   no name was added, removed or renamed since, and the listing is used as is. Sizes and times
+ *   of the files inside may have changed without touching the directory; they are only as fresh
+ *   as the last full listing, F5 re-reads. Otherwise the stored rows are shown while the
+ *   directory is listed again in the background, and the new listing replaces them.
+ * - every complete native listing of at least INDEX_MIN_ENTRIES entries is stored, unless the
+ *   directory changed too recently to trust its mtime (the same racy check as the listing cache).
+ * - a new version of a directory is appended and its slot repointed, the old record becomes
+ *   garbage. Records carry a checksum of their columns, a torn or corrupt record reads as missing.
+ * - the file stays below INDEX_MAX_BYTES and at most 3/4 of the slots are used. When a record
+ *   doesn't fit, the index is rewritten with only the most recently stored records that fill half
+ *   of either limit. A single listing bigger than half of INDEX_MAX_BYTES is not stored.
+ * - writers hold an exclusive flock() on the file, readers a shared one. Rewrites go to a new file
+ *   that is renamed over the old one, so a reader's mapping always stays consistent.
+ * - a different magic or INDEX_VERSION makes the whole file count as empty, and it is recreated. */
+
+#define INDEX_MAGIC "TIREDIX"
+#define INDEX_VERSION 1
+#define INDEX_SLOTS 4096
+
+typedef struct index_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t slots;
+    uint64_t end;     /* where the next record goes */
+    uint64_t garbage; /* bytes of records no slot points to */
+    uint64_t reserved[4];
+} index_header;
+
+typedef struct index_slot {
+    uint64_t dev, ino;
+    uint64_t offset, size;
+} index_slot;
+
+typedef struct index_record {
+    uint64_t dev, ino;
+    int64_t mtime_sec, mtime_nsec;
+    int64_t ctime_sec, ctime_nsec;
+    int64_t stored_at;
+    uint32_t count;
+    uint32_t names_bytes;
+    int32_t widths[6];
+    uint64_t checksum; /* of the columns, padding included */
+    uint64_t reserved;
+} index_record;
+
+/* reads the stored listing of directory (dev, ino) into t, a fresh native table, and the key it
+ * was stored under into stored. returns -1 if there is none */
+int index_load(unsigned long long dev, unsigned long long ino, ls_table *t, listing_key *stored);
+
+/* stores a complete native listing, replacing the one stored for the same directory */
+int index_store(const listing_key *key, const ls_table *t);
+
+#endif
@@ -0,0 +1,1622 @@
+/* Copyright 2025 Henryk Szenkowicz Holtman
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files(the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in all copies
+    or
+    substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED “AS IS”,
+    WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "listing.h"
+#include "config.h"
+#include "index.h"
+#include "native.h"
+#include "watch.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* how often the main loop looks for new entries while a listing streams in */
+#define LISTING_POLL_MS 100
+
+/* rows are formatted when drawn, the last few pages worth stay formatted until the listing changes */
+#define PREFIX_CACHE_ROWS 64
+#define PREFIX_CACHE_LEN 160
+
+/* LS_COMMAND output is read in blocks of at least this size */
+#define LS_READ_BLOCK (64 * 1024)
+
+struct ls_loader {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t finished;
+    char *path;
+    int dfd;
+    FILE *fp;
+    struct timespec started;
+    int cancel;
+    int background; /* prefetch: never streams, runs niced and gives up past PREFETCH_MAX_ENTRIES,
+                       cleared by whichever side wins the compare-and-swap from 1 */
+    listing_key key;
+    arena arena; /* filled by the thread only, the names of published rows point into it */
+
+    /* everything below is guarded by lock */
+    ls_table pending; /* rows without an arena of their own */
+    ls_table final;
+    int has_final;
+    int *final_map;
+    int error; /* errno that cut the listing short */
+    int done;
+};
+
+void trim_newline(char *s) {
+    char *p = strchr(s, '\n');
+    if (p) {
+        *p = '\0';
+    }
+}
+
+void trim_executable_mark(char *s) {
+    char *p = strchr(s, '*');
+    if (p) {
+        *p = '\0';
+    }
+}
+
+/* start and end offsets of the first `max` space separated fields of line, returns how many it found.
+ * the edges between blank and non-blank bytes come out of a 16 byte compare mask where SSE2 is there */
+static int split_fields(const char *line, size_t len, int max, int *start, int *end) {
+
+    int n = 0;
+    int in_field = 0;
+    size_t i = 0;
+
+#ifdef __SSE2__
+    const __m128i space = _mm_set1_epi8(' ');
+
+    for (; i + 16 <= len && n < max; i += 16) {
+
+        __m128i v = _mm_loadu_si128((const __m128i *)(line + i));
+        unsigned blank = _mm_movemask_epi8(_mm_cmpeq_epi8(v, space));
+
+        /* bit k is set where byte k differs from the one before it */
+        unsigned edges = (blank ^ ((blank << 1) | !in_field)) & 0xffff;
+
+        while (edges && n < max) {
+
+            int k = __builtin_ctz(edges);
+            edges &= edges - 1;
+
+            if (blank & (1u << k)) {
+                end[n++] = i + k;
+            } else {
+                start[n] = i + k;
+            }
+        }
+
+        in_field = !(blank & 0x8000);
+    }
+#endif
+
+    for (; i < len && n < max; i++) {
+
+        int blank = line[i] == ' ';
+
+        if (!blank && !in_field) {
+
+            start[n] = i;
+            in_field = 1;
+
+        } else if (blank && in_field) {
+
+            end[n++] = i;
+            in_field = 0;
+        }
+    }
+
+    if (in_field && n < max) {
+        end[n++] = len;
+    }
+
+    return n;
+}
+
+int parse_ls_line(char *line, size_t len, ls_table *t) {
+
+    /* perm links owner group size month day time, devices print "major, minor" as their size */
+    int start[9], end[9];
+    int fields = (line[0] == 'c' || line[0] == 'b') ? 9 : 8;
+
+    if (split_fields(line, len, fields, start, end) < fields) {
+        return -1;
+    }
+
+    /* exactly one space follows the date, everything after it is the name, spaces included */
+    size_t offset = end[fields - 1] + 1;
+    if (offset >= len) {
+        return -1;
+    }
+
+    if (table_insert_rows(t, t->count, 1) != 0) {
+        return -1;
+    }
+
+    int row = t->count - 1;
+    char *fname = line + offset;
+    char perm = line[0];
+    int exec = memchr(line, 'x', end[0]) != NULL;
+
+    /* the row points into the read buffer, the prefix ends where fname starts */
+    t->prefix[row] = line;
+    t->fname[row] = fname;
+
+    /* -F marks and "-> target" follow the name, see native.c for what each type gets */
+    char *arrow = perm == 'l' ? strstr(fname, " -> ") : NULL;
+    int name_len = arrow ? (int)(arrow - fname) : (int)(len - offset);
+
+    if (name_len > 1 && strchr("dps", perm) != NULL) {
+
+        name_len--;
+
+    } else if (name_len > 1 && perm == '-' && exec && fname[name_len - 1] == '*') {
+
+        name_len--;
+    }
+
+    t->name_len[row] = name_len;
+
+    if (perm == 'd') {
+
+        t->type[row] = file_dir;
+
+    } else if (perm == 'l') {
+
+        t->type[row] = file_link;
+
+    } else if (perm == '-' && exec) {
+
+        t->type[row] = file_exec;
+
+    } else {
+
+        t->type[row] = file_reg;
+    }
+
+    return 0;
+}
+
+/* LS_COMMAND output is read straight into arena blocks and parsed in place, rows point into it.
+ * a line never straddles two blocks, so rows handed out earlier stay valid as more is read */
+typedef struct ls_reader {
+    int fd;
+    int eof;
+    char *buf;
+    size_t size;
+    size_t start, end; /* buf[start, end) is read but not yet returned */
+} ls_reader;
+
+static void ls_reader_init(ls_reader *r, int fd) {
+
+    memset(r, 0, sizeof(*r));
+    r->fd = fd;
+}
+
+/* the next line with its '\n' replaced by '\0', NULL once the output ends */
+static char *ls_reader_line(ls_reader *r, arena *a, size_t *len) {
+
+    for (;;) {
+
+        char *nl = r->buf ? memchr(r->buf + r->start, '\n', r->end - r->start) : NULL;
+
+        if (nl || (r->eof && r->start < r->end)) {
+
+            char *line = r->buf + r->start;
+            char *stop = nl ? nl : r->buf + r->end;
+
+            *stop = '\0';
+            *len = stop - line;
+            r->start = nl ? (size_t)(nl - r->buf) + 1 : r->end;
+            return line;
+        }
+
+        if (r->eof) {
+            return NULL;
+        }
+
+        /* out of room: continue in a new block that fits the partial line at least twice */
+        if (!r->buf || r->end + 1 >= r->size) {
+
+            size_t tail = r->buf ? r->end - r->start : 0;
+            size_t size = LS_READ_BLOCK;
+
+            while (size < tail * 2 + 1) {
+                size *= 2;
+            }
+
+            char *buf = arena_alloc(a, size);
+            if (!buf) {
+                return NULL;
+            }
+
+            if (tail > 0) {
+                memcpy(buf, r->buf + r->start, tail);
+            }
+
+            r->buf = buf;
+            r->size = size;
+            r->start = 0;
+            r->end = tail;
+        }
+
+        /* one byte stays free for the '\0' of an unterminated last line */
+        ssize_t got = read(r->fd, r->buf + r->end, r->size - r->end - 1);
+
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (got <= 0) {
+            r->eof = 1;
+        } else {
+            r->end += got;
+        }
+    }
+}
+
+int load_ls_entries(const char *path, ls_table *t) {
+
+#if USE_NATIVE_LISTING
+    return load_ls_entries_native(path, t);
+#else
+    return load_ls_entries_popen(path, t);
+#endif
+}
+
+int load_ls_entries_popen(const char *path, ls_table *t) {
+
+    table_init(t, 0);
+
+    char command[256];
+
+    int ret = snprintf(command, sizeof(command), LS_COMMAND " %s", path);
+
+    if (ret < 0 || (size_t)ret >= sizeof(command)) {
+
+        fprintf(stderr, "Command buffer too small.\n");
+        return -1;
+    }
+
+    FILE *fp = popen(command, "r");
+    if (!fp) {
+        return -1;
+    }
+
+    ls_reader reader;
+    ls_reader_init(&reader, fileno(fp));
+
+    char *line;
+    size_t len;
+
+    while ((line = ls_reader_line(&reader, &t->arena, &len)) != NULL) {
+
+        /* the "total" line and blank ones don't parse */
+        parse_ls_line(line, len, t);
+    }
+
+    pclose(fp);
+    return t->count;
+}
+
+typedef struct prefix_slot {
+    unsigned generation; /* 0 for an empty slot */
+    int row;
+    char text[PREFIX_CACHE_LEN];
+} prefix_slot;
+
+static prefix_slot prefix_cache[PREFIX_CACHE_ROWS];
+
+/* every listing state gets its own generation, so the cache never has to be cleared */
+static unsigned last_generation;
+
+static void listing_changed(ls_listing *listing) {
+
+    if (++last_generation == 0) {
+        last_generation = 1;
+    }
+
+    listing->generation = last_generation;
+}
+
+const char *listing_prefix(const ls_listing *listing, int row, char *buf, size_t size) {
+
+    const ls_table *t = &listing->table;
+
+    if (!t->native) {
+
+        /* ls's own text, it runs right up to the name */
+        size_t len = t->fname[row] - t->prefix[row];
+        len = len < size ? len : size - 1;
+
+        memcpy(buf, t->prefix[row], len);
+        buf[len] = '\0';
+        return buf;
+    }
+
+    prefix_slot *slot = &prefix_cache[row % PREFIX_CACHE_ROWS];
+
+    if (slot->generation == listing->generation && slot->row == row) {
+        return slot->text;
+    }
+
+    int len = format_native_prefix(t, row, buf, size);
+
+    if (len >= 0 && len < PREFIX_CACHE_LEN) {
+
+        memcpy(slot->text, buf, len + 1);
+        slot->generation = listing->generation;
+        slot->row = row;
+    }
+
+    return buf;
+}
+
+const char *file_type_str(int type) {
+
+    switch (type) {
+
+    case file_dir:
+        return "DIRECTORY";
+        break;
+
+    case file_exec:
+        return "EXECUTABLE";
+        break;
+
+    case file_link:
+        return "SYMLINK";
+        break;
+
+    default:
+        return "REGULAR";
+    }
+}
+
+static int same_key(const listing_key *a, const listing_key *b) {
+
+    return a->dev == b->dev && a->ino == b->ino &&
+           a->mtime_sec == b->mtime_sec && a->mtime_nsec == b->mtime_nsec &&
+           a->ctime_sec == b->ctime_sec && a->ctime_nsec == b->ctime_nsec;
+}
+
+static void key_from_stat(const struct stat *st, listing_key *key) {
+
+    key->dev = st->st_dev;
+    key->ino = st->st_ino;
+    key->mtime_sec = st->st_mtim.tv_sec;
+    key->mtime_nsec = st->st_mtim.tv_nsec;
+    key->ctime_sec = st->st_ctim.tv_sec;
+    key->ctime_nsec = st->st_ctim.tv_nsec;
+}
+
+/* mtime only moves in filesystem timestamp ticks, a directory changed within the same tick as it
+ * was listed would still match. Like git's racy-clean check, don't trust anything that recent. */
+static int key_is_racy(const listing_key *key) {
+
+    time_t now = time(NULL);
+    return now - key->mtime_sec < 2 || now - key->ctime_sec < 2;
+}
+
+static long elapsed_ms(const struct timespec *since) {
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - since->tv_sec) * 1000 + (now.tv_nsec - since->tv_nsec) / 1000000;
+}
+
+/* hands rows over to the main thread, listing_poll() appends them to the listing. returns -1 if
+ * memory runs out */
+static int loader_publish(struct ls_loader *ld, const ls_table *chunk) {
+
+    pthread_mutex_lock(&ld->lock);
+    int ret = table_append(&ld->pending, chunk);
+    memcpy(ld->pending.widths, chunk->widths, sizeof(ld->pending.widths));
+    pthread_mutex_unlock(&ld->lock);
+
+    return ret;
+}
+
+/* error is the errno that cut the listing short, 0 if it is complete */
+static void loader_finish(struct ls_loader *ld, const ls_table *final, int *final_map, int error) {
+
+    pthread_mutex_lock(&ld->lock);
+    if (final) {
+        ld->final = *final;
+        ld->has_final = 1;
+    }
+    ld->final_map = final_map;
+    ld->error = error;
+    ld->done = 1;
+    pthread_cond_signal(&ld->finished);
+    pthread_mutex_unlock(&ld->lock);
+}
+
+/* rows for raw[from, to) in the order of `entries` (raw itself when NULL), -1 if memory runs out */
+static int store_native_rows(ls_table *t, native_entry **entries, native_entry *raw, int from, int to, arena *a) {
+
+    if (table_insert_rows(t, 0, to - from) != 0) {
+        return -1;
+    }
+
+    for (int i = from; i < to; i++) {
+
+        if (store_native_entry(t, i - from, entries ? entries[i] : &raw[i], a) != 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static void *native_loader_thread(void *arg) {
+
+    struct ls_loader *ld = arg;
+
+    char *buf = malloc(GETDENTS_BUF_SIZE);
+    int capacity = 64, count = 0, published = 0, error = 0;
+    native_entry *raw = malloc(capacity * sizeof(native_entry));
+    int widths[6] = {1, 1, 1, 1, 1, 1};
+
+    if (!buf || !raw) {
+        error = ENOMEM;
+    }
+
+    pid_t tid = syscall(SYS_gettid);
+    int base_nice = getpriority(PRIO_PROCESS, tid), niced = 0;
+
+    if (__atomic_load_n(&ld->background, __ATOMIC_ACQUIRE)) {
+        niced = setpriority(PRIO_PROCESS, tid, PREFETCH_NICE) == 0;
+    }
+
+    while (!error && !__atomic_load_n(&ld->cancel, __ATOMIC_RELAXED)) {
+
+        int before = count;
+        int read = read_native_chunk(ld->dfd, buf, &raw, &count, &capacity);
+
+        if (read <= 0) {
+
+            /* EIO, or ENOENT once the directory was removed under us */
+            error = read < 0 ? errno : 0;
+            break;
+        }
+
+        measure_widths(raw + before, count - before, widths);
+
+        int background = __atomic_load_n(&ld->background, __ATOMIC_ACQUIRE);
+
+        /* adopted as the foreground load, the user is waiting for it now */
+        if (niced && !background) {
+            setpriority(PRIO_PROCESS, tid, base_nice);
+            niced = 0;
+        }
+
+        int expected = 1;
+        if (background && count > PREFETCH_MAX_ENTRIES &&
+            __atomic_compare_exchange_n(&ld->background, &expected, 0, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+
+            __atomic_store_n(&ld->cancel, 1, __ATOMIC_RELAXED);
+            break;
+        }
+
+        /* directories that load faster than this show up in one piece, already sorted */
+        if (background || elapsed_ms(&ld->started) < LISTING_FIRST_PAINT_MS) {
+            continue;
+        }
+
+        /* arrival order with the widths seen so far, the final pass sorts and re-aligns */
+        ls_table chunk;
+        table_init(&chunk, 1);
+        memcpy(chunk.widths, widths, sizeof(chunk.widths));
+
+        if (store_native_rows(&chunk, NULL, raw, published, count, &ld->arena) != 0 || loader_publish(ld, &chunk) != 0) {
+            error = ENOMEM;
+        }
+
+        published = count;
+        table_free(&chunk);
+    }
+
+    free(buf);
+
+    if (niced && !__atomic_load_n(&ld->background, __ATOMIC_ACQUIRE)) {
+        setpriority(PRIO_PROCESS, tid, base_nice);
+    }
+
+    /* the rows published so far stay listed, the error says there should be more */
+    if (error || __atomic_load_n(&ld->cancel, __ATOMIC_RELAXED)) {
+
+        free_native_entries(raw, count);
+        loader_finish(ld, NULL, NULL, error);
+        return NULL;
+    }
+
+    native_entry **sorted = malloc((count > 0 ? count : 1) * sizeof(native_entry *));
+    const char **names = malloc((count > 0 ? count : 1) * sizeof(char *));
+    int *order = malloc((count > 0 ? count : 1) * sizeof(int));
+    int *map = published > 0 ? malloc(published * sizeof(int)) : NULL;
+
+    ls_table final;
+    table_init(&final, 1);
+
+    if (!sorted || !names || !order || (published > 0 && !map)) {
+
+        free(sorted);
+        free(names);
+        free(order);
+        free(map);
+        free_native_entries(raw, count);
+        loader_finish(ld, NULL, NULL, ENOMEM);
+        return NULL;
+    }
+
+    for (int i = 0; i < count; i++) {
+        names[i] = raw[i].name;
+    }
+
+    /* collation keys are built once per name, strcoll() in qsort() redoes that work on every comparison */
+    if (sort_collated(names, count, order) == 0) {
+
+        for (int i = 0; i < count; i++) {
+            sorted[i] = &raw[order[i]];
+        }
+
+    } else {
+
+        for (int i = 0; i < count; i++) {
+            sorted[i] = &raw[i];
+        }
+
+        qsort(sorted, count, sizeof(native_entry *), compare_native_entry_ptrs);
+    }
+
+    free(names);
+    free(order);
+
+    measure_widths(raw, count, final.widths);
+
+    if (store_native_rows(&final, sorted, raw, 0, count, &final.arena) != 0) {
+
+        /* a half filled table and map are no use, the streamed rows stay */
+        free(sorted);
+        free(map);
+        free_native_entries(raw, count);
+        table_free(&final);
+        loader_finish(ld, NULL, NULL, ENOMEM);
+        return NULL;
+    }
+
+    for (int i = 0; i < count; i++) {
+
+        int arrival = sorted[i] - raw;
+        if (arrival < published) {
+            map[arrival] = i;
+        }
+    }
+
+    free(sorted);
+    free_native_entries(raw, count);
+
+    /* written from here so the main thread never waits for it, the key was taken before reading */
+    if (USE_INDEX && count >= INDEX_MIN_ENTRIES && !key_is_racy(&ld->key)) {
+        index_store(&ld->key, &final);
+    }
+
+    loader_finish(ld, &final, map, 0);
+    return NULL;
+}
+
+static void *popen_loader_thread(void *arg) {
+
+    struct ls_loader *ld = arg;
+
+    ls_reader reader;
+    ls_reader_init(&reader, fileno(ld->fp));
+
+    ls_table chunk;
+    table_init(&chunk, 0);
+
+    char *line;
+    size_t len;
+    int error = 0;
+
+    while (!error && !__atomic_load_n(&ld->cancel, __ATOMIC_RELAXED) &&
+           (line = ls_reader_line(&reader, &ld->arena, &len)) != NULL) {
+
+        /* the "total" line and blank ones don't parse */
+        if (parse_ls_line(line, len, &chunk) != 0) {
+            continue;
+        }
+
+        if (chunk.count == LISTING_CHUNK) {
+
+            error = loader_publish(ld, &chunk) != 0 ? ENOMEM : 0;
+            chunk.count = 0;
+        }
+    }
+
+    if (!error && loader_publish(ld, &chunk) != 0) {
+        error = ENOMEM;
+    }
+
+    table_free(&chunk);
+
+    /* ls already sorted and aligned everything, nothing to replace */
+    loader_finish(ld, NULL, NULL, error);
+    return NULL;
+}
+
+typedef struct cache_node {
+    listing_key key;
+    ls_table table;
+    size_t garbage;
+    int prefetched; /* counts as a prefetch hit when taken */
+    size_t bytes;
+    struct cache_node *prev, *next;
+} cache_node;
+
+/* most recently used first */
+static cache_node *cache_head, *cache_tail;
+static size_t cache_bytes;
+
+static size_t listing_bytes(const ls_listing *listing) {
+
+    return sizeof(cache_node) + table_bytes(&listing->table);
+}
+
+static void cache_unlink(cache_node *node) {
+
+    if (node->prev) {
+        node->prev->next = node->next;
+    } else {
+        cache_head = node->next;
+    }
+
+    if (node->next) {
+        node->next->prev = node->prev;
+    } else {
+        cache_tail = node->prev;
+    }
+
+    node->prev = node->next = NULL;
+    cache_bytes -= node->bytes;
+}
+
+static void cache_drop(cache_node *node) {
+
+    cache_unlink(node);
+    table_free(&node->table);
+    free(node);
+}
+
+/* any cached listing of the same directory is stale once a newer one exists */
+static void cache_forget(const listing_key *key) {
+
+    for (cache_node *node = cache_head; node; node = node->next) {
+
+        if (node->key.dev == key->dev && node->key.ino == key->ino) {
+
+            cache_drop(node);
+            return;
+        }
+    }
+}
+
+/* takes ownership of the listing's table, frees it right away if it does not fit */
+static void cache_store(ls_listing *listing, int prefetched) {
+
+    cache_forget(&listing->key);
+
+    size_t bytes = listing_bytes(listing);
+
+    if (bytes > LISTING_CACHE_BYTES) {
+
+        table_free(&listing->table);
+        return;
+    }
+
+    while (cache_tail && cache_bytes + bytes > LISTING_CACHE_BYTES) {
+        cache_drop(cache_tail);
+    }
+
+    cache_node *node = calloc(1, sizeof(cache_node));
+    if (!node) {
+
+        table_free(&listing->table);
+        return;
+    }
+
+    node->key = listing->key;
+    node->table = listing->table;
+    node->garbage = listing->garbage;
+    node->prefetched = prefetched;
+    node->bytes = bytes;
+
+    node->next = cache_head;
+    if (cache_head) {
+        cache_head->prev = node;
+    } else {
+        cache_tail = node;
+    }
+    cache_head = node;
+    cache_bytes += bytes;
+}
+
+/* hands the cached listing over to the caller, or returns NULL when there is no fresh one */
+static cache_node *cache_take(const listing_key *key) {
+
+    for (cache_node *node = cache_head; node; node = node->next) {
+
+        if (node->key.dev != key->dev || node->key.ino != key->ino) {
+            continue;
+        }
+
+        if (!same_key(&node->key, key)) {
+
+            cache_drop(node);
+            return NULL;
+        }
+
+        cache_unlink(node);
+        return node;
+    }
+
+    return NULL;
+}
+
+static int cache_has(const listing_key *key) {
+
+    for (cache_node *node = cache_head; node; node = node->next) {
+
+        if (same_key(&node->key, key)) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static void loader_free(struct ls_loader *ld) {
+
+    __atomic_store_n(&ld->cancel, 1, __ATOMIC_RELAXED);
+    pthread_join(ld->thread, NULL);
+
+    if (ld->dfd >= 0) {
+        close(ld->dfd);
+    }
+
+    if (ld->fp) {
+        pclose(ld->fp);
+    }
+
+    table_free(&ld->pending);
+    table_free(&ld->final);
+    arena_free(&ld->arena);
+    free(ld->final_map);
+    pthread_mutex_destroy(&ld->lock);
+    pthread_cond_destroy(&ld->finished);
+    free(ld->path);
+    free(ld);
+}
+
+void listing_rekey(ls_listing *listing, const struct stat *st) {
+
+    key_from_stat(st, &listing->key);
+    listing->cacheable = LISTING_CACHE_BYTES > 0 && !key_is_racy(&listing->key);
+}
+
+/* gives small directories the chance to finish so they never flash a partial listing */
+static void loader_wait(struct ls_loader *ld, long ms) {
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += ms * 1000000;
+    deadline.tv_sec += deadline.tv_nsec / 1000000000;
+    deadline.tv_nsec %= 1000000000;
+
+    pthread_mutex_lock(&ld->lock);
+    while (!ld->done) {
+
+        if (pthread_cond_timedwait(&ld->finished, &ld->lock, &deadline) != 0) {
+            break;
+        }
+    }
+    pthread_mutex_unlock(&ld->lock);
+}
+
+static int loader_done(struct ls_loader *ld) {
+
+    pthread_mutex_lock(&ld->lock);
+    int done = ld->done;
+    pthread_mutex_unlock(&ld->lock);
+    return done;
+}
+
+static struct ls_loader *loader_start(const char *path, const listing_key *key, int background) {
+
+    struct ls_loader *ld = calloc(1, sizeof(struct ls_loader));
+    if (!ld) {
+        return NULL;
+    }
+
+    ld->dfd = -1;
+    ld->path = strdup(path);
+
+    if (!ld->path) {
+
+        free(ld);
+        return NULL;
+    }
+
+    ld->key = *key;
+    ld->background = background;
+    clock_gettime(CLOCK_MONOTONIC, &ld->started);
+
+#if USE_NATIVE_LISTING
+    ld->dfd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+    if (ld->dfd < 0) {
+
+        free(ld->path);
+        free(ld);
+        return NULL;
+    }
+#else
+    char command[256];
+
+    int ret = snprintf(command, sizeof(command), LS_COMMAND " %s", path);
+
+    if (ret < 0 || (size_t)ret >= sizeof(command) || (ld->fp = popen(command, "r")) == NULL) {
+
+        free(ld->path);
+        free(ld);
+        return NULL;
+    }
+#endif
+
+    table_init(&ld->pending, ld->fp == NULL);
+    table_init(&ld->final, 1);
+    pthread_mutex_init(&ld->lock, NULL);
+    pthread_cond_init(&ld->finished, NULL);
+
+    if (pthread_create(&ld->thread, NULL, ld->fp ? popen_loader_thread : native_loader_thread, ld) != 0) {
+
+        if (ld->dfd >= 0) {
+            close(ld->dfd);
+        }
+        if (ld->fp) {
+            pclose(ld->fp);
+        }
+        pthread_mutex_destroy(&ld->lock);
+        pthread_cond_destroy(&ld->finished);
+        free(ld->path);
+        free(ld);
+        return NULL;
+    }
+
+    return ld;
+}
+
+#define MAX_PREFETCH_ZOMBIES 8
+
+/* the one directory being listed ahead of time, and the one the cursor asked for next */
+static struct ls_loader *prefetch_loader;
+static char *prefetch_wanted;
+static struct timespec prefetch_requested;
+
+/* cancelled prefetches still finishing their current chunk, joined once they are done */
+static struct ls_loader *prefetch_zombies[MAX_PREFETCH_ZOMBIES];
+static int prefetch_zombie_count;
+
+static int prefetch_started, prefetch_hits;
+
+/* an adopted prefetch takes back its nice value, unprivileged threads may only lower it as far as RLIMIT_NICE allows */
+static int prefetch_can_renice(void) {
+
+    static int known = -1;
+
+    if (known < 0) {
+
+        struct rlimit rl;
+        int base = getpriority(PRIO_PROCESS, 0);
+
+        known = geteuid() == 0 ||
+                (getrlimit(RLIMIT_NICE, &rl) == 0 && (rl.rlim_cur == RLIM_INFINITY || 20 - (long)rl.rlim_cur <= base));
+    }
+
+    return known;
+}
+
+static void prefetch_cancel(void) {
+
+    if (!prefetch_loader) {
+        return;
+    }
+
+    __atomic_store_n(&prefetch_loader->cancel, 1, __ATOMIC_RELAXED);
+
+    if (prefetch_zombie_count < MAX_PREFETCH_ZOMBIES) {
+        prefetch_zombies[prefetch_zombie_count++] = prefetch_loader;
+    } else {
+        loader_free(prefetch_loader);
+    }
+
+    prefetch_loader = NULL;
+}
+
+/* joins finished zombies and moves a finished prefetch into the listing cache */
+static void prefetch_reap(void) {
+
+    for (int i = 0; i < prefetch_zombie_count;) {
+
+        if (loader_done(prefetch_zombies[i])) {
+
+            loader_free(prefetch_zombies[i]);
+            prefetch_zombies[i] = prefetch_zombies[--prefetch_zombie_count];
+
+        } else {
+
+            i++;
+        }
+    }
+
+    struct ls_loader *ld = prefetch_loader;
+    if (!ld || !loader_done(ld)) {
+        return;
+    }
+
+    if (ld->has_final && !key_is_racy(&ld->key)) {
+
+        ls_listing done = {0};
+        done.table = ld->final;
+        done.key = ld->key;
+
+        cache_store(&done, 1);
+        table_init(&ld->final, 1);
+        ld->has_final = 0;
+    }
+
+    loader_free(ld);
+    prefetch_loader = NULL;
+}
+
+void listing_prefetch(const char *path) {
+
+    if (!USE_PREFETCH || !USE_NATIVE_LISTING) {
+        return;
+    }
+
+    if (path && ((prefetch_wanted && strcmp(prefetch_wanted, path) == 0) ||
+                 (prefetch_loader && strcmp(prefetch_loader->path, path) == 0))) {
+        return;
+    }
+
+    prefetch_cancel();
+    free(prefetch_wanted);
+    prefetch_wanted = path ? strdup(path) : NULL;
+    clock_gettime(CLOCK_MONOTONIC, &prefetch_requested);
+}
+
+/* starts the wanted prefetch once the cursor rested on it long enough and nothing is loading */
+static void prefetch_poll(const ls_listing *listing) {
+
+    prefetch_reap();
+
+    if (!prefetch_wanted || listing->loading || elapsed_ms(&prefetch_requested) < PREFETCH_DELAY_MS) {
+        return;
+    }
+
+    struct stat st;
+    listing_key key;
+
+    if (stat(prefetch_wanted, &st) == 0) {
+
+        key_from_stat(&st, &key);
+
+        /* already cached and still fresh, nothing to do */
+        if (!cache_has(&key) && !key_is_racy(&key)) {
+
+            prefetch_loader = loader_start(prefetch_wanted, &key, 1);
+            prefetch_started += prefetch_loader != NULL;
+        }
+    }
+
+    free(prefetch_wanted);
+    prefetch_wanted = NULL;
+}
+
+int listing_prefetch_pending(const char *path) {
+
+    return (prefetch_wanted && strcmp(prefetch_wanted, path) == 0) ||
+           (prefetch_loader && strcmp(prefetch_loader->path, path) == 0);
+}
+
+int listing_peek(const char *path, char *buf, size_t size, size_t *len) {
+
+    struct stat st;
+    listing_key key;
+
+    *len = 0;
+
+    if (stat(path, &st) != 0) {
+        return -1;
+    }
+
+    key_from_stat(&st, &key);
+
+    for (cache_node *node = cache_head; node; node = node->next) {
+
+        if (!same_key(&node->key, &key)) {
+            continue;
+        }
+
+        const ls_table *t = &node->table;
+        int entries = 0;
+
+        for (int row = 0; row < t->count; row++) {
+
+            const char *name = t->fname[row];
+
+            if (strcmp(name, "./") == 0 || strcmp(name, "../") == 0) {
+                continue;
+            }
+
+            entries++;
+            size_t n = strlen(name);
+
+            if (*len + n + 1 <= size) {
+
+                memcpy(buf + *len, name, n);
+                *len += n;
+                buf[(*len)++] = '\n';
+            }
+        }
+
+        return entries;
+    }
+
+    return -1;
+}
+
+void listing_prefetch_stats(int *started, int *hits) {
+
+    *started = prefetch_started;
+    *hits = prefetch_hits;
+}
+
+int listing_find(const ls_table *t, const char *name, int *insert_at) {
+
+    int lo = 0, hi = t->count - 1;
+    char bare[NAME_MAX + 1];
+
+    while (lo <= hi) {
+
+        int mid = lo + (hi - lo) / 2;
+        int len = t->name_len[mid] < NAME_MAX ? t->name_len[mid] : NAME_MAX;
+
+        memcpy(bare, t->fname[mid], len);
+        bare[len] = '\0';
+
+        int cmp = strcoll(name, bare);
+
+        if (cmp == 0) {
+            return mid;
+        } else if (cmp < 0) {
+            hi = mid - 1;
+        } else {
+            lo = mid + 1;
+        }
+    }
+
+    *insert_at = lo;
+    return -1;
+}
+
+int listing_row(const ls_listing *listing, int index) {
+
+    if (listing->order && index >= 0 && index < listing->table.count) {
+        return listing->order[index];
+    }
+
+    return index;
+}
+
+int listing_index(const ls_listing *listing, int row) {
+
+    if (listing->position && row >= 0 && row < listing->table.count) {
+        return listing->position[row];
+    }
+
+    return row;
+}
+
+static void listing_unsort(ls_listing *listing) {
+
+    free(listing->order);
+    free(listing->position);
+    listing->order = NULL;
+    listing->position = NULL;
+}
+
+/* rebuilds the view after the rows changed. a listing that is still streaming in stays in arrival
+ * order, sorting every chunk would cost more than the loading itself */
+static void listing_sort(ls_listing *listing) {
+
+    int count = listing->table.count;
+
+    listing_unsort(listing);
+
+    if (listing->sort == sort_name || (listing->loading && !listing->stale) || count == 0) {
+        return;
+    }
+
+    listing->order = malloc(count * sizeof(int));
+    listing->position = malloc(count * sizeof(int));
+
+    /* out of memory only costs the sort order */
+    if (!listing->order || !listing->position || table_sort(&listing->table, listing->sort, listing->order) != 0) {
+
+        listing_unsort(listing);
+        return;
+    }
+
+    for (int i = 0; i < count; i++) {
+        listing->position[listing->order[i]] = i;
+    }
+}
+
+void listing_set_sort(ls_listing *listing, sort_key key, int *selected) {
+
+    int row = listing_row(listing, *selected);
+
+    listing->sort = key;
+    listing_sort(listing);
+    *selected = listing_index(listing, row);
+}
+
+/* shows the listing stored in the index straight away. if the directory changed since it was
+ * stored it is listed again in the background, and the new rows replace the stored ones */
+static int listing_open_indexed(ls_listing *listing, const char *path, const struct stat *st, int selected) {
+
+    ls_table table;
+    listing_key stored;
+
+    table_init(&table, 1);
+
+    if (index_load(st->st_dev, st->st_ino, &table, &stored) != 0) {
+        return -1;
+    }
+
+    listing_close(listing);
+    listing->table = table;
+    listing_rekey(listing, st);
+
+    if (!same_key(&stored, &listing->key) || key_is_racy(&listing->key)) {
+
+        prefetch_cancel();
+        free(prefetch_wanted);
+        prefetch_wanted = NULL;
+
+        struct ls_loader *ld = loader_start(path, &listing->key, 0);
+
+        /* stored rows are still better than none, but they don't go into the cache */
+        if (ld) {
+
+            listing->loader = ld;
+            listing->loading = 1;
+            listing->stale = 1;
+            listing->open_selected = selected;
+
+        } else {
+
+            listing->cacheable = 0;
+        }
+    }
+
+    listing_sort(listing);
+    listing_watch(listing, path);
+    return 0;
+}
+
+int listing_open_cached(ls_listing *listing, const char *path, int selected) {
+
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        return -1;
+    }
+
+    listing_key key;
+    key_from_stat(&st, &key);
+
+    prefetch_reap();
+
+    /* one that gave up past PREFETCH_MAX_ENTRIES is only finishing its chunk, it would end with no listing */
+    if (prefetch_loader && __atomic_load_n(&prefetch_loader->cancel, __ATOMIC_RELAXED)) {
+        prefetch_cancel();
+    }
+
+    /* a prefetch of this directory that is still running becomes the foreground load. The thread may give
+       up between the check above and here, the swap decides, and one that would stay niced is dropped too */
+    int expected = 1;
+    if (prefetch_loader && same_key(&prefetch_loader->key, &key) &&
+        (!prefetch_can_renice() ||
+         !__atomic_compare_exchange_n(&prefetch_loader->background, &expected, 0, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))) {
+        prefetch_cancel();
+    }
+
+    if (prefetch_loader && same_key(&prefetch_loader->key, &key)) {
+
+        struct ls_loader *ld = prefetch_loader;
+        prefetch_loader = NULL;
+        prefetch_hits++;
+
+        listing_close(listing);
+        listing->key = key;
+        listing->cacheable = !key_is_racy(&key);
+        listing->loader = ld;
+        listing->loading = 1;
+        listing->open_selected = selected;
+
+        listing_watch(listing, path);
+        loader_wait(ld, LISTING_FIRST_PAINT_MS);
+        return 0;
+    }
+
+    cache_node *node = cache_take(&key);
+    if (!node) {
+
+        if (USE_INDEX && USE_NATIVE_LISTING && listing_open_indexed(listing, path, &st, selected) == 0) {
+            return 0;
+        }
+
+        return listing_open(listing, path, selected);
+    }
+
+    prefetch_hits += node->prefetched;
+    listing_close(listing);
+
+    listing->table = node->table;
+    listing->garbage = node->garbage;
+    listing->key = key;
+    listing->cacheable = 1;
+    free(node);
+    listing_sort(listing);
+    listing_watch(listing, path);
+    return 0;
+}
+
+int listing_open(ls_listing *listing, const char *path, int selected) {
+
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        return -1;
+    }
+
+    listing_close(listing);
+
+    /* the foreground load gets the disk to itself */
+    prefetch_cancel();
+    free(prefetch_wanted);
+    prefetch_wanted = NULL;
+
+    /* keyed before reading, a change during the load moves mtime and invalidates it */
+    listing_rekey(listing, &st);
+
+    struct ls_loader *ld = loader_start(path, &listing->key, 0);
+
+    /* no thread to be had, read it the way everything was listed before streaming */
+    if (!ld) {
+
+        if (load_ls_entries(path, &listing->table) < 0) {
+
+            table_free(&listing->table);
+            table_init(&listing->table, USE_NATIVE_LISTING);
+            return -1;
+        }
+
+        listing_sort(listing);
+        listing_watch(listing, path);
+        return 0;
+    }
+
+    listing->loader = ld;
+    listing->loading = 1;
+    listing->open_selected = selected;
+
+    /* watch from the start, whatever changes during the load is replayed once it is done */
+    listing_watch(listing, path);
+
+    loader_wait(ld, LISTING_FIRST_PAINT_MS);
+    return 0;
+}
+
+int listing_open_find(ls_listing *listing, const char *path, const char *pattern, find_mode mode, int selected) {
+
+    listing_close(listing);
+
+    prefetch_cancel();
+    free(prefetch_wanted);
+    prefetch_wanted = NULL;
+
+    ls_find *f = find_start(path, pattern, mode);
+    if (!f) {
+        return -1;
+    }
+
+    /* names are native rows whatever USE_NATIVE_LISTING says, lines are text. neither is cached or watched */
+    table_free(&listing->table);
+    table_init(&listing->table, mode == find_names);
+    listing->finder = f;
+    listing->loading = 1;
+    listing->open_selected = selected;
+    find_progress(f, &listing->found);
+    return 0;
+}
+
+void listing_stop(ls_listing *listing) {
+
+    if (listing->finder) {
+        find_cancel(listing->finder);
+    }
+}
+
+int listing_refresh(ls_listing *listing, const char *path, int selected) {
+
+    if (listing->watch) {
+        return 0;
+    }
+
+    return listing_open(listing, path, selected);
+}
+
+int listing_poll_timeout(const ls_listing *listing) {
+
+    if (listing->loading) {
+        return LISTING_POLL_MS;
+    }
+
+    int timeout = listing_watch_timeout(listing);
+
+    if (prefetch_wanted) {
+
+        long wait = PREFETCH_DELAY_MS - elapsed_ms(&prefetch_requested);
+        wait = wait > 0 ? wait : 1;
+
+        if (timeout < 0 || wait < timeout) {
+            timeout = wait;
+        }
+    }
+
+    return timeout;
+}
+
+static int listing_poll_loader(ls_listing *listing, int *selected) {
+
+    struct ls_loader *ld = listing->loader;
+    if (!ld) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&ld->lock);
+
+    ls_table pending = ld->pending;
+    int done = ld->done;
+
+    table_init(&ld->pending, pending.native);
+
+    pthread_mutex_unlock(&ld->lock);
+
+    /* stale rows stay on screen until the new listing is complete */
+    if (pending.count > 0 && !listing->stale) {
+
+        table_append(&listing->table, &pending);
+        memcpy(listing->table.widths, pending.widths, sizeof(listing->table.widths));
+    }
+
+    table_free(&pending);
+
+    if (!done) {
+        return pending.count > 0 && !listing->stale;
+    }
+
+    /* the native loader streams in arrival order and then replaces everything with the sorted listing */
+    if (ld->has_final) {
+
+        /* a cursor on stored rows is found again by name. one the user moved while loading follows
+         * its entry, otherwise the index is kept */
+        char name[NAME_MAX + 1] = "";
+
+        if (listing->stale && *selected >= 0 && *selected < listing->table.count) {
+
+            int len = listing->table.name_len[*selected] < NAME_MAX ? listing->table.name_len[*selected] : NAME_MAX;
+            memcpy(name, listing->table.fname[*selected], len);
+            name[len] = '\0';
+
+        } else if (ld->final_map && *selected != listing->open_selected &&
+                   *selected >= 0 && *selected < listing->table.count) {
+
+            *selected = ld->final_map[*selected];
+        }
+
+        /* the streamed names go away with the loader's arena */
+        table_free(&listing->table);
+        listing->table = ld->final;
+        table_init(&ld->final, 1);
+        ld->has_final = 0;
+
+        /* the cursor stays on its entry, or the one that took its place */
+        if (name[0]) {
+
+            int insert_at;
+            int row = listing_find(&listing->table, name, &insert_at);
+            *selected = row >= 0 ? row : insert_at;
+        }
+
+    } else {
+
+        /* the rows were published as they were parsed, the listing takes their arena over. it may
+         * already hold names of its own, the stored rows of a stale listing among them */
+        arena_merge(&listing->table.arena, &ld->arena);
+    }
+
+    /* what was read stays listed, but is not cached as if it were the whole directory */
+    if (ld->error) {
+
+        listing->error = ld->error;
+        listing->cacheable = 0;
+    }
+
+    loader_free(ld);
+    listing->loader = NULL;
+    listing->loading = 0;
+    listing->stale = 0;
+    return 1;
+}
+
+/* puts the rows of a finished search in name order, the cursor stays on its entry */
+static void listing_order_found(ls_listing *listing, int *selected) {
+
+    ls_table *t = &listing->table;
+    int count = t->count;
+    int *order = malloc((count > 0 ? count : 1) * sizeof(int));
+    char **names = malloc((count > 0 ? count : 1) * sizeof(char *));
+    arena bare = {0};
+    int ok = order && names;
+
+    /* paths without the -F mark, link target or matching line. the lines of one file keep their order */
+    for (int i = 0; ok && i < count; i++) {
+        ok = (names[i] = arena_strndup(&bare, t->fname[i], t->name_len[i])) != NULL;
+    }
+
+    if (ok && sort_collated((const char *const *)names, count, order) == 0 && table_permute(t, order) == 0) {
+
+        for (int i = 0; i < count; i++) {
+
+            if (order[i] == *selected) {
+
+                *selected = i;
+                break;
+            }
+        }
+    }
+
+    arena_free(&bare);
+    free(names);
+    free(order);
+}
+
+static int listing_poll_finder(ls_listing *listing, int *selected) {
+
+    ls_find *f = listing->finder;
+    if (!f) {
+        return 0;
+    }
+
+    ls_table chunk;
+    int done = find_take(f, &chunk);
+    int changed = chunk.count > 0;
+
+    if (changed) {
+
+        table_append(&listing->table, &chunk);
+        memcpy(listing->table.widths, chunk.widths, sizeof(listing->table.widths));
+    }
+
+    table_free(&chunk);
+    find_progress(f, &listing->found);
+
+    if (!done) {
+        return changed;
+    }
+
+    /* the rows point into the search's names, the listing keeps them */
+    find_free(f, &listing->table.arena);
+    listing->finder = NULL;
+    listing->loading = 0;
+    listing_order_found(listing, selected);
+    return 1;
+}
+
+int listing_poll(ls_listing *listing, int *selected) {
+
+    /* the loader and the watch track the cursor by row */
+    int row = listing_row(listing, *selected);
+
+    /* a cursor left where listing_open() put it stays at that index once the view is sorted */
+    int keep_index = listing->loading && !listing->stale && *selected == listing->open_selected;
+
+    int changed = listing_poll_loader(listing, &row);
+    changed = listing_poll_finder(listing, &row) || changed;
+    changed = listing_watch_poll(listing, &row) || changed;
+
+    if (changed) {
+
+        listing_sort(listing);
+        listing_changed(listing);
+    }
+
+    *selected = keep_index && !listing->loading ? row : listing_index(listing, row);
+
+    prefetch_poll(listing);
+    return changed;
+}
+
+void listing_close(ls_listing *listing) {
+
+    listing_unwatch(listing);
+
+    if (listing->finder) {
+
+        /* after the table, whose names it holds */
+        table_free(&listing->table);
+        find_free(listing->finder, NULL);
+        listing->finder = NULL;
+    }
+
+    if (listing->loader) {
+
+        loader_free(listing->loader);
+        listing->loader = NULL;
+
+    } else if (listing->cacheable && listing->table.count > 0) {
+
+        /* complete listings are kept around for the next visit */
+        cache_store(listing, 0);
+        table_init(&listing->table, USE_NATIVE_LISTING);
+    }
+
+    table_free(&listing->table);
+    table_init(&listing->table, USE_NATIVE_LISTING);
+    listing_unsort(listing);
+    listing_changed(listing);
+    listing->garbage = 0;
+    listing->loading = 0;
+    listing->stale = 0;
+    listing->cacheable = 0;
+    listing->error = 0;
+    memset(&listing->found, 0, sizeof(listing->found));
+}
@@ -0,0 +1,122 @@
+#ifndef LISTING_H
+#define LISTING_H
+
+#include "find.h"
+#include "sort.h"
+#include "table.h"
+#include <sys/stat.h>
+
+#define MAX_LINE 2048
+
+typedef enum {
+    file_reg,
+    file_dir,
+    file_exec,
+    file_link,
+} file_type;
+
+void trim_newline(char *s);
+void trim_executable_mark(char *s);
+
+/* appends one line of LS_COMMAND output to a text table. the row points into line, which must outlive it */
+int parse_ls_line(char *line, size_t len, ls_table *t);
+
+/* reads `path` into a fresh table and returns the number of entries, or -1 on failure.
+ * picks the native engine or LS_COMMAND depending on USE_NATIVE_LISTING in config.h */
+int load_ls_entries(const char *path, ls_table *t);
+int load_ls_entries_popen(const char *path, ls_table *t);
+int load_ls_entries_native(const char *path, ls_table *t);
+
+/* identifies one state of a directory, a cached listing is only reused while all of it matches */
+typedef struct listing_key {
+    unsigned long long dev, ino;
+    long long mtime_sec, mtime_nsec;
+    long long ctime_sec, ctime_nsec;
+} listing_key;
+
+/* a listing that is filled in the background, see listing_open() */
+typedef struct ls_listing {
+    ls_table table;
+    int loading; /* 1 while the loader thread is still publishing entries */
+    int open_selected;
+    struct ls_loader *loader;
+    listing_key key;
+    int cacheable; /* goes into the listing cache when closed */
+    struct ls_watch *watch;
+    size_t garbage; /* arena bytes of names the watch replaced or removed */
+    unsigned generation; /* changes whenever the rows do, formatted rows of another generation are stale */
+    int stale; /* rows came from the index and are shown while the loader lists the directory again */
+    int error; /* errno of a failed read or of running out of memory, the rows are what came before it */
+    sort_key sort; /* kept across directories */
+    int *order;    /* display index -> row, NULL while shown in name order */
+    int *position; /* row -> display index */
+    struct ls_find *finder; /* the search filling the listing, see listing_open_find() */
+    find_stats found;       /* of the search the rows came from, all zero for a directory */
+} ls_listing;
+
+/* drops the current listing and starts loading `path` on a background thread. waits up to
+ * LISTING_FIRST_PAINT_MS for it to finish, bigger directories keep streaming in through listing_poll().
+ * selected is the cursor the caller intends to keep, returns -1 if the directory can't be opened. */
+int listing_open(ls_listing *listing, const char *path, int selected);
+
+/* same as listing_open() but reuses a cached listing of `path` when the directory did not change
+ * since it was listed. closed listings are cached up to LISTING_CACHE_BYTES. */
+int listing_open_cached(ls_listing *listing, const char *path, int selected);
+
+/* replaces the listing with what a search below `path` finds, see find.h. the rows stream in through
+ * listing_poll() like a big directory and are put in path order once the search is over. returns -1
+ * if the search can't start */
+int listing_open_find(ls_listing *listing, const char *path, const char *pattern, find_mode mode, int selected);
+
+/* stops a running search, what it found so far stays listed */
+void listing_stop(ls_listing *listing);
+
+/* appends whatever the loader published since the last call. once loading is over the listing is
+ * replaced by its sorted version and *selected is moved along. returns 1 if anything changed. */
+int listing_poll(ls_listing *listing, int *selected);
+
+/* milliseconds the caller may block before calling listing_poll() again, -1 for as long as it likes */
+int listing_poll_timeout(const ls_listing *listing);
+
+/* re-reads the directory after an operation, unless a watch already keeps it up to date */
+int listing_refresh(ls_listing *listing, const char *path, int selected);
+
+/* records the directory state the listing now matches, for the listing cache */
+void listing_rekey(ls_listing *listing, const struct stat *st);
+
+void listing_close(ls_listing *listing);
+
+/* lists `path` on a niced background thread once the cursor rested on it for PREFETCH_DELAY_MS,
+ * so a following listing_open_cached() finds it ready. NULL (or another path) cancels it. */
+void listing_prefetch(const char *path);
+void listing_prefetch_stats(int *started, int *hits);
+
+/* returns 1 while `path` waits for its prefetch or is being prefetched */
+int listing_prefetch_pending(const char *path);
+
+/* the names in a cached listing of `path`, one per line in buf and as many as fit in size bytes, as
+ * long as the directory did not change since it was listed. returns how many entries it has, -1 if
+ * there is no such listing. nothing is taken out of the cache */
+int listing_peek(const char *path, char *buf, size_t size, size_t *len);
+
+/* binary search over a table in name order by bare name. returns the row of name, or -1 with
+ * *insert_at set to where it would go */
+int listing_find(const ls_table *t, const char *name, int *insert_at);
+
+/* the table row shown at display index `index`. rows are always stored in name order, other sort
+ * keys only reorder the view and are applied once loading is over */
+int listing_row(const ls_listing *listing, int index);
+
+/* the display index row `row` is shown at, the inverse of listing_row() */
+int listing_index(const ls_listing *listing, int row);
+
+/* shows the listing in `key` order, *selected is moved so the same entry stays under the cursor */
+void listing_set_sort(ls_listing *listing, sort_key key, int *selected);
+
+/* the text in front of the name of row `row`: what ls printed, or the native columns formatted on demand.
+ * recently drawn rows come from a small cache, the result is valid until the next listing call */
+const char *listing_prefix(const ls_listing *listing, int row, char *buf, size_t size);
+
+const char *file_type_str(int type);
+
+#endif
@@ -10,14 +10,27 @@
     WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 */
 
+#include "ansi.h"
 #include "config.h"
+#include "du.h"
+#include "fuzzy.h"
+#include "hits.h"
+#include "listing.h"
+#include "native.h"
+#include "pager.h"
+#include "preview.h"
+#include "trigram.h"
+#include "view.h"
 #include <ctype.h>
+#include <errno.h>
 #include <fcntl.h>
+#include <locale.h>
 #include <ncurses.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
 
 #define key_ctrl(x) ((x) & 0x1f)
@@ -29,238 +42,601 @@
 #define MSG_WIN_HEIGHT 5
 #define MSG_WIN_WIDTH 60
 
-#define MAX_LINE 2048
 #define INFO_BAR_PADDING 20
-#define ENTRIES_PER_PAGE 20
-
-typedef enum {
-    file_reg,
-    file_dir,
-    file_exec,
-    file_link,
-} file_type;
-
-typedef struct ls_entry {
-    char *full_line;
-    char *prefix;
-    char *fname;
-    file_type type;
-} ls_entry;
-
-void trim_newline(char *s);
-void trim_executable_mark(char *s);
-int parse_ls_line(char *line, ls_entry *entry);
-int load_ls_entries(const char *path, ls_entry ***entries_out);
-void free_ls_entry(ls_entry *entry);
-void free_ls_entries(ls_entry **entries, int count);
-const char *file_type_str(int type);
+#define SEARCH_RESULTS 20
+
+/* how often the status line of the pager follows the indexing thread */
+#define PAGER_REFRESH_MS 200
+
 void show_help(void);
+int show_pager(const char *path);
 int confirm_box(const char *msg);
 int prompt_input(const char *prompt, char *buffer, int buf_size);
+int search_prompt(fuzzy *fz, const ls_listing *listing, ls_hits *hits);
 void show_message(const char *msg);
 void run_executable(char *file_path);
 void run_silent(char *file_path);
 
 static char last_action[LAST_ACTION_SIZE] = "";
 
-void trim_newline(char *s) {
-    char *p = strchr(s, '\n');
-    if (p) {
-        *p = '\0';
-    }
+/* what a line of the listing shows. a frame only draws the lines whose description changed since
+ * the last one, so moving the cursor rewrites two lines and the terminal gets only those */
+typedef struct screen_line {
+    int index; /* display index, -1 for an empty line */
+    int row;
+    unsigned generation;
+    int selected;
+    int hit;
+    unsigned searches; /* the query the hit marks are of */
+    int du;            /* du_lookup() of a directory, -1 for anything else */
+    long long du_bytes;
+} screen_line;
+
+/* field by field, struct assignment does not carry the padding over so memcmp() could see a difference */
+static int equal_line(const screen_line *a, const screen_line *b) {
+
+    return a->index == b->index && a->row == b->row && a->generation == b->generation && a->selected == b->selected &&
+           a->hit == b->hit && a->searches == b->searches && a->du == b->du && a->du_bytes == b->du_bytes;
 }
 
-void trim_executable_mark(char *s) {
-    char *p = strchr(s, '*');
-    if (p) {
-        *p = '\0';
-    }
+static screen_line *screen_lines;
+static char screen_action[LAST_ACTION_SIZE];
+static char screen_info[256];
+
+/* windows drawn over the listing, or the terminal given to a command, leave the screen unknown */
+static int screen_stale = 1;
+static unsigned searches;
+
+/* frames go out through ansi.c instead of curses, see DIRECT_OUTPUT */
+static int direct;
+static ansi_screen ansi;
+
+/* the right part of the screen shows what the highlighted entry holds, see preview.h */
+static int show_preview = SHOW_PREVIEW;
+
+/* what the pane shows, it is drawn again when any of it changes */
+typedef struct screen_pane {
+    int ready; /* preview_get() */
+    const char *text;
+    int len;
+    int index;
+    unsigned generation;
+} screen_pane;
+
+static int equal_pane(const screen_pane *a, const screen_pane *b) {
+
+    return a->ready == b->ready && a->text == b->text && a->len == b->len && a->index == b->index &&
+           a->generation == b->generation;
 }
 
-int parse_ls_line(char *line, ls_entry *entry) {
+static screen_pane screen_preview;
 
-    entry->full_line = strdup(line);
+/* the right edge paint_text() cuts at, the listing stops short of the pane */
+static int paint_edge;
 
-    char perm[32], links[32], owner[64], group[64], size[64], month[32], day[32], time_year[32];
-    int offset = 0;
-    int n = sscanf(line, "%31s %31s %63s %63s %63s %31s %31s %31s %n",
-                   perm, links, owner, group, size, month, day, time_year, &offset);
-    if (n < 8) {
-        return -1;
+/* the next frame draws every line. erase() only touches the window, curses still sends the
+ * terminal just the characters that differ from what it shows. the direct output clears the
+ * terminal instead, it does not know what the popups left there */
+static void forget_screen(int rows) {
+
+    free(screen_lines);
+    screen_lines = calloc(rows, sizeof(*screen_lines));
+
+    for (int i = 0; screen_lines && i < rows; i++) {
+        screen_lines[i].index = -2;
     }
 
-    while (line[offset] && isspace((unsigned char)line[offset])) {
-        offset++;
+    if (!screen_lines) {
+
+        endwin();
+        fprintf(stderr, "Out of memory.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    screen_action[0] = screen_info[0] = '\0';
+    screen_preview.ready = -2;
+
+    if (!direct) {
+
+        erase();
+        return;
+    }
+
+    /* after a resize curses still owes the terminal a repaint of its own, it goes out first */
+    if (is_wintouched(stdscr)) {
+        refresh();
     }
 
-    entry->fname = strdup(line + offset);
+    ansi_reset(&ansi, LINES, COLS);
+}
+
+/* applies a key that only moves the cursor, returns 0 for any other key */
+static int move_cursor(viewport *view, int ch, int count) {
+
+    if (ch == KEY_UP) {
+        viewport_move(view, -1, count);
+    } else if (ch == KEY_DOWN) {
+        viewport_move(view, 1, count);
+    } else if (ch == KEY_NEXT_PAGE) {
+        viewport_page(view, 1, count);
+    } else if (ch == KEY_PREV_PAGE) {
+        viewport_page(view, -1, count);
+    } else {
+        return 0;
+    }
 
-    int prefix_len = offset;
+    return 1;
+}
 
-    entry->prefix = malloc(prefix_len + 1);
+/* lines left for the listing between the last action on top and the info bar and hint below */
+static int screen_rows(void) {
 
-    strncpy(entry->prefix, line, prefix_len);
+    int rows = LINES - 3;
 
-    entry->prefix[prefix_len] = '\0';
+    if (ENTRIES_PER_PAGE > 0 && ENTRIES_PER_PAGE < rows) {
+        rows = ENTRIES_PER_PAGE;
+    }
 
-    if (perm[0] == 'd') {
+    return rows > 0 ? rows : 1;
+}
 
-        entry->type = file_dir;
+/* blanks `width` columns of line y from column x on */
+static void paint_clear(int y, int x, int width) {
 
-    } else if (perm[0] == 'l') {
+    if (direct) {
 
-        entry->type = file_link;
+        ansi_clear(&ansi, y, x, width);
+        return;
+    }
 
-    } else if (perm[0] == '-' && strchr(perm, 'x') != NULL) {
+    if (x + width >= COLS) {
 
-        entry->type = file_exec;
+        move(y, x);
+        clrtoeol();
 
     } else {
 
-        entry->type = file_reg;
+        mvhline(y, x, ' ', width);
     }
+}
 
-    return 0;
+/* writes len bytes of s from column x on and cuts them at paint_edge. a wrapped line would run
+ * into the next one, which a frame does not draw again unless it changed itself */
+static void paint_text(int y, int x, const char *s, int len, attr_t attr) {
+
+    if (x >= paint_edge) {
+        return;
+    }
+
+    if (len > paint_edge - x) {
+        len = paint_edge - x;
+    }
+
+    if (direct) {
+
+        ansi_put(&ansi, y, x, s, len, attr);
+        return;
+    }
+
+    attrset(attr);
+    mvaddnstr(y, x, s, len);
+    attrset(A_NORMAL);
 }
 
-int load_ls_entries(const char *path, ls_entry ***entries_out) {
+/* the preview pane from column x to the right edge, on the `rows` lines of the listing */
+static void draw_preview(int rows, int x) {
 
-    char command[256];
+    const char *text = NULL;
+    int len = 0;
+    int ready = preview_get(&text, &len);
 
-    int ret = snprintf(command, sizeof(command), LS_COMMAND " %s", path);
+    for (int line = 0; line < rows; line++) {
 
-    if (ret < 0 || (size_t)ret >= sizeof(command)) {
+        paint_clear(line + 1, x - 1, COLS - x + 1);
+        paint_text(line + 1, x - 1, "|", 1, A_NORMAL);
+    }
 
-        fprintf(stderr, "Command buffer too small.\n");
-        return -1;
+    if (ready == 0) {
+
+        paint_text(1, x + 1, "reading...", 10, A_NORMAL);
+        return;
     }
 
-    FILE *fp = popen(command, "r");
-    if (!fp) {
-        return -1;
+    for (int line = 0, at = 0; ready > 0 && line < rows && at < len; line++) {
+
+        const char *end = memchr(text + at, '\n', len - at);
+        int n = end ? end - (text + at) : len - at;
+
+        paint_text(line + 1, x + 1, text + at, n, A_NORMAL);
+        at += n + 1;
+    }
+}
+
+/* a window over the listing. the direct output went past curses, which does not know what is
+ * under it, redrawwin() has it send every cell of the window */
+static WINDOW *open_popup(int height, int width, int starty, int startx) {
+
+    WINDOW *win = newwin(height, width, starty, startx);
+    screen_stale = 1;
+
+    if (direct && win) {
+        redrawwin(win);
     }
 
-    ls_entry **entries = NULL;
-    int capacity = 20, count = 0;
+    return win;
+}
 
-    entries = malloc(capacity * sizeof(ls_entry *));
-    char line[MAX_LINE];
+static void draw_entry(const ls_listing *listing, const ls_hits *hits, const screen_line *shows, int y) {
 
-    /* skip the "total" line. */
-    if (fgets(line, sizeof(line), fp) != NULL) {
+    const ls_table *t = &listing->table;
+    int entry = shows->row;
+    attr_t attr = shows->selected ? A_REVERSE : A_NORMAL;
 
-        if (strncmp(line, "total", 5) != 0) {
+    char number[16];
+    int len = snprintf(number, sizeof(number), "[%2d]", shows->index);
+    paint_text(y, 0, number, len, attr);
+    int col = 4 + len;
+    char prefix_buf[MAX_LINE];
+    const char *prefix = listing_prefix(listing, entry, prefix_buf, sizeof(prefix_buf));
+    len = strlen(prefix);
+    paint_text(y, col, prefix, len, attr);
+    col += len;
 
-            trim_newline(line);
-            ls_entry *entry = malloc(sizeof(ls_entry));
-            if (parse_ls_line(line, entry) == 0) {
+    int pair;
 
-                entries[count++] = entry;
+    switch (t->type[entry]) {
 
-            } else {
+    case file_dir: {
+        pair = 1;
+        break;
+    }
 
-                free(entry);
-            }
-        }
+    case file_exec: {
+        pair = 2;
+        break;
     }
 
-    while (fgets(line, sizeof(line), fp) != NULL) {
+    case file_link: {
+        pair = 4;
+        break;
+    }
 
-        trim_newline(line);
-        if (strlen(line) == 0) {
+    default: {
+        pair = 3;
+        break;
+    }
+    }
 
-            continue;
-        }
-        if (count >= capacity) {
+    const char *name = t->fname[entry];
+    len = strlen(name);
+    attr |= COLOR_PAIR(pair);
+    paint_text(y, col, name, len, attr);
+
+    /* the characters a search matched stand out in its hits */
+    if (shows->hit) {
+
+        int marks[FUZZY_MAX_QUERY];
+        int marked = fuzzy_positions(name, t->name_len[entry], hits->query, marks);
 
-            capacity *= 2;
-            entries = realloc(entries, capacity * sizeof(ls_entry *));
+        for (int m = 0; m < marked; m++) {
+            paint_text(y, col + marks[m], name + marks[m], 1, attr | A_BOLD | A_UNDERLINE);
         }
+    }
+
+    /* the du total follows the name, '+' while it is still growing */
+    if (shows->du >= 0) {
+
+        char size[16], total[32];
+        format_size_human(shows->du_bytes, size, sizeof(size));
+        paint_text(y, col + len, total, snprintf(total, sizeof(total), "  [%s%s]", size, shows->du ? "" : "+"), attr);
+    }
+}
+
+/* the help screen is as long as it needs to be and shown a page of the terminal at a time */
+#define HELP_MAX_LINES 40
 
-        ls_entry *entry = malloc(sizeof(ls_entry));
+void show_help(void) {
+
+    char lines[HELP_MAX_LINES][160];
+    int count = 0;
+
+#define help_line(...) snprintf(lines[count < HELP_MAX_LINES - 1 ? count++ : count], sizeof(lines[0]), __VA_ARGS__)
+
+    help_line("Key Bindings:");
+    help_line("%s", "");
+    help_line("  %c        : Jump to a line", KEY_JUMP);
+    help_line("  %c        : Next page", KEY_NEXT_PAGE);
+    help_line("  %c        : Previous page", KEY_PREV_PAGE);
+    help_line("  %c        : Rename file", KEY_RENAME_2);
+    help_line("  %c        : Delete file", KEY_DELETE_2);
+    help_line("  %c        : Fuzzy find a file, ' in front finds a substring", KEY_SEARCH_1);
+    help_line("  %c        : Sort by name, version, size, mtime, extension or type", KEY_SORT);
+    help_line("  %c        : Run command", KEY_RUN_CMD);
+    help_line("  %c        : mkdir", KEY_MKDIR);
+    help_line("  %c        : create file", KEY_TOUCH);
+    help_line("  %c        : open in a new terminal", KEY_TERM_OPEN);
+    help_line("  %c        : open location in a new terminal window", KEY_OPEN_LOCATION);
+    help_line("  %c        : Show help", KEY_SHOW_HELP);
+    help_line("  %c        : Quit", KEY_QUIT);
+    help_line("  %c        : Disk usage of every directory below this one", KEY_DU);
+    help_line("  %c        : Find names below this directory", KEY_FIND_TREE);
+    help_line("  %c / %c    : Find lines in the files below, literally or by regex", KEY_GREP, KEY_GREP_REGEX);
+    help_line("  %c        : Stop finding, F5 goes back to the directory", KEY_STOP_FIND);
+    help_line("  %c / %c    : Next / previous hit of the last search", KEY_NEXT_MATCH, KEY_PREV_MATCH);
+    help_line("  Ctrl-L   : Redraw the screen");
+    help_line("  %c        : Show or hide the preview of the highlighted entry", KEY_PREVIEW);
+    help_line("  Enter    : Open a text file in the pager, %c there goes to a line or a %% of it", KEY_JUMP);
+
+    if (USE_PREFETCH) {
+
+        int started, hits;
+        listing_prefetch_stats(&started, &hits);
+        help_line("Prefetch: %d of %d prefetched directories opened (%d%%)",
+                  hits, started, started > 0 ? hits * 100 / started : 0);
+    }
+
+    preview_stats previews;
+    preview_get_stats(&previews);
+
+    if (previews.reads + previews.hits > 0) {
+
+        help_line("Preview: %d files read, %d reads dropped as the cursor moved on, %d from the cache",
+                  previews.reads, previews.cancelled, previews.hits);
+    }
 
-        if (parse_ls_line(line, entry) == 0) {
+    if (direct && ansi.frames > 0) {
+
+        help_line("Output: %lld frames, %lld bytes in %lld writes (%lld bytes a frame)",
+                  ansi.frames, ansi.bytes, ansi.writes, ansi.bytes / ansi.frames);
+    }
+
+#undef help_line
+
+    screen_stale = 1;
+    int first = 0;
+
+    while (1) {
 
-            entries[count++] = entry;
+        /* row 0 and the last two rows stay free, like before */
+        int rows = LINES - 3 > 1 ? LINES - 3 : 1;
+        int pages = (count + rows - 1) / rows;
 
+        first = first < count ? first - first % rows : 0;
+
+        clear();
+
+        for (int i = first; i < count && i < first + rows; i++) {
+            mvprintw(1 + i - first, 2, "%.*s", COLS > 2 ? COLS - 2 : 0, lines[i]);
+        }
+
+        if (pages > 1) {
+            mvprintw(LINES - 2, 2, "Page %d/%d, %c / %c for the others. Any other key to return.",
+                     first / rows + 1, pages, KEY_NEXT_PAGE, KEY_PREV_PAGE);
         } else {
+            mvprintw(LINES - 2, 2, "Press any key to return.");
+        }
 
-            free(entry);
+        refresh();
+        int ch = getch();
+
+        int down = ch == KEY_NEXT_PAGE || ch == KEY_NPAGE || ch == KEY_DOWN || ch == ' ';
+        int up = ch == KEY_PREV_PAGE || ch == KEY_PPAGE || ch == KEY_UP;
+
+        if (down && first + rows < count) {
+            first += rows;
+        } else if (up && first > 0) {
+            first -= rows;
+        } else if (!down && !up && ch != KEY_RESIZE) {
+            break;
         }
     }
-
-    pclose(fp);
-    *entries_out = entries;
-    return count;
 }
 
-void free_ls_entry(ls_entry *entry) {
+/* one line of the pager from s on, tabs expanded and anything but printable ASCII shown as '?' */
+static void pager_draw_line(int y, const char *s, long long left) {
+
+    char line[1024];
+    int width = COLS < (int)sizeof(line) ? COLS : (int)sizeof(line);
+    int col = 0;
 
-    if (entry) {
+    for (long long i = 0; i < left && s[i] != '\n' && col < width; i++) {
 
-        free(entry->full_line);
-        free(entry->prefix);
-        free(entry->fname);
-        free(entry);
+        if (s[i] == '\t') {
+
+            do {
+                line[col++] = ' ';
+            } while (col % 8 && col < width);
+
+        } else {
+
+            line[col++] = s[i] >= 32 && s[i] < 127 ? s[i] : '?';
+        }
     }
+
+    mvaddnstr(y, 0, line, col);
 }
 
-void free_ls_entries(ls_entry **entries, int count) {
+/* moves top down (count > 0) or up by up to count lines, but not past `end`. returns how many it moved */
+static long long pager_move(pager *p, long long *top, long long count, long long end) {
 
-    for (int i = 0; i < count; i++) {
+    long long moved = 0;
 
-        free_ls_entry(entries[i]);
+    for (; count > 0 && *top < end; count--, moved++) {
+        *top = pager_next_line(p, *top);
     }
 
-    free(entries);
+    for (long long offset; count < 0 && (offset = pager_prev_line(p, *top)) >= 0; count++, moved--) {
+        *top = offset;
+    }
+
+    return moved;
 }
 
-const char *file_type_str(int type) {
+/* where the top line is when the last line of the file is at the bottom of the screen */
+static long long pager_end(pager *p, int rows) {
 
-    switch (type) {
+    long long size, end;
+    pager_text(p, &size);
 
-    case file_dir:
-        return "DIRECTORY";
-        break;
+    end = pager_line_start(p, size > 0 ? size - 1 : 0);
+    pager_move(p, &end, -(rows - 1), 0);
 
-    case file_exec:
-        return "EXECUTABLE";
-        break;
+    return end;
+}
 
-    case file_link:
-        return "SYMLINK";
-        break;
+/* shows the file in the built-in pager until KEY_QUIT, see pager.h. returns -1 if it can't be opened */
+int show_pager(const char *path) {
 
-    default:
-        return "REGULAR";
+    pager *p = pager_open(path);
+    if (!p) {
+        return -1;
     }
-}
 
-void show_help(void) {
+    long long size;
+    const char *text = pager_text(p, &size);
+    long long top = 0, top_line = 0;
+    char note[128] = "";
 
+    screen_stale = 1;
     clear();
 
-    mvprintw(1, 2, "Key Bindings:");
+    while (1) {
+
+        int rows = LINES - 1;
+        long long end = pager_end(p, rows);
+
+        pager_stats stats;
+        pager_progress(p, &stats);
+
+        /* a jump into the part that is not indexed yet gets its line number once it is */
+        if (top_line < 0) {
+            top_line = pager_line_number(p, top);
+        }
+
+        erase();
+
+        long long offset = top;
+
+        for (int y = 0; y < rows; y++) {
+
+            if (offset >= 0 && offset < size) {
+
+                pager_draw_line(y, text + offset, size - offset);
+                offset = pager_next_line(p, offset);
+
+            } else {
+
+                mvaddch(y, 0, '~');
+            }
+        }
+
+        char line[32] = "?", lines[32], status[512];
+
+        if (top_line >= 0) {
+            snprintf(line, sizeof(line), "%lld", top_line + 1);
+        }
+
+        snprintf(lines, sizeof(lines), "%lld%s", stats.lines, stats.done ? "" : "+");
+
+        /* how far into the file the bottom of the screen is */
+        int len = snprintf(status, sizeof(status), " %s  line %s of %s  %lld%%", path, line, lines,
+                           size > 0 && offset >= 0 ? offset * 100 / size : 100);
+
+        if (!stats.done && len < (int)sizeof(status)) {
+
+            char speed[16];
+            format_size_human(stats.bytes_per_second, speed, sizeof(speed));
+            len += snprintf(status + len, sizeof(status) - len, "  indexing %lld%% at %s/s",
+                            stats.size > 0 ? stats.scanned * 100 / stats.size : 100, speed);
+        }
+
+        if (stats.truncated && len < (int)sizeof(status)) {
+            len += snprintf(status + len, sizeof(status) - len, "  truncated since opened");
+        }
+
+        if (note[0] && len < (int)sizeof(status)) {
+            snprintf(status + len, sizeof(status) - len, "  %s", note);
+        }
+
+        attron(A_REVERSE);
+        mvprintw(rows, 0, "%-*.*s", COLS, COLS, status);
+        attroff(A_REVERSE);
+        refresh();
+
+        timeout(stats.done ? -1 : PAGER_REFRESH_MS);
+        int ch = getch();
+
+        if (ch == ERR) {
+            continue;
+        }
+
+        note[0] = '\0';
+
+        if (ch == KEY_QUIT || ch == KEY_GO_UP) {
 
-    mvprintw(3, 4, "%c        : Jump to a line", KEY_JUMP);
-    mvprintw(4, 4, "%c        : Next page", KEY_NEXT_PAGE);
-    mvprintw(5, 4, "%c        : Previous page", KEY_PREV_PAGE);
-    mvprintw(6, 4, "%c        : Rename file", KEY_RENAME_2);
-    mvprintw(7, 4, "%c        : Delete file", KEY_DELETE_2);
-    mvprintw(8, 4, "%c        : Search file", KEY_SEARCH_1);
+            break;
+
+        } else if (ch == KEY_DOWN || ch == KEY_UP) {
+
+            long long moved = pager_move(p, &top, ch == KEY_DOWN ? 1 : -1, end);
+            top_line = top_line >= 0 ? top_line + moved : -1;
+
+        } else if (ch == KEY_NEXT_PAGE || ch == KEY_NPAGE || ch == ' ' || ch == KEY_PREV_PAGE || ch == KEY_PPAGE) {
+
+            int down = ch == KEY_NEXT_PAGE || ch == KEY_NPAGE || ch == ' ';
+            long long moved = pager_move(p, &top, down ? rows : -rows, end);
+            top_line = top_line >= 0 ? top_line + moved : -1;
+
+        } else if (ch == KEY_HOME) {
+
+            top = top_line = 0;
+
+        } else if (ch == KEY_END) {
+
+            top = end;
+            top_line = -1;
+
+        } else if (ch == KEY_JUMP) {
+
+            char input[32];
+            prompt_input("Go to line, or with a % that far into the file:", input, sizeof(input));
+
+            char *rest;
+            long long target = strtoll(input, &rest, 10);
 
-    mvprintw(10, 4, "%c        : Run command", KEY_RUN_CMD);
-    mvprintw(11, 4, "%c        : mkdir", KEY_MKDIR);
-    mvprintw(12, 4, "%c        : create file", KEY_TOUCH);
-    mvprintw(13, 4, "%c        : open in a new terminal", KEY_TERM_OPEN);
-    mvprintw(14, 4, "%c        : open location in a new terminal window", KEY_OPEN_LOCATION);
-    mvprintw(15, 4, "%c        : Show help", KEY_SHOW_HELP);
-    mvprintw(16, 4, "%c        : Quit", KEY_QUIT);
+            if (rest == input) {
 
-    mvprintw(LINES - 2, 2, "Press any key to return.");
+                /* nothing typed */
+
+            } else if (*rest == '%') {
+
+                /* a byte offset, the index is not needed to get there and the line number follows once
+                 * it covers it */
+                target = target < 0 ? 0 : target > 100 ? 100 : target;
+                top = pager_line_start(p, size * target / 100 < size ? size * target / 100 : (size > 0 ? size - 1 : 0));
+                top = top < end ? top : end;
+                top_line = -1;
+
+            } else if ((offset = pager_line_offset(p, target > 0 ? target - 1 : 0)) >= 0) {
+
+                top = offset < end ? offset : end;
+                top_line = offset < end ? (target > 0 ? target - 1 : 0) : -1;
+
+            } else if (stats.done) {
+
+                top = end;
+                top_line = -1;
+
+            } else {
+
+                snprintf(note, sizeof(note), "line %lld is not indexed yet", target);
+            }
+        }
+    }
 
-    refresh();
-    getch();
+    timeout(-1);
+    pager_close(p);
+    return 0;
 }
 
 int confirm_box(const char *msg) {
@@ -268,7 +644,7 @@ int confirm_box(const char *msg) {
     int height = 10, width = 60;
     int starty = (LINES - height) / 2, startx = (COLS - width) / 2;
 
-    WINDOW *win = newwin(height, width, starty, startx);
+    WINDOW *win = open_popup(height, width, starty, startx);
     box(win, 0, 0);
 
     mvwprintw(win, 2, 2, "%s (y/n)", msg);
@@ -298,7 +674,7 @@ void show_message(const char *msg) {
     int height = MSG_WIN_HEIGHT, width = MSG_WIN_WIDTH;
     int starty = (LINES - height) / 2, startx = (COLS - width) / 2;
 
-    WINDOW *win = newwin(height, width, starty, startx);
+    WINDOW *win = open_popup(height, width, starty, startx);
     box(win, 0, 0);
 
     mvwprintw(win, 2, 2, "%s", msg);
@@ -313,7 +689,7 @@ int prompt_input(const char *prompt, char *buffer, int buf_size) {
     int height = PROMPT_WIN_HEIGHT, width = PROMPT_WIN_WIDTH;
     int starty = (LINES - height) / 2, startx = (COLS - width) / 2;
 
-    WINDOW *win = newwin(height, width, starty, startx);
+    WINDOW *win = open_popup(height, width, starty, startx);
     box(win, 0, 0);
 
     mvwprintw(win, 1, 2, "%s", prompt);
@@ -363,6 +739,122 @@ int prompt_input(const char *prompt, char *buffer, int buf_size) {
     return 0;
 }
 
+static double elapsed_ms(const struct timespec *since) {
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - since->tv_sec) * 1e3 + (now.tv_nsec - since->tv_nsec) / 1e6;
+}
+
+/* fuzzy finds a name of the listing, the best SEARCH_RESULTS matches are ranked again on every
+ * keystroke. Enter keeps all of them in hits and returns the row picked, -1 when cancelled */
+int search_prompt(fuzzy *fz, const ls_listing *listing, ls_hits *hits) {
+
+    int height = SEARCH_RESULTS + 4 < LINES ? SEARCH_RESULTS + 4 : LINES;
+    int width = COLS;
+    int results = height - 4;
+
+    WINDOW *win = open_popup(height, width, 0, 0);
+    keypad(win, TRUE);
+    curs_set(1);
+    searches++;
+
+    char query[FUZZY_MAX_QUERY + 1] = "";
+    int len = 0, selected = 0, picked = -1, changed = 1, matches = 0;
+    double took = 0;
+
+    while (1) {
+
+        if (changed) {
+
+            struct timespec start;
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            matches = fuzzy_query(fz, &listing->table, listing->generation, query, results);
+            took = elapsed_ms(&start);
+            selected = 0;
+            changed = 0;
+        }
+
+        werase(win);
+        box(win, 0, 0);
+
+        for (int i = 0; matches > 0 && i < fz->top_count; i++) {
+
+            int row = fz->top[i].row;
+
+            if (i == selected) {
+                wattron(win, A_REVERSE);
+            }
+
+            mvwprintw(win, i + 1, 2, "%.*s", width - 4, listing->table.fname[row]);
+
+            if (i == selected) {
+                wattroff(win, A_REVERSE);
+            }
+        }
+
+        mvwprintw(win, height - 2, 2, "%d/%d  %.2f ms", matches > 0 ? matches : 0, listing->table.count, took);
+
+        /* what answering substring queries costs in this listing */
+        if (query[0] == '\'' && fz->trigrams) {
+
+            trigram_stats stats;
+            char size[16];
+
+            trigram_report(fz->trigrams, &stats);
+            format_size_human(stats.bytes, size, sizeof(size));
+            wprintw(win, "  | index: %d names, %d trigrams, %s, built in %.0f ms, %d changes followed",
+                    stats.names, stats.trigrams, size, stats.build_ms, stats.updates);
+        }
+        mvwprintw(win, height - 3, 2, "Search: %s", query);
+        wrefresh(win);
+
+        int ch = wgetch(win);
+
+        if (ch == 27) { /* ESC cancels */
+
+            break;
+
+        } else if (ch == '\n') {
+
+            if (fz->top_count > 0 && matches > 0) {
+                picked = fz->top[selected].row;
+            }
+
+            int count;
+            const int *all = fuzzy_all(fz, &count);
+            hits_set(hits, &listing->table, query, matches > 0 ? all : NULL, count);
+            break;
+
+        } else if (ch == KEY_UP || ch == key_ctrl('p')) {
+
+            selected -= selected > 0;
+
+        } else if (ch == KEY_DOWN || ch == key_ctrl('n')) {
+
+            selected += selected < fz->top_count - 1;
+
+        } else if (ch == KEY_BACKSPACE || ch == 127) {
+
+            if (len > 0) {
+
+                query[--len] = '\0';
+                changed = 1;
+            }
+
+        } else if (len < FUZZY_MAX_QUERY && ch < 256 && isprint(ch)) {
+
+            query[len++] = ch;
+            query[len] = '\0';
+            changed = 1;
+        }
+    }
+
+    curs_set(0);
+    delwin(win);
+    return picked;
+}
+
 void run_executable(char *file_path) {
 
     if (confirm_box("Open this file?")) {
@@ -379,6 +871,7 @@ void run_executable(char *file_path) {
         printf("Press Enter to return...\n");
 
         getchar();
+        screen_stale = 1;
         initscr(); /* restore ncurses mode */
         cbreak();
         noecho();
@@ -391,14 +884,33 @@ void run_silent(char *file_path) {
 
     trim_executable_mark(file_path);
     system(file_path);
+
+    /* whatever it printed is on the screen now */
+    screen_stale = 1;
 }
 
 int main(void) {
 
     char current_path[1024] = ".";
-    int ch, selected = 0, page = 0;
-    int num_entries = 0;
-    ls_entry **entries = NULL;
+    int ch;
+    viewport view;
+    ls_listing listing = {0};
+    fuzzy search;
+    ls_hits hits;
+    struct timespec painted;
+
+    viewport_init(&view, 1);
+    view.continuous = CONTINUOUS_SCROLL;
+    fuzzy_init(&search);
+    hits_init(&hits);
+
+    /* du results are looked up by absolute path */
+    if (realpath(".", current_path) == NULL) {
+        strcpy(current_path, ".");
+    }
+
+    /* the native listing sorts with strcoll(), same as ls does with the user's locale */
+    setlocale(LC_COLLATE, "");
 
     initscr();
     cbreak();
@@ -412,8 +924,10 @@ int main(void) {
     init_pair(3, COLOR_REGULAR, COLOR_BLACK);
     init_pair(4, COLOR_SYMLINK, COLOR_BLACK);
 
-    num_entries = load_ls_entries(current_path, &entries);
-    if (num_entries < 0) {
+    /* terminals that take no ANSI cursor addressing stay with curses */
+    direct = DIRECT_OUTPUT && ansi_open(&ansi, LINES, COLS) == 0;
+
+    if (listing_open_cached(&listing, current_path, view.selected) < 0) {
 
         endwin();
         fprintf(stderr, "Failed to load directory entries.\n");
@@ -422,163 +936,379 @@ int main(void) {
 
     while (1) {
 
-        clear();
-        /* display last action message at the top */
-        mvprintw(0, 0, "%s", last_action);
+        /* a resized terminal only changes the layout, the listing stays as it is */
+        if (screen_rows() != view.rows) {
+
+            viewport_resize(&view, screen_rows());
+            screen_stale = 1;
+        }
+
+        listing_poll(&listing, &view.selected);
+        viewport_clamp(&view, listing.table.count, listing.loading);
+        hits_update(&hits, &listing.table);
 
-        int total_pages = (num_entries + ENTRIES_PER_PAGE - 1) / ENTRIES_PER_PAGE;
-        int start_index = page * ENTRIES_PER_PAGE;
-        int end_index = start_index + ENTRIES_PER_PAGE;
+        /* the cursor counts display positions, the entry under it lives at this table row */
+        int row = listing_row(&listing, view.selected);
 
-        if (end_index > num_entries) {
+        /* the highlighted entry by its bare name, without the -F mark */
+        char entry_path[2048] = "";
 
-            end_index = num_entries;
+        if (view.selected < listing.table.count) {
+            snprintf(entry_path, sizeof(entry_path), "%s/%.*s", current_path, listing.table.name_len[row], listing.table.fname[row]);
         }
 
-        for (int i = start_index; i < end_index; i++) {
+        /* list the highlighted directory ahead of time, Enter most likely goes there next */
+        if (view.selected < listing.table.count && listing.table.type[row] == file_dir &&
+            strcmp(listing.table.fname[row], "./") != 0) {
 
-            if (i == selected) {
+            listing_prefetch(entry_path);
 
-                attron(A_REVERSE);
-            }
+        } else {
 
-            mvprintw(i - start_index + 1, 0, "[%2d]", i);
-            int col = 4 + snprintf(NULL, 0, "[%2d]", i);
-            mvprintw(i - start_index + 1, col, "%s", entries[i]->prefix);
-            col += strlen(entries[i]->prefix);
+            listing_prefetch(NULL);
+        }
 
-            switch (entries[i]->type) {
+        /* the pane takes the right PREVIEW_WIDTH percent of the screen and a column for the border */
+        int pane_x = show_preview ? COLS - COLS * PREVIEW_WIDTH / 100 : COLS;
+        int listing_cols = show_preview ? pane_x - 1 : COLS;
 
-            case file_dir: {
-                attron(COLOR_PAIR(1));
-                break;
-            }
+        if (show_preview && view.selected < listing.table.count) {
 
-            case file_exec: {
-                attron(COLOR_PAIR(2));
-                break;
+            const ls_table *t = &listing.table;
+            preview_request(entry_path, t->type[row], t->native ? t->size[row] : -1, t->native ? t->mtime[row] : -1);
+        }
+
+        /* only the rows on screen are looked at, whatever the size of the listing, and of those only
+         * the lines that show something else than last time are drawn again */
+        if (screen_stale) {
+            forget_screen(view.rows);
+        }
+
+        int start_index = view.top;
+        int end_index = viewport_end(&view, listing.table.count);
+        paint_edge = listing_cols;
+
+        for (int line = 0; line < view.rows; line++) {
+
+            screen_line shows;
+            memset(&shows, 0, sizeof(shows));
+            shows.index = -1;
+
+            int i = start_index + line;
+
+            if (i < end_index) {
+
+                int entry = listing_row(&listing, i);
+
+                shows.index = i;
+                shows.row = entry;
+                shows.generation = listing.generation;
+                shows.selected = i == view.selected;
+                shows.hit = hits_test(&hits, entry);
+                shows.searches = searches;
+
+                if (listing.table.type[entry] == file_dir) {
+                    shows.du = du_lookup(current_path, listing.table.fname[entry], listing.table.name_len[entry], &shows.du_bytes);
+                } else {
+                    shows.du = -1;
+                }
+
+                if (shows.du < 0) {
+                    shows.du_bytes = 0;
+                }
             }
 
-            case file_link: {
-                attron(COLOR_PAIR(4));
-                break;
+            if (equal_line(&shows, &screen_lines[line])) {
+                continue;
             }
 
-            default: {
-                attron(COLOR_PAIR(3));
-                break;
+            screen_lines[line] = shows;
+            paint_clear(line + 1, 0, listing_cols);
+
+            if (shows.index >= 0) {
+                draw_entry(&listing, &hits, &shows, line + 1);
             }
+        }
+
+        paint_edge = COLS;
+
+        if (show_preview) {
+
+            screen_pane pane;
+            memset(&pane, 0, sizeof(pane));
+            pane.ready = preview_get(&pane.text, &pane.len);
+            pane.index = view.selected;
+            pane.generation = listing.generation;
+
+            if (!equal_pane(&pane, &screen_preview)) {
+
+                screen_preview = pane;
+                draw_preview(view.rows, pane_x);
             }
+        }
 
-            mvprintw(i - start_index + 1, col, "%s", entries[i]->fname);
-            attroff(COLOR_PAIR(1));
-            attroff(COLOR_PAIR(2));
-            attroff(COLOR_PAIR(3));
-            attroff(COLOR_PAIR(4));
+        char du_status[64] = "";
+        long long du_dirs, du_bytes;
+        int du_running = du_progress(&du_dirs, &du_bytes);
 
-            if (i == selected) {
+        if (du_running >= 0) {
+
+            char size[16];
+            format_size_human(du_bytes, size, sizeof(size));
+            snprintf(du_status, sizeof(du_status), " | du: %s in %lld dirs%s", size, du_dirs,
+                     du_running ? "..." : "");
+        }
+
+        char find_status[128] = "";
+
+        int searched = listing.finder || listing.found.entries > 0;
+
+        if (searched && listing.found.mode == find_names) {
+
+            snprintf(find_status, sizeof(find_status), " | find: %lld hits in %lld entries, %lld/s%s",
+                     listing.found.matches, listing.found.entries, listing.found.per_second,
+                     listing.found.running ? "..." : "");
+
+        } else if (searched) {
+
+            char bytes[16], rate[16];
+            format_size_human(listing.found.bytes, bytes, sizeof(bytes));
+            format_size_human(listing.found.bytes_per_second, rate, sizeof(rate));
+            snprintf(find_status, sizeof(find_status), " | grep: %lld lines in %lld files (%s, %s/s), %lld skipped%s",
+                     listing.found.matches, listing.found.files, bytes, rate, listing.found.skipped,
+                     listing.found.running ? "..." : "");
+        }
+
+        char hits_status[96] = "";
+
+        if (hits.query[0]) {
 
-                attroff(A_REVERSE);
+            int ordinal = hits_ordinal(&hits, &listing, view.selected);
+
+            if (ordinal > 0) {
+                snprintf(hits_status, sizeof(hits_status), " | %s: %d of %d", hits.query, ordinal, hits.count);
+            } else {
+                snprintf(hits_status, sizeof(hits_status), " | %s: %d hits", hits.query, hits.count);
             }
         }
 
-        char info_bar[100];
-        int ret = snprintf(info_bar, sizeof(info_bar), "INFO: %-*s | Page (%d/%d)",
-                           INFO_BAR_PADDING, file_type_str(entries[selected]->type),
-                           page + 1, total_pages);
+        /* a listing cut short by an error shows what was read before it */
+        char load_status[96] = "";
+
+        if (listing.loading && !listing.finder) {
+            snprintf(load_status, sizeof(load_status), " | loading...");
+        } else if (listing.error) {
+            snprintf(load_status, sizeof(load_status), " | incomplete: %s", strerror(listing.error));
+        }
+
+        char info_bar[256];
+        int ret = snprintf(info_bar, sizeof(info_bar), "INFO: %-*s | Page (%d/%d%s) | Sort: %s%s%s%s%s",
+                           INFO_BAR_PADDING,
+                           view.selected < listing.table.count ? file_type_str(listing.table.type[row]) : "LOADING",
+                           viewport_page_number(&view) + 1, viewport_page_count(&view, listing.table.count), listing.loading ? "+" : "", sort_key_str(listing.sort),
+                           hits_status, du_status, find_status, load_status);
         if (ret < 0 || (size_t)ret >= sizeof(info_bar)) {
             info_bar[sizeof(info_bar) - 1] = '\0';
         }
-        mvprintw(LINES - 2, 0, "%s", info_bar);
-        mvprintw(LINES - 1, 0, "q: Quit | h: Help | r: Rename | d: Delete | n: Next | p: Prev "
-                               "| m: mkdir | t: touch | x: Run Command | z: Run in a new window");
-        refresh();
+        /* display last action message at the top */
+        if (strcmp(last_action, screen_action) != 0) {
 
-        ch = getch();
+            paint_clear(0, 0, COLS);
+            paint_text(0, 0, last_action, strlen(last_action), A_NORMAL);
+            snprintf(screen_action, sizeof(screen_action), "%s", last_action);
+        }
 
-        if (ch == KEY_QUIT) {
+        if (strcmp(info_bar, screen_info) != 0) {
 
-            if (confirm_box("Are you sure you want to quit?")) {
-                break;
-            }
+            paint_clear(LINES - 2, 0, COLS);
+            paint_text(LINES - 2, 0, info_bar, strlen(info_bar), A_NORMAL);
+            snprintf(screen_info, sizeof(screen_info), "%s", info_bar);
+        }
+
+        if (screen_stale) {
+
+            /* the most used keys first, the terminal cuts the line wherever it ends */
+            char hint[512];
+            int len = 0;
+
+#define hint_key(...) (len += len < (int)sizeof(hint) ? snprintf(hint + len, sizeof(hint) - len, __VA_ARGS__) : 0)
+
+            hint_key("%c: Quit | %c: Help", KEY_QUIT, KEY_SHOW_HELP);
+            hint_key(" | %c: Find", KEY_SEARCH_1);
+            hint_key(" | %c: Sort", KEY_SORT);
+            hint_key(" | %c/%c: Page", KEY_NEXT_PAGE, KEY_PREV_PAGE);
+            hint_key(" | %c: Preview", KEY_PREVIEW);
+            hint_key(" | %c: Find below | %c: Stop", KEY_FIND_TREE, KEY_STOP_FIND);
+            hint_key(" | %c/%c: Grep", KEY_GREP, KEY_GREP_REGEX);
+            hint_key(" | %c/%c: Next/prev hit", KEY_NEXT_MATCH, KEY_PREV_MATCH);
+            hint_key(" | %c: Disk usage", KEY_DU);
+            hint_key(" | %c: Rename | %c: Delete", KEY_RENAME_2, KEY_DELETE_2);
+            hint_key(" | %c: mkdir | %c: touch", KEY_MKDIR, KEY_TOUCH);
+            hint_key(" | %c: Run Command | %c: Run in a new window", KEY_RUN_CMD, KEY_TERM_OPEN);
+            hint_key(" | Ctrl-L: Redraw");
+
+#undef hint_key
+
+            paint_clear(LINES - 1, 0, COLS);
+            paint_text(LINES - 1, 0, hint, len < (int)sizeof(hint) ? len : (int)sizeof(hint) - 1, A_NORMAL);
+            screen_stale = 0;
+        }
+
+        if (direct) {
+            ansi_flush(&ansi, STDOUT_FILENO);
+        } else {
+            refresh();
+        }
+        clock_gettime(CLOCK_MONOTONIC, &painted);
+
+        /* sleep until a key arrives, the listing changes underneath (streaming in, or watched)
+         * or a du scan has new totals */
+        while (1) {
 
-        } else if (ch == KEY_UP && selected > 0) {
+            int wait = listing_poll_timeout(&listing);
+            int du_wait = du_poll_timeout();
 
-            selected--;
-            if (selected < start_index) {
-                page--;
+            int preview_wait = show_preview ? preview_poll_timeout() : -1;
+
+            if (du_wait >= 0 && (wait < 0 || du_wait < wait)) {
+                wait = du_wait;
+            }
+
+            if (preview_wait >= 0 && (wait < 0 || preview_wait < wait)) {
+                wait = preview_wait;
             }
 
-        } else if (ch == KEY_DOWN && selected < num_entries - 1) {
+            timeout(wait);
+            ch = getch();
 
-            selected++;
-            if (selected >= end_index) {
-                page++;
+            if (ch != ERR || listing_poll(&listing, &view.selected) | du_poll() | preview_poll()) {
+                break;
             }
+        }
+        timeout(-1);
 
-        } else if (ch == KEY_NEXT_PAGE) {
+        if (ch == ERR) {
+            continue;
+        }
+
+        /* a held down key repeats faster than frames can be drawn over a slow link. every cursor key
+         * that is waiting, or arrives within FRAME_MIN_MS of the last frame, is applied before the
+         * next one, so the cursor stops where it is when the key is let go */
+        if (move_cursor(&view, ch, listing.table.count)) {
+
+            while (1) {
+
+                double left = FRAME_MIN_MS - elapsed_ms(&painted);
+
+                timeout(left > 0 ? (int)left : 0);
+                ch = getch();
+
+                if (ch == ERR) {
+                    break;
+                }
 
-            if (page < total_pages - 1) {
+                if (!move_cursor(&view, ch, listing.table.count)) {
 
-                page++;
-                selected = page * ENTRIES_PER_PAGE;
+                    ungetch(ch);
+                    break;
+                }
             }
+            timeout(-1);
+            continue;
+        }
 
-        } else if (ch == KEY_PREV_PAGE) {
+        row = listing_row(&listing, view.selected);
 
-            if (page > 0) {
-                page--;
-                selected = page * ENTRIES_PER_PAGE;
+        /* keys that act on the selected entry wait until the loader got that far */
+        if (view.selected >= listing.table.count &&
+            (ch == '\n' || ch == KEY_RENAME_1 || ch == KEY_RENAME_2 || ch == KEY_DELETE_1 ||
+             ch == KEY_DELETE_2 || ch == KEY_TERM_OPEN)) {
+            continue;
+        }
+
+        if (ch == KEY_QUIT) {
+
+            if (confirm_box("Are you sure you want to quit?")) {
+                break;
             }
 
         } else if (ch == KEY_JUMP) {
 
             echo();
             char num_str[10];
+            screen_stale = 1;
+
+            /* curses can't tell what the direct output left on that line */
+            if (direct) {
+                wredrawln(stdscr, LINES - 3, 1);
+            }
+
             mvprintw(LINES - 3, 0, "Jump to line: ");
+            clrtoeol();
 
             getnstr(num_str, sizeof(num_str) - 1);
             noecho();
 
             int jump = atoi(num_str);
 
-            if (jump >= 0 && jump < num_entries) {
+            viewport_jump(&view, jump, listing.table.count);
+
+        } else if (ch == KEY_SEARCH_1 || ch == KEY_SEARCH_2) {
+
+            /* the candidates stay around while the listing does not change, searching it again is quick */
+            int found = search_prompt(&search, &listing, &hits);
 
-                selected = jump;
-                page = jump / ENTRIES_PER_PAGE;
+            if (found >= 0) {
+                viewport_jump(&view, listing_index(&listing, found), listing.table.count);
             }
 
-        } else if (ch == KEY_SEARCH_1 || ch == KEY_SEARCH_2) {
+        } else if (ch == KEY_REDRAW) {
 
-            char search_query[256] = {0};
-            prompt_input("Search: ", search_query, sizeof(search_query));
+            /* the terminal is repainted from scratch, in case something else wrote to it. the direct
+             * output clears it anyway */
+            if (!direct) {
+                clearok(curscr, TRUE);
+            }
+            screen_stale = 1;
 
-            if (strlen(search_query) > 0) {
+        } else if (ch == KEY_PREVIEW) {
 
-                int found = 0;
+            show_preview = !show_preview;
+            screen_stale = 1;
 
-                for (int i = 0; i < num_entries; i++) {
-                    /* this is slow */
-                    if (strcasestr(entries[i]->fname, search_query) != NULL) {
-                        selected = i;
-                        page = i / ENTRIES_PER_PAGE;
-                        found = 1;
-                        break;
-                    }
-                }
+        } else if (ch == KEY_RESIZE) {
 
-                if (!found) {
+            /* curses caught SIGWINCH and resized stdscr, the next frame lays the screen out again */
+            screen_stale = 1;
 
-                    show_message("No matching file found. Press any key.");
-                }
+        } else if (ch == KEY_NEXT_MATCH || ch == KEY_PREV_MATCH) {
+
+            /* the listing may have changed while waiting for the key */
+            hits_update(&hits, &listing.table);
+            int index = hits_next(&hits, &listing, view.selected, ch == KEY_NEXT_MATCH);
+
+            if (index >= 0) {
+                viewport_jump(&view, index, listing.table.count);
             }
 
+        } else if (ch == '\n' && listing.found.mode != find_names) {
+
+            /* a "path:line: text" row, the path is its bare name */
+            char hit_path[1024], command[2048];
+            int len = listing.table.name_len[row] < (int)sizeof(hit_path) ? listing.table.name_len[row] : (int)sizeof(hit_path) - 1;
+
+            memcpy(hit_path, listing.table.fname[row], len);
+            hit_path[len] = '\0';
+
+            snprintf(command, sizeof(command), GREP_OPEN_COMMAND, atoi(listing.table.fname[row] + len + 1), hit_path);
+            run_executable(command);
+
         } else if (ch == '\n') {
 
-            if ((entries[selected]->type == file_dir) ||
-                (strcmp(entries[selected]->fname, "../") == 0)) {
+            if ((listing.table.type[row] == file_dir) ||
+                (strcmp(listing.table.fname[row], "../") == 0)) {
                 char new_path[1024];
-                int ret2 = snprintf(new_path, sizeof(new_path), "%s/%s", current_path, entries[selected]->fname);
+                int ret2 = snprintf(new_path, sizeof(new_path), "%s/%s", current_path, listing.table.fname[row]);
 
                 if (ret2 < 0 || (size_t)ret2 >= sizeof(new_path)) {
 
@@ -593,27 +1323,20 @@ int main(void) {
                         break;
                     }
 
-                    free_ls_entries(entries, num_entries);
-                    num_entries = load_ls_entries(current_path, &entries);
-
-                    if (selected >= num_entries) {
-                        selected = num_entries - 1;
-                    }
-
-                    page = selected / ENTRIES_PER_PAGE;
+                    listing_open_cached(&listing, current_path, view.selected);
                 }
 
             } else {
 
-                char *ext = strrchr(entries[selected]->fname, '.');
+                char *ext = strrchr(listing.table.fname[row], '.');
 
                 char command[1024];
 
-                if (entries[selected]->type == file_exec) {
+                if (listing.table.type[row] == file_exec) {
 
                     char exec_path[2048];
 
-                    snprintf(exec_path, sizeof(exec_path), "%s/%s", current_path, entries[selected]->fname);
+                    snprintf(exec_path, sizeof(exec_path), "%s/%s", current_path, listing.table.fname[row]);
                     run_executable(exec_path);
 
                 } else if ((ext && strcasecmp(ext, ".png") == 0) ||
@@ -621,35 +1344,41 @@ int main(void) {
                            (ext && strcasecmp(ext, ".jpg") == 0) ||
                            (ext && strcasecmp(ext, ".gif") == 0)) {
 
-                    snprintf(command, sizeof(command), IMAGE_VIEWER_COMMAND, entries[selected]->fname);
+                    snprintf(command, sizeof(command), IMAGE_VIEWER_COMMAND, listing.table.fname[row]);
                     run_executable(command);
                 } else if ((ext && strcasecmp(ext, ".mp4") == 0) ||
                            (ext && strcasecmp(ext, ".mov")) == 0) {
 
-                    snprintf(command, sizeof(command), VIDEO_PLAYER_COMMAND, entries[selected]->fname);
+                    snprintf(command, sizeof(command), VIDEO_PLAYER_COMMAND, listing.table.fname[row]);
                     run_executable(command);
                 } else if ((ext && strcasecmp(ext, ".mp3")) == 0 ||
                            (ext && strcasecmp(ext, ".ogg")) == 0 ||
                            (ext && strcasecmp(ext, ".wav")) == 0) {
 
-                    snprintf(command, sizeof(command), AUDIO_PLAYER_COMMAND, entries[selected]->fname);
+                    snprintf(command, sizeof(command), AUDIO_PLAYER_COMMAND, listing.table.fname[row]);
                     run_executable(command);
                 } else {
 
-                    /* fallback */
-                    snprintf(command, sizeof(command), "xdg-open %s", entries[selected]->fname);
-                    run_executable(command);
-                }
+                    /* text opens in the pager, anything else with whatever the desktop has for it */
+                    char name[1024];
+                    snprintf(name, sizeof(name), "%.*s", listing.table.name_len[row], listing.table.fname[row]);
 
-                free_ls_entries(entries, num_entries);
-                num_entries = load_ls_entries(current_path, &entries);
+                    if (!USE_PAGER || !pager_wants(name) || show_pager(name) != 0) {
 
-                if (selected >= num_entries)
-                    selected = num_entries - 1;
+                        snprintf(command, sizeof(command), "xdg-open %s", listing.table.fname[row]);
+                        run_executable(command);
+                    }
+                }
 
-                page = selected / ENTRIES_PER_PAGE;
+                listing_refresh(&listing, current_path, view.selected);
             }
 
+        } else if ((ch == KEY_RENAME_1 || ch == KEY_RENAME_2 || ch == KEY_DELETE_1 || ch == KEY_DELETE_2 ||
+                    ch == KEY_TERM_OPEN) && listing.found.mode != find_names) {
+
+            /* the name of a "path:line: text" row is no file, and the whole file is not what was picked */
+            show_message("Not on lines found by a search.");
+
         } else if (ch == KEY_RENAME_1 || ch == KEY_RENAME_2) {
 
             char new_name[256] = {0};
@@ -659,10 +1388,10 @@ int main(void) {
             if (strlen(new_name) > 0) {
 
                 char old_filename[512];
-                strncpy(old_filename, entries[selected]->fname, sizeof(old_filename));
+                strncpy(old_filename, listing.table.fname[row], sizeof(old_filename));
                 old_filename[sizeof(old_filename) - 1] = '\0';
 
-                if (entries[selected]->type == file_exec) {
+                if (listing.table.type[row] == file_exec) {
 
                     size_t len = strlen(old_filename);
 
@@ -700,14 +1429,7 @@ int main(void) {
                     if (rename(old_path, new_path) == 0) {
 
                         snprintf(last_action, LAST_ACTION_SIZE, "Renamed '%.50s' to '%.50s'", old_filename, new_name);
-                        free_ls_entries(entries, num_entries);
-
-                        num_entries = load_ls_entries(current_path, &entries);
-
-                        if (selected >= num_entries)
-                            selected = num_entries - 1;
-
-                        page = selected / ENTRIES_PER_PAGE;
+                        listing_refresh(&listing, current_path, view.selected);
                     }
                 }
             }
@@ -716,25 +1438,18 @@ int main(void) {
             if (confirm_box("Confirm delete?")) {
 
                 char del_path[2048];
-                snprintf(del_path, sizeof(del_path), "%s/%s", current_path, entries[selected]->fname);
+                snprintf(del_path, sizeof(del_path), "%s/%s", current_path, listing.table.fname[row]);
 
                 trim_executable_mark(del_path);
 
                 if (remove(del_path) == 0) {
-                    snprintf(last_action, LAST_ACTION_SIZE, "Deleted '%.50s'", entries[selected]->fname);
-
-                    free_ls_entries(entries, num_entries);
-                    num_entries = load_ls_entries(current_path, &entries);
+                    snprintf(last_action, LAST_ACTION_SIZE, "Deleted '%.50s'", listing.table.fname[row]);
 
-                    if (selected >= num_entries)
-                        selected = num_entries - 1;
-
-                    page = selected / ENTRIES_PER_PAGE;
+                    listing_refresh(&listing, current_path, view.selected);
 
                 } else {
-                    endwin();
-                    printf("path sent%s\n", del_path);
-                    perror("remove()\n");
+
+                    snprintf(last_action, LAST_ACTION_SIZE, "Delete failed for '%.50s': %s", listing.table.fname[row], strerror(errno));
                 }
             }
         } else if (ch == KEY_RUN_CMD) {
@@ -746,13 +1461,7 @@ int main(void) {
 
                 int status = system(cmd);
                 snprintf(last_action, LAST_ACTION_SIZE, "Ran '%.50s' (status %d)", cmd, status);
-                free_ls_entries(entries, num_entries);
-                num_entries = load_ls_entries(current_path, &entries);
-
-                if (selected >= num_entries)
-                    selected = num_entries - 1;
-
-                page = selected / ENTRIES_PER_PAGE;
+                listing_refresh(&listing, current_path, view.selected);
             }
         } else if (ch == KEY_MKDIR) {
 
@@ -770,13 +1479,7 @@ int main(void) {
                     snprintf(last_action, LAST_ACTION_SIZE, "mkdir failed for '%s'", dir_name);
                 }
 
-                free_ls_entries(entries, num_entries);
-                num_entries = load_ls_entries(current_path, &entries);
-
-                if (selected >= num_entries)
-                    selected = num_entries - 1;
-
-                page = selected / ENTRIES_PER_PAGE;
+                listing_refresh(&listing, current_path, view.selected);
             }
         } else if (ch == KEY_TOUCH) {
             char file_name[256] = {0};
@@ -795,23 +1498,11 @@ int main(void) {
                     snprintf(last_action, LAST_ACTION_SIZE, "Touch failed for '%s'", file_name);
                 }
 
-                free_ls_entries(entries, num_entries);
-                num_entries = load_ls_entries(current_path, &entries);
-
-                if (selected >= num_entries)
-                    selected = num_entries - 1;
-
-                page = selected / ENTRIES_PER_PAGE;
+                listing_refresh(&listing, current_path, view.selected);
             }
         } else if (ch == KEY_RELOAD) {
 
-            free_ls_entries(entries, num_entries);
-            num_entries = load_ls_entries(current_path, &entries);
-
-            if (selected >= num_entries)
-                selected = num_entries - 1;
-
-            page = selected / ENTRIES_PER_PAGE;
+            listing_open(&listing, current_path, view.selected);
         } else if (ch == KEY_GO_UP) {
             if (chdir("..") == 0) {
 
@@ -821,30 +1512,18 @@ int main(void) {
                     break;
                 }
 
-                free_ls_entries(entries, num_entries);
-                num_entries = load_ls_entries(current_path, &entries);
-
-                if (selected >= num_entries)
-                    selected = num_entries - 1;
-
-                page = selected / ENTRIES_PER_PAGE;
+                listing_open_cached(&listing, current_path, view.selected);
             }
         } else if (ch == KEY_TERM_OPEN) {
 
-            if (entries[selected]->type == file_exec) {
+            if (listing.table.type[row] == file_exec) {
 
                 char command[2048];
 
-                snprintf(command, sizeof(command), TERM_OPEN_COMMAND, entries[selected]->fname);
+                snprintf(command, sizeof(command), TERM_OPEN_COMMAND, listing.table.fname[row]);
                 run_executable(command);
 
-                free_ls_entries(entries, num_entries);
-                num_entries = load_ls_entries(current_path, &entries);
-
-                if (selected >= num_entries)
-                    selected = num_entries - 1;
-
-                page = selected / ENTRIES_PER_PAGE;
+                listing_refresh(&listing, current_path, view.selected);
 
             }
 
@@ -891,15 +1570,63 @@ int main(void) {
                     break;
                 }
 
-                free_ls_entries(entries, num_entries);
-                num_entries = load_ls_entries(current_path, &entries);
+                listing_open_cached(&listing, current_path, view.selected);
             }
 
             snprintf(last_action, LAST_ACTION_SIZE, "Moved to %s", new_path);
         }
+
+        else if (ch == KEY_DU) {
+
+            if (du_start(current_path) == 0) {
+                snprintf(last_action, LAST_ACTION_SIZE, "Adding up disk usage of %s", current_path);
+            } else {
+                snprintf(last_action, LAST_ACTION_SIZE, "Can't scan %s", current_path);
+            }
+        }
+
+        else if (ch == KEY_FIND_TREE || ch == KEY_GREP || ch == KEY_GREP_REGEX) {
+
+            find_mode mode = ch == KEY_FIND_TREE ? find_names : ch == KEY_GREP ? find_literal : find_regex;
+            char pattern[256] = {0};
+
+            prompt_input(mode == find_names ? "Find below this directory: " : mode == find_literal ? "Find lines containing: " : "Find lines matching the regex: ",
+                         pattern, sizeof(pattern));
+
+            if (strlen(pattern) > 0) {
+
+                /* results are paths below current_path, they open from here like its own entries */
+                if (listing_open_find(&listing, current_path, pattern, mode, 0) == 0) {
+
+                    viewport_init(&view, view.rows);
+                    snprintf(last_action, LAST_ACTION_SIZE, "Finding '%.50s' below %s", pattern, current_path);
+
+                } else {
+
+                    snprintf(last_action, LAST_ACTION_SIZE, mode == find_regex ? "Can't search %s for that regex" : "Can't search %s", current_path);
+                }
+            }
+        }
+
+        else if (ch == KEY_STOP_FIND) {
+
+            listing_stop(&listing);
+        }
+
+        else if (ch == KEY_SORT) {
+
+            /* the cursor stays on its entry, the page follows it */
+            listing_set_sort(&listing, (listing.sort + 1) % sort_key_count, &view.selected);
+            viewport_clamp(&view, listing.table.count, listing.loading);
+        }
     }
 
-    free_ls_entries(entries, num_entries);
+    du_stop();
+    fuzzy_free(&search);
+    hits_free(&hits);
+    preview_stop();
+    listing_close(&listing);
+    ansi_close(&ansi);
     endwin();
     return 0;
 }
@@ -0,0 +1,657 @@
+/* Copyright 2025 Henryk Szenkowicz Holtman
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files(the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in all copies
+    or
+    substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED “AS IS”,
+    WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "native.h"
+#include "config.h"
+#include "uring.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <grp.h>
+#include <pthread.h>
+#include <pwd.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#define NAME_CACHE_SIZE 64
+#define SIX_MONTHS (31556952 / 2)
+#define URING_MIN_ENTRIES 32
+
+typedef struct name_cache_slot {
+    unsigned int id;
+    int used;
+    char name[32];
+} name_cache_slot;
+
+static name_cache_slot user_cache[NAME_CACHE_SIZE];
+static name_cache_slot group_cache[NAME_CACHE_SIZE];
+
+/* getpwuid()/getgrgid() are not reentrant and the background loader renders entries too */
+static pthread_mutex_t name_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static const char *cached_name(name_cache_slot *cache, unsigned int id, int is_group) {
+
+    name_cache_slot *slot = &cache[id % NAME_CACHE_SIZE];
+
+    pthread_mutex_lock(&name_cache_lock);
+
+    if (slot->used && slot->id == id) {
+
+        pthread_mutex_unlock(&name_cache_lock);
+        return slot->name;
+    }
+
+    const char *name = NULL;
+
+    if (is_group) {
+
+        struct group *gr = getgrgid(id);
+        name = gr ? gr->gr_name : NULL;
+
+    } else {
+
+        struct passwd *pw = getpwuid(id);
+        name = pw ? pw->pw_name : NULL;
+    }
+
+    if (name) {
+        snprintf(slot->name, sizeof(slot->name), "%s", name);
+    } else {
+        snprintf(slot->name, sizeof(slot->name), "%u", id);
+    }
+
+    slot->id = id;
+    slot->used = 1;
+    pthread_mutex_unlock(&name_cache_lock);
+    return slot->name;
+}
+
+static void format_mode(mode_t mode, char out[11]) {
+
+    if (S_ISDIR(mode)) {
+        out[0] = 'd';
+    } else if (S_ISLNK(mode)) {
+        out[0] = 'l';
+    } else if (S_ISFIFO(mode)) {
+        out[0] = 'p';
+    } else if (S_ISSOCK(mode)) {
+        out[0] = 's';
+    } else if (S_ISCHR(mode)) {
+        out[0] = 'c';
+    } else if (S_ISBLK(mode)) {
+        out[0] = 'b';
+    } else {
+        out[0] = '-';
+    }
+
+    out[1] = (mode & S_IRUSR) ? 'r' : '-';
+    out[2] = (mode & S_IWUSR) ? 'w' : '-';
+    out[3] = (mode & S_ISUID) ? ((mode & S_IXUSR) ? 's' : 'S') : ((mode & S_IXUSR) ? 'x' : '-');
+    out[4] = (mode & S_IRGRP) ? 'r' : '-';
+    out[5] = (mode & S_IWGRP) ? 'w' : '-';
+    out[6] = (mode & S_ISGID) ? ((mode & S_IXGRP) ? 's' : 'S') : ((mode & S_IXGRP) ? 'x' : '-');
+    out[7] = (mode & S_IROTH) ? 'r' : '-';
+    out[8] = (mode & S_IWOTH) ? 'w' : '-';
+    out[9] = (mode & S_ISVTX) ? ((mode & S_IXOTH) ? 't' : 'T') : ((mode & S_IXOTH) ? 'x' : '-');
+    out[10] = '\0';
+}
+
+static double ceil_positive(double v) {
+
+    double whole = (double)(long long)v;
+    return whole < v ? whole + 1.0 : whole;
+}
+
+static int digits(unsigned long long n) {
+
+    int d = 1;
+    while (n >= 10) {
+        n /= 10;
+        d++;
+    }
+    return d;
+}
+
+static const char size_units[] = "KMGTPE";
+
+/* same rounding as `ls -h`: powers of 1024, always rounded up, one decimal below 10.
+ * returns the index into size_units, -1 for sizes shown in plain bytes */
+static int human_size(long long size, double *value, int *decimal) {
+
+    *value = (double)size;
+    *decimal = 0;
+
+    if (size < 1024) {
+        return -1;
+    }
+
+    int unit = -1;
+
+    do {
+        *value /= 1024.0;
+        unit++;
+    } while (*value >= 1024.0 && size_units[unit + 1]);
+
+    if (*value < 10.0) {
+
+        double tenths = ceil_positive(*value * 10.0) / 10.0;
+
+        if (tenths < 10.0) {
+
+            *value = tenths;
+            *decimal = 1;
+            return unit;
+        }
+
+        *value = tenths;
+    }
+
+    *value = ceil_positive(*value);
+
+    if (*value >= 1024.0 && size_units[unit + 1]) {
+
+        *value = 1.0;
+        *decimal = 1;
+        return unit + 1;
+    }
+
+    return unit;
+}
+
+void format_size_human(long long size, char *out, size_t out_size) {
+
+    double value;
+    int decimal;
+    int unit = human_size(size, &value, &decimal);
+
+    if (unit < 0) {
+
+        snprintf(out, out_size, "%lld", size);
+        return;
+    }
+
+    snprintf(out, out_size, "%.*f%c", decimal, value, size_units[unit]);
+}
+
+/* strlen() of what format_size_human() prints, without printing it */
+static int human_size_width(long long size) {
+
+    double value;
+    int decimal;
+    int unit = human_size(size, &value, &decimal);
+
+    if (unit < 0) {
+        return digits(size);
+    }
+
+    return decimal ? 4 : digits((unsigned long long)value) + 1;
+}
+
+/* size is st_rdev for devices, like the size column of ls_table */
+static void format_size(mode_t mode, long long size, int major_w, int minor_w, char *out, size_t out_size) {
+
+    if (S_ISCHR(mode) || S_ISBLK(mode)) {
+
+        snprintf(out, out_size, "%*u, %*u", major_w, major((dev_t)size), minor_w, minor((dev_t)size));
+        return;
+    }
+
+    format_size_human(size, out, out_size);
+}
+
+static long long size_column(const struct stat *st) {
+
+    return S_ISCHR(st->st_mode) || S_ISBLK(st->st_mode) ? (long long)st->st_rdev : (long long)st->st_size;
+}
+
+static void format_time(time_t t, time_t now, char *out, size_t out_size) {
+
+    struct tm tm;
+    localtime_r(&t, &tm);
+
+    if (t > now - SIX_MONTHS && t <= now) {
+
+        strftime(out, out_size, "%b %e %H:%M", &tm);
+
+    } else {
+
+        strftime(out, out_size, "%b %e  %Y", &tm);
+    }
+}
+
+static char indicator(mode_t mode) {
+
+    if (S_ISDIR(mode)) {
+        return '/';
+    } else if (S_ISLNK(mode)) {
+        return '@';
+    } else if (S_ISFIFO(mode)) {
+        return '|';
+    } else if (S_ISSOCK(mode)) {
+        return '=';
+    } else if (S_ISREG(mode) && (mode & (S_IXUSR | S_IXGRP | S_IXOTH))) {
+        return '*';
+    }
+
+    return '\0';
+}
+
+static file_type classify(mode_t mode) {
+
+    if (S_ISDIR(mode)) {
+        return file_dir;
+    } else if (S_ISLNK(mode)) {
+        return file_link;
+    } else if (S_ISREG(mode) && (mode & (S_IXUSR | S_IXGRP | S_IXOTH))) {
+        return file_exec;
+    }
+
+    return file_reg;
+}
+
+static int compare_native_entries(const void *a, const void *b) {
+
+    const native_entry *ea = a;
+    const native_entry *eb = b;
+    return strcoll(ea->name, eb->name);
+}
+
+/* formats the same columns `ls -F -l -h -a` would, so the prefix/fname split stays identical */
+int format_native_prefix(const ls_table *t, int row, char *buf, size_t size) {
+
+    char perm[11], size_str[32], date[32];
+
+    format_mode(t->mode[row], perm);
+    format_size(t->mode[row], t->size[row], t->widths[4], t->widths[5], size_str, sizeof(size_str));
+    format_time(t->mtime[row], t->now, date, sizeof(date));
+
+    return snprintf(buf, size, "%s %*u %-*s %-*s %*s %s ",
+                    perm, t->widths[0], t->nlink[row],
+                    t->widths[1], cached_name(user_cache, t->uid[row], 0),
+                    t->widths[2], cached_name(group_cache, t->gid[row], 1),
+                    t->widths[3], size_str, date);
+}
+
+int store_native_entry(ls_table *t, int row, const native_entry *ne, arena *a) {
+
+    char mark = S_ISLNK(ne->st.st_mode) ? '\0' : indicator(ne->st.st_mode);
+    char target_mark = ne->target_ok ? indicator(ne->target_mode) : '\0';
+
+    size_t name_len = strlen(ne->name);
+    size_t fname_size = name_len + 2;
+
+    if (ne->link_target) {
+        fname_size += strlen(ne->link_target) + 5;
+    }
+
+    char *fname = arena_alloc(a, fname_size);
+    if (!fname) {
+        return -1;
+    }
+
+    if (ne->link_target) {
+
+        snprintf(fname, fname_size, "%s -> %s%.*s", ne->name, ne->link_target, target_mark ? 1 : 0, &target_mark);
+
+    } else {
+
+        snprintf(fname, fname_size, "%s%.*s", ne->name, mark ? 1 : 0, &mark);
+    }
+
+    t->fname[row] = fname;
+    t->name_len[row] = name_len;
+    t->type[row] = classify(ne->st.st_mode);
+    t->mode[row] = ne->st.st_mode;
+    t->nlink[row] = ne->st.st_nlink;
+    t->uid[row] = ne->st.st_uid;
+    t->gid[row] = ne->st.st_gid;
+    t->size[row] = size_column(&ne->st);
+    t->mtime[row] = ne->st.st_mtime;
+    return 0;
+}
+
+void free_native_entries(native_entry *raw, int count) {
+
+    for (int i = 0; i < count; i++) {
+
+        free(raw[i].name);
+        free(raw[i].link_target);
+    }
+
+    free(raw);
+}
+
+static void statx_to_stat(const struct statx *stx, struct stat *st) {
+
+    memset(st, 0, sizeof(*st));
+    st->st_mode = stx->stx_mode;
+    st->st_nlink = stx->stx_nlink;
+    st->st_uid = stx->stx_uid;
+    st->st_gid = stx->stx_gid;
+    st->st_size = stx->stx_size;
+    st->st_ino = stx->stx_ino;
+    st->st_blocks = stx->stx_blocks;
+    st->st_dev = makedev(stx->stx_dev_major, stx->stx_dev_minor);
+    st->st_rdev = makedev(stx->stx_rdev_major, stx->stx_rdev_minor);
+    st->st_mtim.tv_sec = stx->stx_mtime.tv_sec;
+    st->st_mtim.tv_nsec = stx->stx_mtime.tv_nsec;
+    st->st_ctim.tv_sec = stx->stx_ctime.tv_sec;
+    st->st_ctim.tv_nsec = stx->stx_ctime.tv_nsec;
+}
+
+typedef struct stat_pass {
+    native_entry *raw;
+    int *links; /* indices of the symlinks when stating their targets, NULL for the lstat pass */
+} stat_pass;
+
+static const char *stat_pass_name(void *ctx, int index) {
+
+    stat_pass *pass = ctx;
+    return pass->raw[pass->links ? pass->links[index] : index].name;
+}
+
+static void stat_pass_done(void *ctx, int index, int res, const struct statx *stx) {
+
+    stat_pass *pass = ctx;
+
+    if (res != 0) {
+        return;
+    }
+
+    if (pass->links) {
+
+        native_entry *ne = &pass->raw[pass->links[index]];
+        ne->target_mode = stx->stx_mode;
+        ne->target_ok = 1;
+
+    } else {
+
+        native_entry *ne = &pass->raw[index];
+        statx_to_stat(stx, &ne->st);
+        ne->stat_ok = 1;
+    }
+}
+
+/* fills st for every entry (and the target mode of symlinks), through io_uring when it is
+ * available and a plain fstatat loop otherwise. -1 with errno ENOMEM when the targets were skipped */
+int stat_native_entries(int dfd, native_entry *raw, int count) {
+
+    stat_pass pass = {raw, NULL};
+
+    /* setting up a ring is not worth it for a handful of names */
+    int done = USE_IO_URING && count >= URING_MIN_ENTRIES && uring_statx_all(dfd, count, IO_URING_BATCH, AT_SYMLINK_NOFOLLOW, stat_pass_name, stat_pass_done, &pass) == 0;
+
+    if (!done) {
+
+        for (int i = 0; i < count; i++) {
+
+            if (fstatat(dfd, raw[i].name, &raw[i].st, AT_SYMLINK_NOFOLLOW) == 0) {
+                raw[i].stat_ok = 1;
+            }
+        }
+    }
+
+    int link_count = 0;
+    int *links = NULL;
+
+    for (int i = 0; i < count; i++) {
+
+        if (!raw[i].stat_ok || !S_ISLNK(raw[i].st.st_mode)) {
+            continue;
+        }
+
+        char target[MAX_LINE];
+        ssize_t len = readlinkat(dfd, raw[i].name, target, sizeof(target) - 1);
+
+        if (len >= 0) {
+
+            target[len] = '\0';
+            raw[i].link_target = strdup(target);
+        }
+
+        int *grown = realloc(links, (link_count + 1) * sizeof(int));
+        if (!grown) {
+
+            free(links);
+            errno = ENOMEM;
+            return -1;
+        }
+
+        links = grown;
+        links[link_count++] = i;
+    }
+
+    if (link_count == 0) {
+        return 0;
+    }
+
+    pass.links = links;
+
+    done = USE_IO_URING && link_count >= URING_MIN_ENTRIES && uring_statx_all(dfd, link_count, IO_URING_BATCH, 0, stat_pass_name, stat_pass_done, &pass) == 0;
+
+    if (!done) {
+
+        for (int i = 0; i < link_count; i++) {
+
+            struct stat tst;
+            if (fstatat(dfd, raw[links[i]].name, &tst, 0) == 0) {
+
+                raw[links[i]].target_mode = tst.st_mode;
+                raw[links[i]].target_ok = 1;
+            }
+        }
+    }
+
+    free(links);
+    return 0;
+}
+
+int read_native_chunk(int dfd, char *buf, native_entry **raw, int *count, int *capacity) {
+
+    long nread = syscall(SYS_getdents64, dfd, buf, GETDENTS_BUF_SIZE);
+    if (nread < 0) {
+        return -1;
+    }
+
+    if (nread == 0) {
+        return 0;
+    }
+
+    int first = *count;
+
+    for (long pos = 0; pos < nread;) {
+
+        struct linux_dirent64 *d = (struct linux_dirent64 *)(buf + pos);
+        pos += d->d_reclen;
+
+        if (*count >= *capacity) {
+
+            native_entry *grown = realloc(*raw, *capacity * 2 * sizeof(native_entry));
+            if (!grown) {
+                return -1;
+            }
+
+            *raw = grown;
+            *capacity *= 2;
+        }
+
+        native_entry ne = {0};
+        ne.name = strdup(d->d_name);
+
+        if (!ne.name) {
+            return -1;
+        }
+
+        (*raw)[(*count)++] = ne;
+    }
+
+    native_entry *chunk = *raw + first;
+    int added = *count - first;
+
+    int stat_error = stat_native_entries(dfd, chunk, added) != 0 ? errno : 0;
+
+    /* entries that vanished between getdents64 and the stat are dropped, like ls does */
+    int kept = 0;
+
+    for (int i = 0; i < added; i++) {
+
+        if (chunk[i].stat_ok) {
+
+            chunk[kept++] = chunk[i];
+
+        } else {
+
+            free(chunk[i].name);
+            free(chunk[i].link_target);
+        }
+    }
+
+    *count = first + kept;
+
+    if (stat_error) {
+
+        errno = stat_error;
+        return -1;
+    }
+
+    return added;
+}
+
+/* ls pads every column to its widest value, so measure before rendering.
+ * widths: links, owner, group, size, device major, device minor. Only ever grows them. */
+void measure_widths(const native_entry *raw, int count, int widths[6]) {
+
+    for (int i = 0; i < count; i++) {
+
+        if (S_ISCHR(raw[i].st.st_mode) || S_ISBLK(raw[i].st.st_mode)) {
+
+            int w;
+            if ((w = digits(major(raw[i].st.st_rdev))) > widths[4]) {
+                widths[4] = w;
+            }
+            if ((w = digits(minor(raw[i].st.st_rdev))) > widths[5]) {
+                widths[5] = w;
+            }
+        }
+    }
+
+    /* nothing is formatted here, rows are only printed once they are drawn */
+    uid_t last_uid = (uid_t)-1;
+    gid_t last_gid = (gid_t)-1;
+
+    for (int i = 0; i < count; i++) {
+
+        const struct stat *st = &raw[i].st;
+        int w;
+
+        if ((w = digits(st->st_nlink)) > widths[0]) {
+            widths[0] = w;
+        }
+
+        /* most directories belong to one or two owners, skip the name cache lock for repeats */
+        if (st->st_uid != last_uid) {
+
+            if ((w = strlen(cached_name(user_cache, st->st_uid, 0))) > widths[1]) {
+                widths[1] = w;
+            }
+            last_uid = st->st_uid;
+        }
+
+        if (st->st_gid != last_gid) {
+
+            if ((w = strlen(cached_name(group_cache, st->st_gid, 1))) > widths[2]) {
+                widths[2] = w;
+            }
+            last_gid = st->st_gid;
+        }
+
+        if (S_ISCHR(st->st_mode) || S_ISBLK(st->st_mode)) {
+            w = widths[4] + 2 + widths[5];
+        } else {
+            w = human_size_width(st->st_size);
+        }
+
+        if (w > widths[3]) {
+            widths[3] = w;
+        }
+    }
+}
+
+int load_ls_entries_native(const char *path, ls_table *t) {
+
+    table_init(t, 1);
+
+    int dfd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dfd < 0) {
+        return -1;
+    }
+
+    char *buf = malloc(GETDENTS_BUF_SIZE);
+    int capacity = 64, count = 0;
+    native_entry *raw = malloc(capacity * sizeof(native_entry));
+
+    if (!buf || !raw) {
+
+        free(buf);
+        free(raw);
+        close(dfd);
+        return -1;
+    }
+
+    int read;
+
+    while ((read = read_native_chunk(dfd, buf, &raw, &count, &capacity)) > 0) {
+    }
+
+    free(buf);
+    close(dfd);
+
+    if (read < 0) {
+
+        free_native_entries(raw, count);
+        return -1;
+    }
+
+    qsort(raw, count, sizeof(native_entry), compare_native_entries);
+    measure_widths(raw, count, t->widths);
+
+    if (table_insert_rows(t, 0, count) != 0) {
+
+        free_native_entries(raw, count);
+        return -1;
+    }
+
+    for (int i = 0; i < count; i++) {
+
+        if (store_native_entry(t, i, &raw[i], &t->arena) != 0) {
+
+            free_native_entries(raw, count);
+            return -1;
+        }
+    }
+
+    free_native_entries(raw, count);
+    return count;
+}
+
+int compare_native_entry_ptrs(const void *a, const void *b) {
+
+    const native_entry *ea = *(native_entry *const *)a;
+    const native_entry *eb = *(native_entry *const *)b;
+    return strcoll(ea->name, eb->name);
+}
@@ -0,0 +1,55 @@
+#ifndef NATIVE_H
+#define NATIVE_H
+
+#include "listing.h"
+#include <stdint.h>
+#include <sys/stat.h>
+
+/* the directory reading and `ls -l` style rendering behind USE_NATIVE_LISTING */
+
+#define GETDENTS_BUF_SIZE (64 * 1024)
+
+/* glibc only exposes getdents64() on recent versions, so declare the record ourselves */
+struct linux_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+typedef struct native_entry {
+    char *name;
+    char *link_target;
+    struct stat st;
+    mode_t target_mode;
+    int target_ok;
+    int stat_ok;
+} native_entry;
+
+/* reads one getdents64 buffer worth of names onto the end of raw and stats them.
+ * returns how many names were read, 0 at the end of the directory and -1 with errno set on errors */
+int read_native_chunk(int dfd, char *buf, native_entry **raw, int *count, int *capacity);
+
+/* fills st (and the target of symlinks) for count entries, stat_ok tells which ones exist.
+ * returns -1 with errno ENOMEM when the symlink targets could not be looked up */
+int stat_native_entries(int dfd, native_entry *raw, int count);
+
+/* grows widths (links, owner, group, size, device major, device minor) to fit every entry */
+void measure_widths(const native_entry *raw, int count, int widths[6]);
+
+/* fills row `row` of a native table, the name goes into `a`. returns -1 if memory runs out */
+int store_native_entry(ls_table *t, int row, const native_entry *ne, arena *a);
+
+/* writes the columns in front of the name of a native row with the table's widths, returns the length */
+int format_native_prefix(const ls_table *t, int row, char *buf, size_t size);
+
+/* prints size the way ls -h does */
+void format_size_human(long long size, char *out, size_t out_size);
+
+void free_native_entries(native_entry *raw, int count);
+
+/* qsort() comparator over native_entry pointers, same order as the listing */
+int compare_native_entry_ptrs(const void *a, const void *b);
+
+#endif
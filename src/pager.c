@@ -0,0 +1,496 @@
+/* Copyright 2025 Henryk Szenkowicz Holtman
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files(the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in all copies
+    or
+    substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED “AS IS”,
+    WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "pager.h"
+#include "config.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* bytes indexed between two looks at whether to stop, also how far ahead the next ones are asked for */
+#define PAGER_CHUNK (8 * 1024 * 1024)
+
+/* line offsets are allocated this many at a time and never move, the thread appends to the last
+ * block while the main thread reads the ones before */
+#define PAGER_BLOCK 65536
+
+struct pager {
+    int fd;
+    const char *map;
+    long long size;
+
+    pthread_t thread;
+    int has_thread;
+    struct timespec started;
+
+    /* offsets of lines 0, PAGER_INDEX_STRIDE, 2 * PAGER_INDEX_STRIDE... written by the thread only,
+     * an entry is not touched again once the counts below include it */
+    long long **blocks;
+    long long slots;
+    long long allocated;
+
+    long long checkpoints; /* atomic, published before newlines */
+    long long newlines;    /* atomic, published before scanned */
+    long long scanned;     /* atomic */
+    long long elapsed_ms;  /* atomic, when the index was finished */
+    int done;              /* atomic */
+    int stop;              /* atomic */
+    int truncated;         /* atomic, set by on_sigbus() */
+
+    pager *next; /* in the list on_sigbus() looks through */
+};
+
+/* a file cut short while it is mapped (a log rotated in place) raises SIGBUS on the pages past its new
+ * end. the handler puts zero pages in their place and marks the pager truncated, the access is retried
+ * and reads zeros instead of the signal ending the file manager. the list is changed by the main
+ * thread only, and a pager leaves it once its thread was joined */
+static pager *mapped;
+static struct sigaction previous_sigbus;
+static long page_size;
+
+static void on_sigbus(int sig, siginfo_t *info, void *context) {
+
+    const char *at = info->si_addr;
+
+    for (pager *p = __atomic_load_n(&mapped, __ATOMIC_ACQUIRE); p && info->si_code > 0; p = p->next) {
+
+        if (at < p->map || at >= p->map + p->size) {
+            continue;
+        }
+
+        char *from = (char *)p->map + (at - p->map) / page_size * page_size;
+
+        if (mmap(from, p->map + p->size - from, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) != MAP_FAILED) {
+
+            __atomic_store_n(&p->truncated, 1, __ATOMIC_RELAXED);
+            return;
+        }
+    }
+
+    /* not one of ours, whoever handled it before does. by default a fault repeats once this returns
+     * and ends the program as it would have, a signal that was sent is raised again */
+    if (previous_sigbus.sa_flags & SA_SIGINFO) {
+
+        previous_sigbus.sa_sigaction(sig, info, context);
+
+    } else if (previous_sigbus.sa_handler != SIG_DFL && previous_sigbus.sa_handler != SIG_IGN) {
+
+        previous_sigbus.sa_handler(sig);
+
+    } else if (previous_sigbus.sa_handler == SIG_DFL) {
+
+        signal(SIGBUS, SIG_DFL);
+        if (info->si_code <= 0) {
+            raise(sig);
+        }
+    }
+}
+
+static void watch_sigbus(pager *p) {
+
+    static int installed;
+
+    if (!installed) {
+
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_sigaction = on_sigbus;
+        sa.sa_flags = SA_SIGINFO;
+        sigemptyset(&sa.sa_mask);
+
+        page_size = sysconf(_SC_PAGESIZE);
+        installed = sigaction(SIGBUS, &sa, &previous_sigbus) == 0;
+    }
+
+    p->next = mapped;
+    __atomic_store_n(&mapped, p, __ATOMIC_RELEASE);
+}
+
+static void unwatch_sigbus(pager *p) {
+
+    for (pager **link = &mapped; *link; link = &(*link)->next) {
+
+        if (*link == p) {
+
+            __atomic_store_n(link, p->next, __ATOMIC_RELEASE);
+            return;
+        }
+    }
+}
+
+static long long pager_elapsed_ms(const pager *p) {
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - p->started.tv_sec) * 1000LL + (now.tv_nsec - p->started.tv_nsec) / 1000000;
+}
+
+static long long checkpoint(const pager *p, long long k) {
+    return p->blocks[k / PAGER_BLOCK][k % PAGER_BLOCK];
+}
+
+static int add_checkpoint(pager *p, long long *count, long long offset) {
+
+    long long k = *count;
+
+    if (k >= p->allocated) {
+
+        if (k / PAGER_BLOCK >= p->slots) {
+            return -1;
+        }
+
+        p->blocks[k / PAGER_BLOCK] = malloc(PAGER_BLOCK * sizeof(long long));
+        if (!p->blocks[k / PAGER_BLOCK]) {
+            return -1;
+        }
+
+        p->allocated += PAGER_BLOCK;
+    }
+
+    p->blocks[k / PAGER_BLOCK][k % PAGER_BLOCK] = offset;
+    *count = k + 1;
+    return 0;
+}
+
+/* counts the newlines in s[0, len), which starts at `base` in the file, and records the offset after
+ * every PAGER_INDEX_STRIDE-th one */
+static int index_chunk(pager *p, const char *s, long long base, long long len, long long *newlines, long long *count) {
+
+    long long lines = *newlines;
+    long long i = 0;
+
+#ifdef __SSE2__
+    /* 64 bytes give one 64 bit mask, which is only taken apart bit by bit when the stride ends in it */
+    const __m128i newline = _mm_set1_epi8('\n');
+
+    for (; i + 64 <= len; i += 64) {
+
+        const __m128i *v = (const __m128i *)(s + i);
+        uint64_t mask = (uint64_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(v), newline)) |
+                        (uint64_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(v + 1), newline)) << 16 |
+                        (uint64_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(v + 2), newline)) << 32 |
+                        (uint64_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(v + 3), newline)) << 48;
+
+        if (!mask) {
+            continue;
+        }
+
+        int n = __builtin_popcountll(mask);
+
+        if (lines % PAGER_INDEX_STRIDE + n < PAGER_INDEX_STRIDE) {
+
+            lines += n;
+            continue;
+        }
+
+        while (mask) {
+
+            int bit = __builtin_ctzll(mask);
+            mask &= mask - 1;
+
+            if (++lines % PAGER_INDEX_STRIDE == 0 && add_checkpoint(p, count, base + i + bit + 1) != 0) {
+                return -1;
+            }
+        }
+    }
+#endif
+
+    for (; i < len; i++) {
+
+        if (s[i] == '\n' && ++lines % PAGER_INDEX_STRIDE == 0 && add_checkpoint(p, count, base + i + 1) != 0) {
+            return -1;
+        }
+    }
+
+    *newlines = lines;
+    return 0;
+}
+
+static void *index_thread(void *arg) {
+
+    pager *p = arg;
+    long long newlines = 0, count = 1;
+
+    /* past a truncation there are only the zero pages on_sigbus() put in */
+    for (long long base = 0; base < p->size && !__atomic_load_n(&p->stop, __ATOMIC_RELAXED) &&
+                             !__atomic_load_n(&p->truncated, __ATOMIC_RELAXED);
+         base += PAGER_CHUNK) {
+
+        long long len = p->size - base < PAGER_CHUNK ? p->size - base : PAGER_CHUNK;
+
+        /* the next chunk comes in from the disk while this one is counted */
+        if (base + len < p->size) {
+            madvise((void *)(p->map + base + len), p->size - base - len < PAGER_CHUNK ? p->size - base - len : PAGER_CHUNK, MADV_WILLNEED);
+        }
+
+        if (index_chunk(p, p->map + base, base, len, &newlines, &count) != 0) {
+            break;
+        }
+
+        __atomic_store_n(&p->checkpoints, count, __ATOMIC_RELEASE);
+        __atomic_store_n(&p->newlines, newlines, __ATOMIC_RELEASE);
+        __atomic_store_n(&p->scanned, base + len, __ATOMIC_RELEASE);
+
+        /* counted pages are let go of, the ones on screen are read in again from the page cache */
+        madvise((void *)(p->map + base), len, MADV_DONTNEED);
+    }
+
+    __atomic_store_n(&p->elapsed_ms, pager_elapsed_ms(p), __ATOMIC_RELAXED);
+    __atomic_store_n(&p->done, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+pager *pager_open(const char *path) {
+
+    pager *p = calloc(1, sizeof(pager));
+    if (!p) {
+        return NULL;
+    }
+
+    struct stat st;
+    p->fd = open(path, O_RDONLY | O_CLOEXEC);
+
+    if (p->fd < 0 || fstat(p->fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+
+        pager_close(p);
+        return NULL;
+    }
+
+    p->size = st.st_size;
+    p->map = "";
+    clock_gettime(CLOCK_MONOTONIC, &p->started);
+
+    if (p->size == 0) {
+
+        p->done = 1;
+        return p;
+    }
+
+    void *map = mmap(NULL, p->size, PROT_READ, MAP_PRIVATE, p->fd, 0);
+
+    /* every line could be empty, that many checkpoints at most */
+    p->slots = (p->size / PAGER_INDEX_STRIDE + 2) / PAGER_BLOCK + 1;
+    p->blocks = calloc(p->slots, sizeof(long long *));
+
+    if (map == MAP_FAILED || !p->blocks) {
+
+        if (map != MAP_FAILED) {
+            munmap(map, p->size);
+        }
+
+        p->size = 0;
+        pager_close(p);
+        return NULL;
+    }
+
+    p->map = map;
+
+    /* line 0 starts the file */
+    long long count = 0;
+
+    if (add_checkpoint(p, &count, 0) != 0) {
+
+        pager_close(p);
+        return NULL;
+    }
+
+    p->checkpoints = count;
+    watch_sigbus(p);
+
+    if (pthread_create(&p->thread, NULL, index_thread, p) == 0) {
+        p->has_thread = 1;
+    } else {
+        p->done = 1;
+    }
+
+    return p;
+}
+
+const char *pager_text(const pager *p, long long *size) {
+
+    *size = p->size;
+    return p->map;
+}
+
+long long pager_next_line(const pager *p, long long offset) {
+
+    const char *nl = memchr(p->map + offset, '\n', p->size - offset);
+
+    if (!nl || nl + 1 == p->map + p->size) {
+        return -1;
+    }
+
+    return nl + 1 - p->map;
+}
+
+long long pager_line_start(const pager *p, long long offset) {
+
+    while (offset > 0 && p->map[offset - 1] != '\n') {
+        offset--;
+    }
+
+    return offset;
+}
+
+long long pager_prev_line(const pager *p, long long offset) {
+
+    if (offset <= 0) {
+        return -1;
+    }
+
+    return pager_line_start(p, offset - 1);
+}
+
+long long pager_line_offset(pager *p, long long line) {
+
+    if (p->size == 0) {
+        return line == 0 ? 0 : -1;
+    }
+
+    /* scanned first: once it covers the file, newlines is the final count */
+    long long scanned = __atomic_load_n(&p->scanned, __ATOMIC_ACQUIRE);
+    long long newlines = __atomic_load_n(&p->newlines, __ATOMIC_ACQUIRE);
+
+    /* the '\n' ending the file does not start a line */
+    if (line < 0 || line > newlines || (line == newlines && scanned == p->size && p->map[p->size - 1] == '\n')) {
+        return -1;
+    }
+
+    /* at most PAGER_INDEX_STRIDE - 1 lines to skip from the checkpoint */
+    long long offset = checkpoint(p, line / PAGER_INDEX_STRIDE);
+
+    for (long long skip = line % PAGER_INDEX_STRIDE; skip > 0; skip--) {
+        offset = (const char *)memchr(p->map + offset, '\n', p->size - offset) - p->map + 1;
+    }
+
+    return offset;
+}
+
+long long pager_line_number(pager *p, long long offset) {
+
+    if (p->size == 0) {
+        return 0;
+    }
+
+    if (offset > __atomic_load_n(&p->scanned, __ATOMIC_ACQUIRE)) {
+        return -1;
+    }
+
+    /* the last checkpoint at or before offset */
+    long long lo = 0, hi = __atomic_load_n(&p->checkpoints, __ATOMIC_ACQUIRE) - 1;
+
+    while (lo < hi) {
+
+        long long mid = lo + (hi - lo + 1) / 2;
+
+        if (checkpoint(p, mid) <= offset) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+
+    long long line = lo * PAGER_INDEX_STRIDE;
+    const char *s = p->map + checkpoint(p, lo), *end = p->map + offset;
+
+    while ((s = memchr(s, '\n', end - s))) {
+
+        line++;
+        s++;
+    }
+
+    return line;
+}
+
+void pager_progress(pager *p, pager_stats *stats) {
+
+    stats->done = __atomic_load_n(&p->done, __ATOMIC_ACQUIRE);
+    stats->size = p->size;
+    stats->scanned = __atomic_load_n(&p->scanned, __ATOMIC_ACQUIRE);
+    stats->lines = __atomic_load_n(&p->newlines, __ATOMIC_ACQUIRE);
+    stats->truncated = __atomic_load_n(&p->truncated, __ATOMIC_RELAXED);
+
+    long long blocks = (__atomic_load_n(&p->checkpoints, __ATOMIC_ACQUIRE) + PAGER_BLOCK - 1) / PAGER_BLOCK;
+    stats->index_bytes = (blocks * PAGER_BLOCK + p->slots) * (long long)sizeof(long long);
+
+    /* a last line without '\n' only counts once it is known to be the last */
+    if (stats->done && stats->scanned == p->size && p->size > 0 && p->map[p->size - 1] != '\n') {
+        stats->lines++;
+    }
+
+    long long ms = stats->done ? __atomic_load_n(&p->elapsed_ms, __ATOMIC_RELAXED) : pager_elapsed_ms(p);
+    stats->bytes_per_second = ms > 0 ? stats->scanned * 1000 / ms : 0;
+}
+
+int pager_wants(const char *path) {
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return 0;
+    }
+
+    struct stat st;
+    char head[4096];
+    ssize_t n = 0;
+
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || (n = read(fd, head, sizeof(head))) < 0) {
+
+        close(fd);
+        return 0;
+    }
+
+    close(fd);
+    return memchr(head, '\0', n) == NULL;
+}
+
+void pager_close(pager *p) {
+
+    if (!p) {
+        return;
+    }
+
+    if (p->has_thread) {
+
+        __atomic_store_n(&p->stop, 1, __ATOMIC_RELAXED);
+        pthread_join(p->thread, NULL);
+    }
+
+    unwatch_sigbus(p);
+
+    if (p->size > 0) {
+        munmap((void *)p->map, p->size);
+    }
+
+    for (long long i = 0; i < p->slots && p->blocks[i]; i++) {
+        free(p->blocks[i]);
+    }
+
+    free(p->blocks);
+
+    if (p->fd >= 0) {
+        close(p->fd);
+    }
+
+    free(p);
+}
@@ -0,0 +1,52 @@
+#ifndef PAGER_H
+#define PAGER_H
+
+/* a file opened for reading in the built-in pager. the file is mapped rather than read, so the first
+ * screen shows at once whatever its size and moving a line or a page from there only looks at the
+ * bytes around it. a background thread counts the lines and keeps the offset of every
+ * PAGER_INDEX_STRIDE-th one, which is what jumping to a line number or finding the number of the
+ * line at an offset goes through. the index is all that is kept in memory: the pages it scanned are
+ * let go of as it moves on, the kernel reads them in again when they are shown */
+
+typedef struct pager pager;
+
+typedef struct pager_stats {
+    long long size;             /* of the file */
+    long long scanned;          /* bytes the index covers so far */
+    long long lines;            /* lines counted in them, a last line without '\n' included once done */
+    long long index_bytes;      /* memory the line offsets take */
+    long long bytes_per_second; /* indexing speed since the start */
+    int done;
+    int truncated;              /* the file got shorter while open, what was cut off reads as zeros */
+} pager_stats;
+
+/* maps `path` and starts indexing it. returns NULL if it is not a regular file or can't be mapped */
+pager *pager_open(const char *path);
+
+/* the whole file, *size bytes of it */
+const char *pager_text(const pager *p, long long *size);
+
+/* offset of the line after the one holding `offset`, -1 if that is the last */
+long long pager_next_line(const pager *p, long long offset);
+
+/* offset of the start of the line before the one starting at `offset`, -1 at the top */
+long long pager_prev_line(const pager *p, long long offset);
+
+/* offset of the start of the line holding `offset` */
+long long pager_line_start(const pager *p, long long offset);
+
+/* offset of line `line` (counted from 0), -1 while the index did not get that far or past the end */
+long long pager_line_offset(pager *p, long long line);
+
+/* number of the line starting at `offset`, -1 while the index did not get that far */
+long long pager_line_number(pager *p, long long offset);
+
+void pager_progress(pager *p, pager_stats *stats);
+
+/* returns 1 if `path` is a regular file whose first few KB hold no NUL byte */
+int pager_wants(const char *path);
+
+/* stops the indexing thread and unmaps the file */
+void pager_close(pager *p);
+
+#endif
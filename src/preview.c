@@ -0,0 +1,426 @@
+/* Copyright 2025 Henryk Szenkowicz Holtman
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files(the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in all copies
+    or
+    substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED “AS IS”,
+    WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "preview.h"
+#include "config.h"
+#include "listing.h"
+#include "native.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* a read is checked for being replaced after every chunk */
+#define PREVIEW_CHUNK 4096
+#define PREVIEW_POLL_MS 20
+
+typedef struct preview_entry {
+    char *path;
+    long long size, mtime;
+    char *text;
+    int len;
+    unsigned long long used; /* 0 for a free slot */
+} preview_entry;
+
+/* the main thread's side: finished previews and the one the cursor wants */
+static preview_entry cache[PREVIEW_CACHE_ENTRIES];
+static unsigned long long cache_clock;
+static char *wanted;
+static int wanted_type;
+static long long wanted_size, wanted_mtime;
+static int current = -1; /* cache slot of the wanted preview, -1 while it is made */
+
+/* shared with the thread, under lock */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake = PTHREAD_COND_INITIALIZER;
+static pthread_t thread;
+static int thread_running, stopping;
+static preview_entry job; /* next file to read, path is NULL when there is none */
+static unsigned job_id;
+static preview_entry done;
+static preview_stats stats;
+
+/* bumped by every request, the thread gives up on a read once it moved past the read's own */
+static unsigned wanted_id;
+
+static void entry_free(preview_entry *e) {
+
+    free(e->path);
+    free(e->text);
+    memset(e, 0, sizeof(*e));
+}
+
+/* turns the head of a file into lines the screen can show as they are */
+static int clean_text(char *buf, int len) {
+
+    int out = 0;
+
+    for (int i = 0; i < len; i++) {
+
+        unsigned char ch = buf[i];
+
+        if (ch == '\r') {
+            continue;
+        }
+
+        if (ch == '\t') {
+            ch = ' ';
+        } else if ((ch < 0x20 && ch != '\n') || ch >= 0x7f) {
+            ch = '?';
+        }
+
+        buf[out++] = ch;
+    }
+
+    return out;
+}
+
+/* reads the head of path into e->text. returns 0 without a text if request id was replaced meanwhile */
+static int read_head(const char *path, unsigned id, preview_entry *e) {
+
+    char *buf = malloc(PREVIEW_BYTES + 128);
+
+    if (!buf) {
+        return 0;
+    }
+
+    int len = 0;
+    struct stat st;
+    int fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+
+    if (fd < 0) {
+
+        len = snprintf(buf, 128, "can't open: %s\n", strerror(errno));
+
+    } else if (fstat(fd, &st) != 0) {
+
+        len = snprintf(buf, 128, "can't stat: %s\n", strerror(errno));
+
+    } else if (!S_ISREG(st.st_mode)) {
+
+        len = snprintf(buf, 128, S_ISDIR(st.st_mode) ? "directory\n" : "not a regular file\n");
+
+    } else {
+
+        while (len < PREVIEW_BYTES) {
+
+            if (__atomic_load_n(&wanted_id, __ATOMIC_RELAXED) != id) {
+
+                close(fd);
+                free(buf);
+                return 0;
+            }
+
+            int want = PREVIEW_BYTES - len < PREVIEW_CHUNK ? PREVIEW_BYTES - len : PREVIEW_CHUNK;
+            ssize_t n = pread(fd, buf + len, want, len);
+
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+
+            if (n <= 0) {
+                break;
+            }
+
+            len += n;
+        }
+
+        if (len == 0) {
+
+            len = snprintf(buf, 128, "empty file\n");
+
+        } else if (memchr(buf, '\0', len)) {
+
+            char size[16];
+            format_size_human(st.st_size, size, sizeof(size));
+            len = snprintf(buf, 128, "binary file, %s\n", size);
+
+        } else {
+
+            len = clean_text(buf, len);
+        }
+    }
+
+    if (fd >= 0) {
+        close(fd);
+    }
+
+    e->text = buf;
+    e->len = len;
+    return 1;
+}
+
+static void *preview_thread(void *arg) {
+
+    (void)arg;
+    pthread_mutex_lock(&lock);
+
+    while (!stopping) {
+
+        if (!job.path) {
+
+            pthread_cond_wait(&wake, &lock);
+            continue;
+        }
+
+        preview_entry e = job;
+        unsigned id = job_id;
+        memset(&job, 0, sizeof(job));
+        pthread_mutex_unlock(&lock);
+
+        int finished = read_head(e.path, id, &e);
+
+        pthread_mutex_lock(&lock);
+
+        if (!finished) {
+
+            stats.cancelled++;
+            entry_free(&e);
+            continue;
+        }
+
+        /* kept even if the cursor moved on, it goes into the cache all the same */
+        stats.reads++;
+        entry_free(&done);
+        done = e;
+    }
+
+    pthread_mutex_unlock(&lock);
+    return NULL;
+}
+
+static int cache_find(const char *path, long long size, long long mtime) {
+
+    for (int i = 0; i < PREVIEW_CACHE_ENTRIES; i++) {
+
+        if (cache[i].used && cache[i].size == size && cache[i].mtime == mtime && strcmp(cache[i].path, path) == 0) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/* takes e over, in place of an older preview of the same path or of the one used longest ago */
+static int cache_store(preview_entry *e) {
+
+    int slot = 0;
+
+    for (int i = 0; i < PREVIEW_CACHE_ENTRIES; i++) {
+
+        if (cache[i].used && strcmp(cache[i].path, e->path) == 0) {
+
+            slot = i;
+            break;
+        }
+
+        if (cache[i].used < cache[slot].used) {
+            slot = i;
+        }
+    }
+
+    entry_free(&cache[slot]);
+    cache[slot] = *e;
+    cache[slot].used = ++cache_clock;
+    memset(e, 0, sizeof(*e));
+    return slot;
+}
+
+static int is_wanted(int slot) {
+
+    return wanted && cache[slot].size == wanted_size && cache[slot].mtime == wanted_mtime &&
+           strcmp(cache[slot].path, wanted) == 0;
+}
+
+/* a directory is previewed once the prefetch put its listing in the cache. returns 1 if it did */
+static int preview_directory(void) {
+
+    char *names = malloc(PREVIEW_BYTES);
+    size_t len;
+    int entries = names ? listing_peek(wanted, names, PREVIEW_BYTES, &len) : -1;
+
+    if (entries < 0 && listing_prefetch_pending(wanted)) {
+
+        free(names);
+        return 0;
+    }
+
+    preview_entry e = {0};
+    e.path = strdup(wanted);
+    e.size = wanted_size;
+    e.mtime = wanted_mtime;
+    e.text = malloc(PREVIEW_BYTES + 64);
+
+    if (!e.path || !e.text) {
+
+        entry_free(&e);
+        free(names);
+        return 0;
+    }
+
+    if (entries < 0) {
+
+        e.len = snprintf(e.text, 64, "directory, not listed yet\n");
+
+    } else {
+
+        e.len = snprintf(e.text, 64, "%d entries\n", entries);
+        memcpy(e.text + e.len, names, len);
+        e.len += len;
+    }
+
+    free(names);
+    current = cache_store(&e);
+    return 1;
+}
+
+void preview_request(const char *path, int type, long long size, long long mtime) {
+
+    if (wanted && wanted_size == size && wanted_mtime == mtime && strcmp(wanted, path) == 0) {
+        return;
+    }
+
+    free(wanted);
+    wanted = strdup(path);
+    wanted_type = type;
+    wanted_size = size;
+    wanted_mtime = mtime;
+    current = -1;
+
+    unsigned id = __atomic_add_fetch(&wanted_id, 1, __ATOMIC_RELAXED);
+
+    if (!wanted) {
+        return;
+    }
+
+    current = cache_find(path, size, mtime);
+
+    if (current >= 0) {
+
+        cache[current].used = ++cache_clock;
+        pthread_mutex_lock(&lock);
+        stats.hits++;
+        pthread_mutex_unlock(&lock);
+        return;
+    }
+
+    if (type == file_dir) {
+
+        preview_directory();
+        return;
+    }
+
+    pthread_mutex_lock(&lock);
+
+    if (!thread_running) {
+        thread_running = pthread_create(&thread, NULL, preview_thread, NULL) == 0;
+    }
+
+    /* a file still waiting for the thread is not wanted anymore */
+    if (job.path) {
+
+        stats.cancelled++;
+        entry_free(&job);
+    }
+
+    job.path = strdup(path);
+    job.size = size;
+    job.mtime = mtime;
+    job_id = id;
+    pthread_cond_signal(&wake);
+    pthread_mutex_unlock(&lock);
+}
+
+int preview_get(const char **text, int *len) {
+
+    if (!wanted) {
+        return -1;
+    }
+
+    if (current < 0) {
+        return 0;
+    }
+
+    cache[current].used = ++cache_clock;
+    *text = cache[current].text;
+    *len = cache[current].len;
+    return 1;
+}
+
+int preview_poll(void) {
+
+    preview_entry e = {0};
+
+    pthread_mutex_lock(&lock);
+    e = done;
+    memset(&done, 0, sizeof(done));
+    pthread_mutex_unlock(&lock);
+
+    if (e.path) {
+
+        int slot = cache_store(&e);
+
+        if (current < 0 && is_wanted(slot)) {
+
+            current = slot;
+            return 1;
+        }
+    }
+
+    if (current < 0 && wanted && wanted_type == file_dir) {
+        return preview_directory();
+    }
+
+    return 0;
+}
+
+int preview_poll_timeout(void) {
+
+    return wanted && current < 0 ? PREVIEW_POLL_MS : -1;
+}
+
+void preview_get_stats(preview_stats *out) {
+
+    pthread_mutex_lock(&lock);
+    *out = stats;
+    pthread_mutex_unlock(&lock);
+}
+
+void preview_stop(void) {
+
+    pthread_mutex_lock(&lock);
+    stopping = 1;
+    __atomic_add_fetch(&wanted_id, 1, __ATOMIC_RELAXED);
+    pthread_cond_signal(&wake);
+    pthread_mutex_unlock(&lock);
+
+    if (thread_running) {
+        pthread_join(thread, NULL);
+    }
+
+    thread_running = stopping = 0;
+    entry_free(&job);
+    entry_free(&done);
+
+    for (int i = 0; i < PREVIEW_CACHE_ENTRIES; i++) {
+        entry_free(&cache[i]);
+    }
+
+    free(wanted);
+    wanted = NULL;
+    current = -1;
+}
@@ -0,0 +1,37 @@
+#ifndef PREVIEW_H
+#define PREVIEW_H
+
+/* what the highlighted entry holds, for the pane next to the listing. the head of a file is read on
+ * a background thread, a directory comes out of the listing cache the prefetch fills, see
+ * listing_peek(). finished previews stay in a small LRU cache keyed by path, size and mtime, so
+ * going back to an entry shows it at once and a file that changed is read again.
+ *
+ * only the newest request counts. the thread checks between chunks whether it was replaced and
+ * drops the file if so, a cursor moving quickly over big or slow files never waits for them */
+
+typedef struct preview_stats {
+    int reads;     /* files whose head was read */
+    int cancelled; /* reads dropped because the cursor moved on */
+    int hits;      /* requests answered from the cache */
+} preview_stats;
+
+/* asks for the preview of `path`, an entry of file_type `type` whose row says it has `size` bytes
+ * and was modified at `mtime`, -1 when the row does not tell. asking for the same again is cheap */
+void preview_request(const char *path, int type, long long size, long long mtime);
+
+/* the preview asked for last, as len bytes of lines of printable ASCII. returns 0 while it is still
+ * being made, -1 if nothing was asked for */
+int preview_get(const char **text, int *len);
+
+/* returns 1 if the preview asked for last came in since the last call */
+int preview_poll(void);
+
+/* milliseconds until preview_poll() may have something new, -1 if nothing is on its way */
+int preview_poll_timeout(void);
+
+void preview_get_stats(preview_stats *stats);
+
+/* stops the thread and frees every preview */
+void preview_stop(void);
+
+#endif
@@ -0,0 +1,565 @@
+/* Copyright 2025 Henryk Szenkowicz Holtman
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files(the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in all copies
+    or
+    substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED “AS IS”,
+    WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "sort.h"
+#include "config.h"
+#include "listing.h"
+#include <ctype.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* below this many items a single thread is faster than starting more */
+#define SORT_PARALLEL_MIN (64 * 1024)
+#define SORT_RUN 32
+#define SORT_MAX_THREADS 16
+
+/* every key is reduced to a number, string keys keep their first 8 bytes in it and
+ * only look at the whole string when those are equal */
+typedef struct sort_item {
+    uint64_t key;
+    uint32_t row;
+} sort_item;
+
+typedef struct sort_job {
+    sort_item *src, *dst;
+    size_t lo, mid, hi;
+    const char *const *strings; /* per row, NULL for purely numeric keys */
+} sort_job;
+
+const char *sort_key_str(sort_key key) {
+
+    switch (key) {
+
+    case sort_version:
+        return "version";
+
+    case sort_size:
+        return "size";
+
+    case sort_mtime:
+        return "mtime";
+
+    case sort_extension:
+        return "extension";
+
+    case sort_type:
+        return "type";
+
+    default:
+        return "name";
+    }
+}
+
+static int item_before(const sort_item *a, const sort_item *b, const char *const *strings) {
+
+    if (a->key != b->key) {
+        return a->key < b->key;
+    }
+
+    if (strings) {
+
+        int cmp = strcmp(strings[a->row], strings[b->row]);
+        if (cmp != 0) {
+            return cmp < 0;
+        }
+    }
+
+    return a->row < b->row;
+}
+
+/* big endian, so comparing the numbers compares the bytes */
+static uint64_t string_prefix(const char *s) {
+
+    uint64_t key = 0;
+    int i = 0;
+
+    for (; i < 8 && s[i]; i++) {
+        key = (key << 8) | (unsigned char)s[i];
+    }
+
+    return key << (8 * (8 - i));
+}
+
+static void insertion_sort(sort_item *a, size_t n, const char *const *strings) {
+
+    for (size_t i = 1; i < n; i++) {
+
+        sort_item item = a[i];
+        size_t j = i;
+
+        while (j > 0 && item_before(&item, &a[j - 1], strings)) {
+            a[j] = a[j - 1];
+            j--;
+        }
+
+        a[j] = item;
+    }
+}
+
+static void merge(const sort_item *src, sort_item *dst, size_t lo, size_t mid, size_t hi, const char *const *strings) {
+
+    size_t i = lo, j = mid, out = lo;
+
+    while (i < mid && j < hi) {
+        dst[out++] = item_before(&src[j], &src[i], strings) ? src[j++] : src[i++];
+    }
+
+    memcpy(dst + out, src + i, (mid - i) * sizeof(sort_item));
+    out += mid - i;
+    memcpy(dst + out, src + j, (hi - j) * sizeof(sort_item));
+}
+
+/* bottom-up merge sort of a[0, n), tmp is scratch space of the same size */
+static void merge_sort(sort_item *a, sort_item *tmp, size_t n, const char *const *strings) {
+
+    for (size_t lo = 0; lo < n; lo += SORT_RUN) {
+        insertion_sort(a + lo, n - lo < SORT_RUN ? n - lo : SORT_RUN, strings);
+    }
+
+    sort_item *src = a, *dst = tmp;
+
+    for (size_t width = SORT_RUN; width < n; width *= 2) {
+
+        for (size_t lo = 0; lo < n; lo += 2 * width) {
+
+            size_t mid = lo + width < n ? lo + width : n;
+            size_t hi = lo + 2 * width < n ? lo + 2 * width : n;
+            merge(src, dst, lo, mid, hi, strings);
+        }
+
+        sort_item *swap = src;
+        src = dst;
+        dst = swap;
+    }
+
+    if (src != a) {
+        memcpy(a, src, n * sizeof(sort_item));
+    }
+}
+
+static void *sort_worker(void *arg) {
+
+    sort_job *job = arg;
+
+    if (job->mid == job->lo) {
+
+        /* a slice of its own */
+        merge_sort(job->src + job->lo, job->dst + job->lo, job->hi - job->lo, job->strings);
+
+    } else {
+
+        merge(job->src, job->dst, job->lo, job->mid, job->hi, job->strings);
+    }
+
+    return NULL;
+}
+
+static int sort_threads(size_t n) {
+
+    if (n < SORT_PARALLEL_MIN) {
+        return 1;
+    }
+
+    long cpus = SORT_THREADS > 0 ? SORT_THREADS : sysconf(_SC_NPROCESSORS_ONLN);
+    int threads = 1;
+
+    /* a power of two keeps the merge tree balanced */
+    while (threads * 2 <= cpus && threads * 2 <= SORT_MAX_THREADS) {
+        threads *= 2;
+    }
+
+    return threads;
+}
+
+/* runs jobs[0, count) on their own threads, or inline where a thread can't be had */
+static void run_jobs(sort_job *jobs, int count) {
+
+    pthread_t threads[SORT_MAX_THREADS];
+    int started[SORT_MAX_THREADS];
+
+    for (int i = 1; i < count; i++) {
+        started[i] = pthread_create(&threads[i], NULL, sort_worker, &jobs[i]) == 0;
+        if (!started[i]) {
+            sort_worker(&jobs[i]);
+        }
+    }
+
+    sort_worker(&jobs[0]);
+
+    for (int i = 1; i < count; i++) {
+        if (started[i]) {
+            pthread_join(threads[i], NULL);
+        }
+    }
+}
+
+/* each thread sorts a slice, then neighbouring slices are merged pairwise, also in parallel */
+static int parallel_sort(sort_item *a, size_t n, const char *const *strings) {
+
+    sort_item *tmp = malloc((n > 0 ? n : 1) * sizeof(sort_item));
+    if (!tmp) {
+        return -1;
+    }
+
+    int threads = sort_threads(n);
+    size_t bounds[SORT_MAX_THREADS + 1];
+    sort_job jobs[SORT_MAX_THREADS];
+
+    for (int i = 0; i <= threads; i++) {
+        bounds[i] = n * i / threads;
+    }
+
+    for (int i = 0; i < threads; i++) {
+        jobs[i] = (sort_job){a, tmp, bounds[i], bounds[i], bounds[i + 1], strings};
+    }
+
+    run_jobs(jobs, threads);
+
+    sort_item *src = a, *dst = tmp;
+
+    for (int step = 1; step < threads; step *= 2) {
+
+        int count = 0;
+
+        for (int i = 0; i < threads; i += 2 * step) {
+            jobs[count++] = (sort_job){src, dst, bounds[i], bounds[i + step], bounds[i + 2 * step], strings};
+        }
+
+        run_jobs(jobs, count);
+
+        sort_item *swap = src;
+        src = dst;
+        dst = swap;
+    }
+
+    if (src != a) {
+        memcpy(a, src, n * sizeof(sort_item));
+    }
+
+    free(tmp);
+    return 0;
+}
+
+static int finish_order(sort_item *items, int count, const char *const *strings, int *order) {
+
+    if (parallel_sort(items, count, strings) != 0) {
+        return -1;
+    }
+
+    for (int i = 0; i < count; i++) {
+        order[i] = items[i].row;
+    }
+
+    return 0;
+}
+
+int sort_collated(const char *const *names, int count, int *order) {
+
+    arena keys = {0};
+    const char **strings = calloc(count > 0 ? count : 1, sizeof(char *));
+    sort_item *items = malloc((count > 0 ? count : 1) * sizeof(sort_item));
+    int ret = -1;
+
+    if (!strings || !items) {
+        goto out;
+    }
+
+    for (int i = 0; i < count; i++) {
+
+        /* strcmp() over strxfrm() output orders like strcoll() over the names */
+        size_t len = strxfrm(NULL, names[i], 0);
+        char *key = arena_alloc(&keys, len + 1);
+
+        if (!key) {
+            goto out;
+        }
+
+        strxfrm(key, names[i], len + 1);
+        strings[i] = key;
+        items[i].key = string_prefix(key);
+        items[i].row = i;
+    }
+
+    ret = finish_order(items, count, strings, order);
+
+out:
+    arena_free(&keys);
+    free(strings);
+    free(items);
+    return ret;
+}
+
+/* case folded, with every digit run turned into '0', its length and its digits without leading
+ * zeros. strcmp() on those orders numbers by value: a length byte decides before any digit does */
+static char *version_key(arena *a, const char *name, int len) {
+
+    /* a run of d digits takes d + 2 bytes and runs are at least a byte apart, so one of every two
+     * bytes can grow by 2: "1.1.1" needs 11 and the NUL */
+    char *key = arena_alloc(a, len * 2 + 2);
+    if (!key) {
+        return NULL;
+    }
+
+    char *out = key;
+
+    for (int i = 0; i < len;) {
+
+        if (!isdigit((unsigned char)name[i])) {
+
+            *out++ = tolower((unsigned char)name[i++]);
+            continue;
+        }
+
+        int end = i;
+        while (end < len && isdigit((unsigned char)name[end])) {
+            end++;
+        }
+
+        while (i < end - 1 && name[i] == '0') {
+            i++;
+        }
+
+        int digits = end - i < 255 ? end - i : 255;
+
+        *out++ = '0';
+        *out++ = (char)digits;
+        memcpy(out, name + i, digits);
+        out += digits;
+        i = end;
+    }
+
+    *out = '\0';
+    return key;
+}
+
+/* the bare name's extension, or NULL. neither a leading nor a trailing dot starts one */
+static const char *extension(const ls_table *t, int row, int *len) {
+
+    const char *name = t->fname[row];
+
+    for (int i = t->name_len[row] - 2; i > 0; i--) {
+
+        if (name[i] == '.') {
+
+            *len = t->name_len[row] - i - 1;
+            return name + i + 1;
+        }
+    }
+
+    return NULL;
+}
+
+/* extensions repeat a lot, so they are collated once each: every distinct one goes through a small
+ * hash table, only those get sorted and each row just takes its extension's rank */
+static int extension_ranks(const ls_table *t, uint64_t *rank) {
+
+    size_t slots = 64;
+    while (slots < (size_t)t->count * 2 && slots < ((size_t)1 << 20)) {
+        slots *= 2;
+    }
+
+    int *table = malloc(slots * sizeof(int));
+    int *ids = malloc((t->count > 0 ? t->count : 1) * sizeof(int));
+    const char **names = malloc((t->count > 0 ? t->count : 1) * sizeof(char *));
+    int *first_row = malloc((t->count > 0 ? t->count : 1) * sizeof(int));
+    arena copies = {0};
+    int distinct = 0, ret = -1;
+
+    if (!table || !ids || !names || !first_row) {
+        goto out;
+    }
+
+    memset(table, -1, slots * sizeof(int));
+
+    for (int row = 0; row < t->count; row++) {
+
+        int len;
+        const char *ext = extension(t, row, &len);
+
+        if (!ext) {
+            ids[row] = -1;
+            continue;
+        }
+
+        uint64_t hash = 1469598103934665603ULL;
+        for (int i = 0; i < len; i++) {
+            hash = (hash ^ (unsigned char)ext[i]) * 1099511628211ULL;
+        }
+
+        size_t slot = hash & (slots - 1);
+
+        for (;;) {
+
+            int id = table[slot];
+
+            if (id < 0) {
+
+                /* first time this extension shows up */
+                char *copy = arena_strndup(&copies, ext, len);
+                if (!copy) {
+                    goto out;
+                }
+
+                table[slot] = id = distinct;
+                names[distinct] = copy;
+                first_row[distinct] = row;
+                distinct++;
+                ids[row] = id;
+                break;
+            }
+
+            int other_len;
+            const char *other = extension(t, first_row[id], &other_len);
+
+            if (other_len == len && memcmp(other, ext, len) == 0) {
+
+                ids[row] = id;
+                break;
+            }
+
+            slot = (slot + 1) & (slots - 1);
+        }
+    }
+
+    int *order = malloc((distinct > 0 ? distinct : 1) * sizeof(int));
+    if (!order || sort_collated(names, distinct, order) != 0) {
+
+        free(order);
+        goto out;
+    }
+
+    /* reuse first_row as id -> rank, 0 is for names without an extension */
+    for (int i = 0; i < distinct; i++) {
+        first_row[order[i]] = i + 1;
+    }
+
+    for (int row = 0; row < t->count; row++) {
+        rank[row] = ids[row] < 0 ? 0 : first_row[ids[row]];
+    }
+
+    free(order);
+    ret = 0;
+
+out:
+    arena_free(&copies);
+    free(table);
+    free(ids);
+    free(names);
+    free(first_row);
+    return ret;
+}
+
+static uint64_t type_rank(int type) {
+
+    switch (type) {
+
+    case file_dir:
+        return 0;
+
+    case file_link:
+        return 1;
+
+    case file_exec:
+        return 2;
+
+    default:
+        return 3;
+    }
+}
+
+int table_sort(const ls_table *t, sort_key key, int *order) {
+
+    int count = t->count;
+    sort_item *items = malloc((count > 0 ? count : 1) * sizeof(sort_item));
+    uint64_t *rank = NULL;
+    const char **strings = NULL;
+    arena keys = {0};
+    int ret = -1;
+
+    if (!items) {
+        return -1;
+    }
+
+    if (!t->native && (key == sort_size || key == sort_mtime)) {
+        key = sort_name;
+    }
+
+    if (key == sort_extension) {
+
+        rank = malloc((count > 0 ? count : 1) * sizeof(uint64_t));
+        if (!rank || extension_ranks(t, rank) != 0) {
+            goto out;
+        }
+    }
+
+    if (key == sort_version) {
+
+        strings = calloc(count > 0 ? count : 1, sizeof(char *));
+        if (!strings) {
+            goto out;
+        }
+    }
+
+    for (int row = 0; row < count; row++) {
+
+        uint64_t k = 0;
+
+        switch (key) {
+
+        case sort_version:
+            strings[row] = version_key(&keys, t->fname[row], t->name_len[row]);
+            if (!strings[row]) {
+                goto out;
+            }
+            k = string_prefix(strings[row]);
+            break;
+
+        case sort_size:
+            /* devices keep st_rdev in the size column, ls -S counts them as empty */
+            k = S_ISCHR(t->mode[row]) || S_ISBLK(t->mode[row]) ? 0 : (uint64_t)t->size[row];
+            k = ~k;
+            break;
+
+        case sort_mtime:
+            k = ~((uint64_t)t->mtime[row] ^ (1ULL << 63));
+            break;
+
+        case sort_extension:
+            k = rank[row];
+            break;
+
+        case sort_type:
+            k = type_rank(t->type[row]);
+            break;
+
+        default:
+            /* rows already are in name order */
+            break;
+        }
+
+        items[row].key = k;
+        items[row].row = row;
+    }
+
+    ret = finish_order(items, count, strings, order);
+
+out:
+    arena_free(&keys);
+    free(strings);
+    free(rank);
+    free(items);
+    return ret;
+}
@@ -0,0 +1,28 @@
+#ifndef SORT_H
+#define SORT_H
+
+#include "table.h"
+
+/* the orders a listing can be shown in. ties always fall back to name order */
+typedef enum {
+    sort_name,
+    sort_version,   /* digit runs compare as numbers, case folded: file2 before File10 */
+    sort_size,      /* largest first, like ls -S */
+    sort_mtime,     /* newest first, like ls -t */
+    sort_extension, /* by what follows the last '.', names without one first, like ls -X */
+    sort_type,      /* directories, symlinks, executables, then everything else */
+    sort_key_count,
+} sort_key;
+
+const char *sort_key_str(sort_key key);
+
+/* fills order[0, count) with the indices of names in strcoll() order. collation keys are built with
+ * strxfrm() once per name instead of being recomputed by every comparison. returns -1 if memory runs out */
+int sort_collated(const char *const *names, int count, int *order);
+
+/* fills order[0, t->count) with the rows of t in `key` order. t must be in name order, which is how
+ * every listing is stored, so the row index doubles as the name tie breaker. text tables have no
+ * size or mtime and keep name order for those. returns -1 if memory runs out */
+int table_sort(const ls_table *t, sort_key key, int *order);
+
+#endif
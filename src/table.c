@@ -0,0 +1,269 @@
+/* Copyright 2025 Henryk Szenkowicz Holtman
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files(the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in all copies
+    or
+    substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED “AS IS”,
+    WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "table.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_COLUMNS 10
+
+/* past this the change log starts over under a new serial, readers rebuild what they keep. tables
+ * filled a row at a time, like a loader's, just keep starting over */
+#define MAX_CHANGES 1024
+
+static unsigned last_serial;
+
+/* the per-row arrays of t and the size of one element, so the operations below treat them alike.
+ * a table only has the columns of its kind */
+static int table_columns(ls_table *t, void ***cols, size_t *sizes) {
+
+    int n = 0;
+
+#define COLUMN(c)                  \
+    do {                           \
+        cols[n] = (void **)&t->c;  \
+        sizes[n] = sizeof(*t->c);  \
+        n++;                       \
+    } while (0)
+
+    COLUMN(fname);
+    COLUMN(name_len);
+    COLUMN(type);
+
+    if (t->native) {
+
+        COLUMN(mode);
+        COLUMN(nlink);
+        COLUMN(uid);
+        COLUMN(gid);
+        COLUMN(size);
+        COLUMN(mtime);
+
+    } else {
+
+        COLUMN(prefix);
+    }
+
+#undef COLUMN
+
+    return n;
+}
+
+void table_init(ls_table *t, int native) {
+
+    memset(t, 0, sizeof(*t));
+    t->native = native;
+    for (int i = 0; i < 6; i++) {
+        t->widths[i] = 1;
+    }
+    t->now = time(NULL);
+
+    /* loader threads make tables too */
+    t->serial = __atomic_add_fetch(&last_serial, 1, __ATOMIC_RELAXED);
+}
+
+/* the rows no longer line up with what readers saw, they all start over */
+static void forget_changes(ls_table *t) {
+
+    t->serial = __atomic_add_fetch(&last_serial, 1, __ATOMIC_RELAXED);
+    t->change_count = 0;
+}
+
+static void note_change(ls_table *t, int at, int rows) {
+
+    if (t->change_count == MAX_CHANGES) {
+
+        forget_changes(t);
+        return;
+    }
+
+    if (t->change_count == t->change_capacity) {
+
+        int capacity = t->change_capacity ? t->change_capacity * 2 : 16;
+        table_change *changes = realloc(t->changes, capacity * sizeof(*changes));
+
+        if (!changes) {
+
+            forget_changes(t);
+            return;
+        }
+
+        t->changes = changes;
+        t->change_capacity = capacity;
+    }
+
+    t->changes[t->change_count++] = (table_change){at, rows};
+}
+
+const table_change *table_changes(const ls_table *t, unsigned serial, int seen, int *count) {
+
+    if (t->serial != serial || seen > t->change_count) {
+        return NULL;
+    }
+
+    *count = t->change_count - seen;
+    return t->changes + seen;
+}
+
+static int table_reserve(ls_table *t, int need) {
+
+    if (need <= t->capacity) {
+        return 0;
+    }
+
+    int capacity = t->capacity ? t->capacity * 2 : 64;
+    if (capacity < need) {
+        capacity = need;
+    }
+
+    void **cols[MAX_COLUMNS];
+    size_t sizes[MAX_COLUMNS];
+    int n = table_columns(t, cols, sizes);
+
+    /* columns that already grew stay valid, the capacity only moves once all of them did */
+    for (int i = 0; i < n; i++) {
+
+        void *p = realloc(*cols[i], capacity * sizes[i]);
+        if (!p) {
+            return -1;
+        }
+        *cols[i] = p;
+    }
+
+    t->capacity = capacity;
+    return 0;
+}
+
+int table_insert_rows(ls_table *t, int at, int n) {
+
+    if (table_reserve(t, t->count + n) != 0) {
+        return -1;
+    }
+
+    void **cols[MAX_COLUMNS];
+    size_t sizes[MAX_COLUMNS];
+    int ncols = table_columns(t, cols, sizes);
+
+    for (int i = 0; i < ncols && at < t->count; i++) {
+
+        char *col = *cols[i];
+        memmove(col + (at + n) * sizes[i], col + at * sizes[i], (t->count - at) * sizes[i]);
+    }
+
+    t->count += n;
+    note_change(t, at, n);
+    return 0;
+}
+
+void table_remove_row(ls_table *t, int at) {
+
+    void **cols[MAX_COLUMNS];
+    size_t sizes[MAX_COLUMNS];
+    int ncols = table_columns(t, cols, sizes);
+
+    for (int i = 0; i < ncols; i++) {
+
+        char *col = *cols[i];
+        memmove(col + at * sizes[i], col + (at + 1) * sizes[i], (t->count - at - 1) * sizes[i]);
+    }
+
+    t->count--;
+    note_change(t, at, -1);
+}
+
+int table_append(ls_table *t, const ls_table *src) {
+
+    int at = t->count;
+
+    if (src->count == 0) {
+        return 0;
+    }
+
+    if (table_insert_rows(t, at, src->count) != 0) {
+        return -1;
+    }
+
+    void **cols[MAX_COLUMNS], **src_cols[MAX_COLUMNS];
+    size_t sizes[MAX_COLUMNS];
+    int ncols = table_columns(t, cols, sizes);
+    table_columns((ls_table *)src, src_cols, sizes);
+
+    for (int i = 0; i < ncols; i++) {
+        memcpy((char *)*cols[i] + at * sizes[i], *src_cols[i], src->count * sizes[i]);
+    }
+
+    return 0;
+}
+
+int table_permute(ls_table *t, const int *order) {
+
+    void **cols[MAX_COLUMNS];
+    size_t sizes[MAX_COLUMNS];
+    int ncols = table_columns(t, cols, sizes);
+
+    /* one column at a time goes through a scratch copy, none of them is wider than a pointer or a long long */
+    char *scratch = malloc((t->count > 0 ? t->count : 1) * sizeof(long long));
+    if (!scratch) {
+        return -1;
+    }
+
+    for (int i = 0; i < ncols; i++) {
+
+        char *col = *cols[i];
+
+        for (int row = 0; row < t->count; row++) {
+            memcpy(scratch + row * sizes[i], col + order[row] * sizes[i], sizes[i]);
+        }
+
+        memcpy(col, scratch, t->count * sizes[i]);
+    }
+
+    free(scratch);
+    forget_changes(t);
+    return 0;
+}
+
+size_t table_bytes(const ls_table *t) {
+
+    void **cols[MAX_COLUMNS];
+    size_t sizes[MAX_COLUMNS];
+    int ncols = table_columns((ls_table *)t, cols, sizes);
+    size_t bytes = t->arena.reserved;
+
+    for (int i = 0; i < ncols; i++) {
+        bytes += t->capacity * sizes[i];
+    }
+
+    return bytes;
+}
+
+void table_free(ls_table *t) {
+
+    void **cols[MAX_COLUMNS];
+    size_t sizes[MAX_COLUMNS];
+    int ncols = table_columns(t, cols, sizes);
+
+    for (int i = 0; i < ncols; i++) {
+
+        free(*cols[i]);
+        *cols[i] = NULL;
+    }
+
+    arena_free(&t->arena);
+    t->count = t->capacity = 0;
+
+    free(t->changes);
+    t->changes = NULL;
+    t->change_capacity = 0;
+    forget_changes(t);
+}
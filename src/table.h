@@ -0,0 +1,71 @@
+#ifndef TABLE_H
+#define TABLE_H
+
+#include "arena.h"
+#include <sys/types.h>
+#include <time.h>
+
+/* the entries of a listing as columns, row i is the i-th entry in display order. fixed width metadata
+ * sits in packed arrays so a pass over one of them (search, sort keys, find) touches nothing else,
+ * owner and group are stored as ids and looked up in native.c's name cache when a row is drawn */
+typedef struct ls_table {
+    int count;
+    int capacity;
+
+    char **fname;             /* bare name, then the -F mark or " -> target", all in arena */
+    unsigned short *name_len; /* length of the bare name */
+    unsigned char *type;      /* file_type */
+    mode_t *mode;
+    unsigned int *nlink;
+    uid_t *uid;
+    gid_t *gid;
+    long long *size; /* st_rdev for devices */
+    long long *mtime;
+
+    /* LS_COMMAND listings keep what ls printed before the name, NULL for native ones */
+    char **prefix;
+
+    int native;    /* rows are formatted from the columns above */
+    int widths[6]; /* links, owner, group, size, device major, device minor */
+    time_t now;    /* dates are shown relative to when the directory was read */
+    arena arena;   /* names, empty while they still live in a loader's arena */
+
+    /* rows opened and removed since the table got its serial, so an index over its names can follow
+     * them instead of starting over. see table_changes() */
+    unsigned serial;
+    struct table_change *changes;
+    int change_count;
+    int change_capacity;
+} ls_table;
+
+/* `rows` rows opened at `at`, or removed from it when negative */
+typedef struct table_change {
+    int at;
+    int rows;
+} table_change;
+
+/* an empty table of either kind */
+void table_init(ls_table *t, int native);
+
+/* opens `n` uninitialized rows at `at`, returns -1 if memory runs out */
+int table_insert_rows(ls_table *t, int at, int n);
+void table_remove_row(ls_table *t, int at);
+
+/* appends the rows of src, their strings stay where they are */
+int table_append(ls_table *t, const ls_table *src);
+
+/* moves row order[i] to row i for every row, returns -1 if memory runs out and leaves t as it was */
+int table_permute(ls_table *t, const int *order);
+
+/* the changes made since a reader saw `seen` of them under `serial`, in order, and sets *count to
+ * how many. NULL when the rows were replaced or reordered since, or too many changes piled up, and
+ * the reader has to look at every row again */
+const table_change *table_changes(const ls_table *t, unsigned serial, int seen, int *count);
+
+/* memory held by the columns and the arena */
+size_t table_bytes(const ls_table *t);
+
+/* frees the columns and the arena, leaves an empty table of the same kind */
+void table_free(ls_table *t);
+
+#endif
@@ -0,0 +1,604 @@
+/* Copyright 2025 Henryk Szenkowicz Holtman
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files(the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in all copies
+    or
+    substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED “AS IS”,
+    WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "trigram.h"
+#include "grep.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* following the log costs a move of the row map per change, past this many a rebuild is cheaper */
+#define MAX_REPLAYED_CHANGES 256
+
+/* names removed since the last build stay in the posting lists, the index starts over once they
+ * are half of them */
+#define MIN_DEAD_TO_REBUILD 1024
+
+typedef struct posting {
+    unsigned key; /* the three bytes plus one, 0 for an empty slot */
+    int count;
+    int capacity;
+    int *ids; /* ascending, names get their id in the order they are added */
+} posting;
+
+struct trigram_index {
+    const ls_table *table;
+    unsigned serial; /* of the table when last updated */
+    int seen;        /* changes of it already applied */
+
+    /* the names by id, folded and NUL terminated */
+    char *pool;
+    size_t pool_used, pool_capacity;
+    size_t *offset;
+    unsigned short *len;
+    int *row; /* -1 once removed */
+    int ids, id_capacity;
+    int dead;
+
+    int *id_of; /* row -> id, the same length as the table */
+    int rows, row_capacity;
+    int rows_moved; /* row[] has to be rebuilt from id_of before a search */
+
+    posting *slots; /* open addressing, a power of two */
+    int slot_count, slot_used;
+
+    trigram_stats stats;
+};
+
+static inline char fold(char c) {
+
+    return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+}
+
+static inline unsigned trigram_key(const char *p) {
+
+    return ((unsigned)(unsigned char)p[0] << 16 | (unsigned)(unsigned char)p[1] << 8 | (unsigned char)p[2]) + 1;
+}
+
+static inline unsigned slot_of(unsigned key, int slot_count) {
+
+    return (key * 2654435761u) & (slot_count - 1);
+}
+
+trigram_index *trigram_new(void) {
+
+    return calloc(1, sizeof(trigram_index));
+}
+
+static void drop_all(trigram_index *ix) {
+
+    for (int i = 0; i < ix->slot_count; i++) {
+        free(ix->slots[i].ids);
+    }
+
+    free(ix->slots);
+    free(ix->pool);
+    free(ix->offset);
+    free(ix->len);
+    free(ix->row);
+    free(ix->id_of);
+
+    trigram_stats stats = ix->stats;
+    memset(ix, 0, sizeof(*ix));
+    ix->stats = stats;
+}
+
+static posting *lookup(const trigram_index *ix, unsigned key) {
+
+    if (ix->slot_count == 0) {
+        return NULL;
+    }
+
+    for (unsigned i = slot_of(key, ix->slot_count);; i = (i + 1) & (ix->slot_count - 1)) {
+
+        if (ix->slots[i].key == key) {
+            return &ix->slots[i];
+        } else if (ix->slots[i].key == 0) {
+            return NULL;
+        }
+    }
+}
+
+static int grow_slots(trigram_index *ix) {
+
+    int count = ix->slot_count ? ix->slot_count * 2 : 4096;
+    posting *slots = calloc(count, sizeof(posting));
+
+    if (!slots) {
+        return -1;
+    }
+
+    for (int i = 0; i < ix->slot_count; i++) {
+
+        if (ix->slots[i].key == 0) {
+            continue;
+        }
+
+        unsigned j = slot_of(ix->slots[i].key, count);
+        while (slots[j].key) {
+            j = (j + 1) & (count - 1);
+        }
+        slots[j] = ix->slots[i];
+    }
+
+    free(ix->slots);
+    ix->slots = slots;
+    ix->slot_count = count;
+    return 0;
+}
+
+static int add_posting(trigram_index *ix, unsigned key, int id) {
+
+    if (ix->slot_used * 2 >= ix->slot_count && grow_slots(ix) != 0) {
+        return -1;
+    }
+
+    unsigned i = slot_of(key, ix->slot_count);
+    while (ix->slots[i].key && ix->slots[i].key != key) {
+        i = (i + 1) & (ix->slot_count - 1);
+    }
+
+    posting *p = &ix->slots[i];
+
+    if (p->key == 0) {
+
+        p->key = key;
+        ix->slot_used++;
+    }
+
+    /* a name holding the same run twice is listed once */
+    if (p->count > 0 && p->ids[p->count - 1] == id) {
+        return 0;
+    }
+
+    if (p->count == p->capacity) {
+
+        int capacity = p->capacity ? p->capacity * 2 : 4;
+        int *ids = realloc(p->ids, capacity * sizeof(int));
+
+        if (!ids) {
+            return -1;
+        }
+
+        p->ids = ids;
+        p->capacity = capacity;
+    }
+
+    p->ids[p->count++] = id;
+    return 0;
+}
+
+static int reserve(void **p, int *capacity, int need, size_t size) {
+
+    if (need <= *capacity) {
+        return 0;
+    }
+
+    int grown = *capacity ? *capacity * 2 : 1024;
+    if (grown < need) {
+        grown = need;
+    }
+
+    void *q = realloc(*p, grown * size);
+    if (!q) {
+        return -1;
+    }
+
+    *p = q;
+    *capacity = grown;
+    return 0;
+}
+
+/* gives the name of table row `row` the next id, returns it or -1 */
+static int add_name(trigram_index *ix, const ls_table *t, int row) {
+
+    int len = t->name_len[row];
+    const char *name = t->fname[row];
+
+    if (ix->ids == ix->id_capacity) {
+
+        int capacity = ix->id_capacity ? ix->id_capacity * 2 : 1024;
+        size_t *offset = realloc(ix->offset, capacity * sizeof(size_t));
+        if (offset) {
+            ix->offset = offset;
+        }
+        unsigned short *lens = realloc(ix->len, capacity * sizeof(unsigned short));
+        if (lens) {
+            ix->len = lens;
+        }
+        int *rows = realloc(ix->row, capacity * sizeof(int));
+        if (rows) {
+            ix->row = rows;
+        }
+
+        if (!offset || !lens || !rows) {
+            return -1;
+        }
+        ix->id_capacity = capacity;
+    }
+
+    if (ix->pool_used + len + 1 > ix->pool_capacity) {
+
+        size_t capacity = ix->pool_capacity ? ix->pool_capacity * 2 : 65536;
+        while (capacity < ix->pool_used + len + 1) {
+            capacity *= 2;
+        }
+
+        char *pool = realloc(ix->pool, capacity);
+        if (!pool) {
+            return -1;
+        }
+
+        ix->pool = pool;
+        ix->pool_capacity = capacity;
+    }
+
+    int id = ix->ids;
+    char *folded = ix->pool + ix->pool_used;
+
+    for (int i = 0; i < len; i++) {
+        folded[i] = fold(name[i]);
+    }
+    folded[len] = '\0';
+
+    for (int i = 0; i + 3 <= len; i++) {
+        if (add_posting(ix, trigram_key(folded + i), id) != 0) {
+            return -1;
+        }
+    }
+
+    ix->offset[id] = ix->pool_used;
+    ix->len[id] = len;
+    ix->row[id] = row;
+    ix->pool_used += len + 1;
+    ix->ids++;
+    return id;
+}
+
+/* a build sized every array by doubling, most of what it left spare is given back. lists that grow
+ * later start doubling again */
+static void trim(trigram_index *ix) {
+
+    for (int i = 0; i < ix->slot_count; i++) {
+
+        posting *p = &ix->slots[i];
+        int *ids = p->count < p->capacity ? realloc(p->ids, p->count * sizeof(int)) : NULL;
+
+        if (ids) {
+
+            p->ids = ids;
+            p->capacity = p->count;
+        }
+    }
+
+    char *pool = realloc(ix->pool, ix->pool_used + 1);
+    if (pool) {
+
+        ix->pool = pool;
+        ix->pool_capacity = ix->pool_used + 1;
+    }
+}
+
+static int rebuild(trigram_index *ix, const ls_table *t) {
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    drop_all(ix);
+
+    /* the table is only taken on once every name is in, a failed build leaves nothing to update so
+     * the next search tries again from scratch */
+    if (reserve((void **)&ix->id_of, &ix->row_capacity, t->count, sizeof(int)) != 0) {
+
+        drop_all(ix);
+        return -1;
+    }
+
+    for (int row = 0; row < t->count; row++) {
+
+        if ((ix->id_of[row] = add_name(ix, t, row)) < 0) {
+
+            drop_all(ix);
+            return -1;
+        }
+    }
+
+    ix->table = t;
+    ix->serial = t->serial;
+    ix->seen = t->change_count;
+    ix->rows = t->count;
+    trim(ix);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    ix->stats.build_ms = (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6;
+    ix->stats.updates = 0;
+    return 0;
+}
+
+/* replays the table's changes on the row map. opened rows get an id once all changes are in, so
+ * they are read where they ended up. returns -1 if the rows don't add up or memory runs out */
+static int replay(trigram_index *ix, const ls_table *t, const table_change *changes, int count) {
+
+    for (int i = 0; i < count; i++) {
+
+        int at = changes[i].at, n = changes[i].rows;
+
+        if (n > 0) {
+
+            if (at > ix->rows || reserve((void **)&ix->id_of, &ix->row_capacity, ix->rows + n, sizeof(int)) != 0) {
+                return -1;
+            }
+
+            memmove(ix->id_of + at + n, ix->id_of + at, (ix->rows - at) * sizeof(int));
+
+            for (int row = at; row < at + n; row++) {
+                ix->id_of[row] = -1;
+            }
+
+        } else {
+
+            if (at - n > ix->rows) {
+                return -1;
+            }
+
+            /* removed names stay in the posting lists and are skipped when found */
+            for (int row = at; row < at - n; row++) {
+
+                int id = ix->id_of[row];
+
+                if (id >= 0) {
+
+                    ix->row[id] = -1;
+                    ix->dead++;
+                }
+            }
+
+            memmove(ix->id_of + at, ix->id_of + at - n, (ix->rows - at + n) * sizeof(int));
+        }
+
+        ix->rows += n;
+        ix->rows_moved = 1;
+    }
+
+    if (ix->rows != t->count) {
+        return -1;
+    }
+
+    for (int row = 0; row < ix->rows; row++) {
+
+        if (ix->id_of[row] < 0 && (ix->id_of[row] = add_name(ix, t, row)) < 0) {
+            return -1;
+        }
+    }
+
+    ix->stats.updates += count;
+    return 0;
+}
+
+int trigram_update(trigram_index *ix, const ls_table *t) {
+
+    int count = 0;
+    const table_change *changes = NULL;
+
+    if (ix->table == t) {
+        changes = table_changes(t, ix->serial, ix->seen, &count);
+    }
+
+    if (!changes || count > MAX_REPLAYED_CHANGES) {
+        return rebuild(ix, t);
+    }
+
+    if (count == 0) {
+        return 0;
+    }
+
+    if (replay(ix, t, changes, count) != 0 || (ix->dead >= MIN_DEAD_TO_REBUILD && ix->dead * 2 >= ix->ids)) {
+        return rebuild(ix, t);
+    }
+
+    ix->seen += count;
+    return 0;
+}
+
+static void update_rows(trigram_index *ix) {
+
+    if (!ix->rows_moved) {
+        return;
+    }
+
+    for (int row = 0; row < ix->rows; row++) {
+        ix->row[ix->id_of[row]] = row;
+    }
+
+    ix->rows_moved = 0;
+}
+
+/* the first index at or past `from` in ids[0, n) whose id is at least id, by galloping */
+static int seek(const int *ids, int n, int from, int id) {
+
+    int step = 1, hi = from;
+
+    while (hi < n && ids[hi] < id) {
+
+        from = hi + 1;
+        hi += step;
+        step *= 2;
+    }
+
+    if (hi > n) {
+        hi = n;
+    }
+
+    while (from < hi) {
+
+        int mid = from + (hi - from) / 2;
+
+        if (ids[mid] < id) {
+            from = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return from;
+}
+
+static int by_count(const void *a, const void *b) {
+
+    const posting *x = *(const posting *const *)a, *y = *(const posting *const *)b;
+    return (x->count > y->count) - (x->count < y->count);
+}
+
+/* needles too short to have a trigram: one SIMD search over all of the names, which are back to
+ * back in the pool. a hit is mapped to its name by the offsets, which grow with the id */
+static int scan_pool(const trigram_index *ix, const char *needle, int len, int *rows) {
+
+    int n = 0, id = 0;
+    const char *p = ix->pool, *end = ix->pool + ix->pool_used;
+
+    while (p < end && (p = grep_literal(p, end - p, needle, len)) != NULL) {
+
+        size_t at = p - ix->pool;
+
+        /* the last name starting at or before the hit. NULs never match, it lies within that name.
+         * hits only move forward, so all of them together walk the ids once */
+        while (id + 1 < ix->ids && ix->offset[id + 1] <= at) {
+            id++;
+        }
+
+        if (ix->row[id] >= 0) {
+            rows[n++] = ix->row[id];
+        }
+
+        p = ix->pool + ix->offset[id] + ix->len[id] + 1;
+        id++;
+    }
+
+    return n;
+}
+
+int trigram_search(trigram_index *ix, const char *needle, int len, int *rows) {
+
+    char folded[256];
+
+    if (len <= 0 || len >= (int)sizeof(folded) || ix->ids == 0) {
+        return 0;
+    }
+
+    for (int i = 0; i < len; i++) {
+        folded[i] = fold(needle[i]);
+    }
+
+    update_rows(ix);
+
+    if (len < 3) {
+        return scan_pool(ix, folded, len, rows);
+    }
+
+    /* the needle's runs, the shortest posting list first */
+    posting *lists[256];
+    int count = 0;
+
+    for (int i = 0; i + 3 <= len; i++) {
+
+        posting *p = lookup(ix, trigram_key(folded + i));
+
+        if (!p) {
+            return 0;
+        }
+
+        int seen = 0;
+        for (int j = 0; j < count && !seen; j++) {
+            seen = lists[j] == p;
+        }
+
+        if (!seen) {
+            lists[count++] = p;
+        }
+    }
+
+    qsort(lists, count, sizeof(*lists), by_count);
+
+    /* rows doubles as the candidate list, ids first and rows once they are checked. removed names
+     * are left out right away, the list may hold more of them than the table has rows */
+    int n = 0;
+
+    for (int i = 0; i < lists[0]->count; i++) {
+        if (ix->row[lists[0]->ids[i]] >= 0) {
+            rows[n++] = lists[0]->ids[i];
+        }
+    }
+
+    for (int i = 1; i < count && n > 0; i++) {
+
+        const int *ids = lists[i]->ids;
+        int at = 0, kept = 0;
+
+        for (int j = 0; j < n; j++) {
+
+            at = seek(ids, lists[i]->count, at, rows[j]);
+
+            if (at == lists[i]->count) {
+                break;
+            }
+
+            if (ids[at] == rows[j]) {
+                rows[kept++] = rows[j];
+            }
+        }
+
+        n = kept;
+    }
+
+    /* holding every run does not make it a substring, unless there was only the one */
+    int found = 0;
+
+    for (int i = 0; i < n; i++) {
+
+        int id = rows[i];
+
+        if (len == 3 || grep_literal(ix->pool + ix->offset[id], ix->len[id], folded, len)) {
+            rows[found++] = ix->row[id];
+        }
+    }
+
+    return found;
+}
+
+const char *trigram_folded(const trigram_index *ix, int row) {
+
+    return ix->pool + ix->offset[ix->id_of[row]];
+}
+
+void trigram_report(const trigram_index *ix, trigram_stats *stats) {
+
+    *stats = ix->stats;
+    stats->names = ix->ids - ix->dead;
+    stats->trigrams = ix->slot_used;
+    stats->bytes = sizeof(*ix) + ix->pool_capacity +
+                   ix->id_capacity * (sizeof(size_t) + sizeof(unsigned short) + sizeof(int)) +
+                   ix->row_capacity * sizeof(int) + ix->slot_count * sizeof(posting);
+
+    for (int i = 0; i < ix->slot_count; i++) {
+        stats->bytes += ix->slots[i].capacity * sizeof(int);
+    }
+}
+
+void trigram_free(trigram_index *ix) {
+
+    if (ix) {
+
+        drop_all(ix);
+        free(ix);
+    }
+}
@@ -0,0 +1,38 @@
+#ifndef TRIGRAM_H
+#define TRIGRAM_H
+
+#include "table.h"
+
+/* an index of every three byte run in the case folded names of a table. a substring of at least
+ * three bytes can only be in names that hold all of its runs, so a search intersects their posting
+ * lists and checks the few names left instead of reading every name. the index follows rows coming
+ * and going through the table's change log, and starts over only when the rows were replaced */
+
+typedef struct trigram_index trigram_index;
+
+typedef struct trigram_stats {
+    int names;       /* indexed and still in the table */
+    int trigrams;    /* distinct ones */
+    size_t bytes;    /* held by the index */
+    double build_ms; /* of the last build from scratch */
+    int updates;     /* changes applied since then */
+} trigram_stats;
+
+trigram_index *trigram_new(void);
+
+/* brings the index up to date with t, from scratch the first time or when t was replaced. returns -1
+ * if memory runs out */
+int trigram_update(trigram_index *ix, const ls_table *t);
+
+/* fills rows with the rows of the table whose bare name contains needle, ignoring ASCII case, and
+ * returns how many. rows has room for every row. the index has to be up to date */
+int trigram_search(trigram_index *ix, const char *needle, int len, int *rows);
+
+/* the case folded name of row, valid until the next update */
+const char *trigram_folded(const trigram_index *ix, int row);
+
+void trigram_report(const trigram_index *ix, trigram_stats *stats);
+
+void trigram_free(trigram_index *ix);
+
+#endif
@@ -0,0 +1,279 @@
+/* Copyright 2025 Henryk Szenkowicz Holtman
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files(the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in all copies
+    or
+    substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED “AS IS”,
+    WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "uring.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define STATX_WANTED (STATX_TYPE | STATX_MODE | STATX_NLINK | STATX_UID | STATX_GID | \
+                      STATX_SIZE | STATX_MTIME | STATX_CTIME | STATX_INO | STATX_BLOCKS)
+
+/* minimal raw-syscall ring, liburing is not a dependency of the project */
+typedef struct uring {
+    int fd;
+    void *sq_map, *cq_map;
+    size_t sq_map_size, cq_map_size;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_cqe *cqes;
+    unsigned sq_entries;
+} uring;
+
+static int uring_setup(uring *r, unsigned entries) {
+
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    memset(r, 0, sizeof(*r));
+
+    r->fd = syscall(__NR_io_uring_setup, entries, &p);
+    if (r->fd < 0) {
+        return -1;
+    }
+
+    r->sq_map_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cq_map_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+
+        if (r->cq_map_size > r->sq_map_size) {
+            r->sq_map_size = r->cq_map_size;
+        }
+        r->cq_map_size = r->sq_map_size;
+    }
+
+    r->sq_map = mmap(NULL, r->sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+    if (r->sq_map == MAP_FAILED) {
+
+        close(r->fd);
+        return -1;
+    }
+
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+
+        r->cq_map = r->sq_map;
+
+    } else {
+
+        r->cq_map = mmap(NULL, r->cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_CQ_RING);
+        if (r->cq_map == MAP_FAILED) {
+
+            munmap(r->sq_map, r->sq_map_size);
+            close(r->fd);
+            return -1;
+        }
+    }
+
+    r->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    r->sqes = mmap(NULL, r->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+    if (r->sqes == MAP_FAILED) {
+
+        if (r->cq_map != r->sq_map) {
+            munmap(r->cq_map, r->cq_map_size);
+        }
+        munmap(r->sq_map, r->sq_map_size);
+        close(r->fd);
+        return -1;
+    }
+
+    char *sq = r->sq_map, *cq = r->cq_map;
+
+    r->sq_head = (unsigned *)(sq + p.sq_off.head);
+    r->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+    r->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+    r->sq_array = (unsigned *)(sq + p.sq_off.array);
+    r->cq_head = (unsigned *)(cq + p.cq_off.head);
+    r->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+    r->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+    r->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    r->sq_entries = p.sq_entries;
+
+    return 0;
+}
+
+static void uring_teardown(uring *r) {
+
+    munmap(r->sqes, r->sqes_size);
+    if (r->cq_map != r->sq_map) {
+        munmap(r->cq_map, r->cq_map_size);
+    }
+    munmap(r->sq_map, r->sq_map_size);
+    close(r->fd);
+}
+
+int uring_statx_all(int dfd, int count, int batch, int flags, statx_name_fn name_at, statx_done_fn done, void *ctx) {
+
+    if (count <= 0) {
+        return 0;
+    }
+
+    if (batch > count) {
+        batch = count;
+    }
+
+    uring r;
+    if (uring_setup(&r, batch) != 0) {
+        return -1;
+    }
+
+    /* the kernel may round the ring up, never keep more in flight than there are buffers */
+    unsigned in_flight_max = (unsigned)batch < r.sq_entries ? (unsigned)batch : r.sq_entries;
+
+    struct statx *bufs = malloc(in_flight_max * sizeof(struct statx));
+    unsigned *free_slots = malloc(in_flight_max * sizeof(unsigned));
+    unsigned char *reported = calloc(count, 1);
+
+    if (!bufs || !free_slots || !reported) {
+
+        free(bufs);
+        free(free_slots);
+        free(reported);
+        uring_teardown(&r);
+        return -1;
+    }
+
+    unsigned free_count = in_flight_max;
+    for (unsigned i = 0; i < in_flight_max; i++) {
+        free_slots[i] = i;
+    }
+
+    int next = 0, completed = 0, broken = 0;
+    unsigned unsubmitted = 0;
+    unsigned sq_start = __atomic_load_n(r.sq_head, __ATOMIC_ACQUIRE);
+
+    while (completed < count) {
+
+        if (broken) {
+
+            /* the kernel owns bufs and the names of every sqe it consumed until their cqe is posted,
+               so wait for all of those before anything is freed or stat'ed again */
+            unsigned consumed = __atomic_load_n(r.sq_head, __ATOMIC_ACQUIRE) - sq_start;
+            if ((unsigned)completed == consumed) {
+                break;
+            }
+
+        } else {
+
+            unsigned tail = *r.sq_tail;
+
+            while (next < count && free_count > 0) {
+
+                unsigned slot = free_slots[--free_count];
+                unsigned idx = tail & *r.sq_mask;
+                struct io_uring_sqe *sqe = &r.sqes[idx];
+
+                memset(sqe, 0, sizeof(*sqe));
+                sqe->opcode = IORING_OP_STATX;
+                sqe->fd = dfd;
+                sqe->addr = (uint64_t)(uintptr_t)name_at(ctx, next);
+                sqe->len = STATX_WANTED;
+                sqe->off = (uint64_t)(uintptr_t)&bufs[slot];
+                sqe->statx_flags = flags;
+                sqe->user_data = ((uint64_t)slot << 32) | (uint32_t)next;
+
+                r.sq_array[idx] = idx;
+                tail++;
+                next++;
+                unsubmitted++;
+            }
+
+            __atomic_store_n(r.sq_tail, tail, __ATOMIC_RELEASE);
+        }
+
+        int ret;
+        do {
+            ret = syscall(__NR_io_uring_enter, r.fd, broken ? 0 : unsubmitted, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        } while (ret < 0 && (errno == EINTR || errno == EAGAIN || errno == EBUSY));
+
+        if (ret < 0) {
+
+            if (broken) {
+
+                /* waiting failed as well, completions still get posted to the mapped ring */
+                usleep(1000);
+
+            } else {
+
+                /* sqes the kernel has not consumed stay unsubmitted, they are stat'ed synchronously below */
+                broken = 1;
+                continue;
+            }
+
+        } else if (!broken) {
+
+            unsubmitted -= ret;
+        }
+
+        unsigned head = *r.cq_head;
+        unsigned cq_tail = __atomic_load_n(r.cq_tail, __ATOMIC_ACQUIRE);
+
+        while (head != cq_tail) {
+
+            struct io_uring_cqe *cqe = &r.cqes[head & *r.cq_mask];
+            unsigned slot = (unsigned)(cqe->user_data >> 32);
+            int index = (int)(uint32_t)cqe->user_data;
+            int res = cqe->res;
+
+            if (res == -EINVAL || res == -EOPNOTSUPP) {
+
+                /* kernels before 5.6 know io_uring but not IORING_OP_STATX */
+                res = syscall(__NR_statx, dfd, name_at(ctx, index), flags, STATX_WANTED, &bufs[slot]);
+                res = res == 0 ? 0 : -errno;
+            }
+
+            done(ctx, index, res, &bufs[slot]);
+            reported[index] = 1;
+            free_slots[free_count++] = slot;
+            completed++;
+            head++;
+        }
+
+        __atomic_store_n(r.cq_head, head, __ATOMIC_RELEASE);
+    }
+
+    uring_teardown(&r);
+    free(bufs);
+    free(free_slots);
+
+    if (broken) {
+
+        if (completed == 0) {
+
+            /* nothing has been reported yet, let the caller take the synchronous path */
+            free(reported);
+            return -1;
+        }
+
+        /* the ring broke half way, finish whatever was not reported synchronously */
+        for (int i = 0; i < count; i++) {
+
+            if (!reported[i]) {
+
+                struct statx stx;
+                int res = syscall(__NR_statx, dfd, name_at(ctx, i), flags, STATX_WANTED, &stx);
+                done(ctx, i, res == 0 ? 0 : -errno, &stx);
+            }
+        }
+    }
+
+    free(reported);
+    return 0;
+}
@@ -0,0 +1,16 @@
+#ifndef URING_H
+#define URING_H
+
+#include <linux/stat.h>
+
+/* called once per name as its statx completion arrives. res is 0 or a negative errno */
+typedef void (*statx_done_fn)(void *ctx, int index, int res, const struct statx *stx);
+
+/* returns the name to stat for index */
+typedef const char *(*statx_name_fn)(void *ctx, int index);
+
+/* stats `count` names relative to dfd through io_uring, keeping up to `batch` requests in flight.
+ * returns 0 when every index got its callback, or -1 when io_uring is unavailable (nothing was called). */
+int uring_statx_all(int dfd, int count, int batch, int flags, statx_name_fn name_at, statx_done_fn done, void *ctx);
+
+#endif
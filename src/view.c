@@ -0,0 +1,144 @@
+/* Copyright 2025 Henryk Szenkowicz Holtman
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files(the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in all copies
+    or
+    substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED “AS IS”,
+    WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "view.h"
+
+/* brings the cursor's entry on screen. count < 0 while the listing still grows, otherwise a
+ * continuous viewport does not leave empty lines at the end that entries above could fill */
+static void follow(viewport *v, int count) {
+
+    if (!v->continuous) {
+
+        v->top = v->selected - v->selected % v->rows;
+        return;
+    }
+
+    if (v->selected < v->top) {
+        v->top = v->selected;
+    }
+
+    if (v->selected >= v->top + v->rows) {
+        v->top = v->selected - v->rows + 1;
+    }
+
+    if (count >= 0 && v->top + v->rows > count) {
+        v->top = count > v->rows ? count - v->rows : 0;
+    }
+}
+
+void viewport_init(viewport *v, int rows) {
+
+    v->top = 0;
+    v->rows = rows > 0 ? rows : 1;
+    v->selected = 0;
+}
+
+void viewport_resize(viewport *v, int rows) {
+
+    v->rows = rows > 0 ? rows : 1;
+    follow(v, -1);
+}
+
+void viewport_clamp(viewport *v, int count, int loading) {
+
+    if (!loading && v->selected >= count) {
+        v->selected = count - 1;
+    }
+
+    if (v->selected < 0) {
+        v->selected = 0;
+    }
+
+    follow(v, loading ? -1 : count);
+}
+
+void viewport_move(viewport *v, int delta, int count) {
+
+    long long selected = (long long)v->selected + delta;
+
+    if (selected > count - 1) {
+        selected = count - 1;
+    }
+
+    if (selected < 0) {
+        selected = 0;
+    }
+
+    v->selected = (int)selected;
+    follow(v, count);
+}
+
+void viewport_page(viewport *v, int pages, int count) {
+
+    long long top = v->top + (long long)pages * v->rows;
+
+    if (v->continuous) {
+
+        long long selected = v->selected + (long long)pages * v->rows;
+
+        if (top > count - v->rows) {
+            top = count - v->rows;
+        }
+
+        if (top < 0) {
+            top = 0;
+        }
+
+        if (selected > count - 1) {
+            selected = count - 1;
+        }
+
+        if (selected < 0) {
+            selected = 0;
+        }
+
+        v->top = (int)top;
+        v->selected = (int)selected;
+        follow(v, count);
+        return;
+    }
+
+    if (top < 0 || top >= count) {
+        return;
+    }
+
+    v->top = (int)top;
+    v->selected = v->top;
+}
+
+int viewport_jump(viewport *v, int index, int count) {
+
+    if (index < 0 || index >= count) {
+        return -1;
+    }
+
+    v->selected = index;
+    follow(v, count);
+    return 0;
+}
+
+int viewport_end(const viewport *v, int count) {
+
+    return v->top + v->rows < count ? v->top + v->rows : count;
+}
+
+int viewport_page_number(const viewport *v) {
+
+    /* the same as top / rows for a paged viewport */
+    return v->selected / v->rows;
+}
+
+int viewport_page_count(const viewport *v, int count) {
+
+    return (int)(((long long)count + v->rows - 1) / v->rows);
+}
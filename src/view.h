@@ -0,0 +1,41 @@
+#ifndef VIEW_H
+#define VIEW_H
+
+/* the window of a listing that is on screen. rows are display indices (see listing_row()) and
+ * every operation only does arithmetic on the viewport, so a key costs the same in a directory of
+ * ten entries or ten million. drawing then touches the `rows` entries from `top` on and no others */
+typedef struct viewport {
+    int top;        /* first display index on screen, a multiple of rows unless continuous */
+    int rows;       /* entries per screen */
+    int selected;   /* display index under the cursor */
+    int continuous; /* the screen follows the cursor line by line instead of flipping whole pages */
+} viewport;
+
+void viewport_init(viewport *v, int rows);
+
+/* changes the number of entries on screen, the cursor stays on its entry. nothing but the
+ * viewport is touched, so a resize costs a repaint however long the listing is */
+void viewport_resize(viewport *v, int rows);
+
+/* keeps the cursor on an entry and its page on screen. while loading the listing only grows, so a
+ * cursor past the end waits there for its entry instead of being pulled back */
+void viewport_clamp(viewport *v, int count, int loading);
+
+/* moves the cursor by delta entries, stopping at either end */
+void viewport_move(viewport *v, int delta, int count);
+
+/* flips `pages` pages forward (or back when negative) with the cursor on the first entry,
+ * does nothing past either end. continuous viewports scroll by as many lines and keep the cursor
+ * where it is on screen, stopping at either end */
+void viewport_page(viewport *v, int pages, int count);
+
+/* puts the cursor on `index` if there is such an entry, returns -1 otherwise */
+int viewport_jump(viewport *v, int index, int count);
+
+/* one past the last display index on screen */
+int viewport_end(const viewport *v, int count);
+
+int viewport_page_number(const viewport *v);
+int viewport_page_count(const viewport *v, int count);
+
+#endif
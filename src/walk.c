@@ -0,0 +1,267 @@
+/* Copyright 2025 Henryk Szenkowicz Holtman
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files(the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in all copies
+    or
+    substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED “AS IS”,
+    WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "walk.h"
+#include "native.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+int walk_threads(int configured) {
+
+    long threads = configured > 0 ? configured : 4 * sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (threads < 1) {
+        threads = 1;
+    }
+
+    return threads < WALK_MAX_THREADS ? threads : WALK_MAX_THREADS;
+}
+
+void walk_init(walk *wk, int threads, walk_visit visit, void *data) {
+
+    memset(wk, 0, sizeof(*wk));
+    wk->visit = visit;
+    wk->data = data;
+    wk->threads = threads > 0 && threads <= WALK_MAX_THREADS ? threads : 1;
+
+    pthread_mutex_init(&wk->lock, NULL);
+    pthread_cond_init(&wk->wake, NULL);
+
+    for (int i = 0; i < WALK_MAX_THREADS; i++) {
+
+        wk->workers[i].walk = wk;
+        wk->workers[i].index = i;
+        pthread_mutex_init(&wk->workers[i].queue.lock, NULL);
+    }
+}
+
+static int queue_push(walk_queue *q, void *task) {
+
+    pthread_mutex_lock(&q->lock);
+
+    if (q->tail == q->capacity) {
+
+        if (q->head > 0) {
+
+            memmove(q->items, q->items + q->head, (q->tail - q->head) * sizeof(void *));
+            q->tail -= q->head;
+            q->head = 0;
+
+        } else {
+
+            int capacity = q->capacity ? q->capacity * 2 : 64;
+            void **items = realloc(q->items, capacity * sizeof(void *));
+
+            if (!items) {
+
+                pthread_mutex_unlock(&q->lock);
+                return -1;
+            }
+
+            q->items = items;
+            q->capacity = capacity;
+        }
+    }
+
+    q->items[q->tail++] = task;
+    pthread_mutex_unlock(&q->lock);
+    return 0;
+}
+
+static void *queue_take(walk_queue *q, int steal) {
+
+    void *task = NULL;
+
+    pthread_mutex_lock(&q->lock);
+
+    if (q->head < q->tail) {
+        task = steal ? q->items[q->head++] : q->items[--q->tail];
+    }
+
+    if (q->head == q->tail) {
+        q->head = q->tail = 0;
+    }
+
+    pthread_mutex_unlock(&q->lock);
+    return task;
+}
+
+int walk_push(walk_worker *w, void *task) {
+
+    walk *wk = w->walk;
+
+    /* counted first, the task may be taken and visited before queue_push() even returns */
+    __atomic_add_fetch(&wk->outstanding, 1, __ATOMIC_SEQ_CST);
+    __atomic_add_fetch(&wk->queued, 1, __ATOMIC_SEQ_CST);
+
+    if (queue_push(&w->queue, task) != 0) {
+
+        __atomic_sub_fetch(&wk->queued, 1, __ATOMIC_SEQ_CST);
+        __atomic_sub_fetch(&wk->outstanding, 1, __ATOMIC_SEQ_CST);
+        return -1;
+    }
+
+    /* an idle worker either sees queued go up before it sleeps or gets this signal */
+    if (__atomic_load_n(&wk->idle, __ATOMIC_SEQ_CST) > 0) {
+
+        pthread_mutex_lock(&wk->lock);
+        pthread_cond_signal(&wk->wake);
+        pthread_mutex_unlock(&wk->lock);
+    }
+
+    return 0;
+}
+
+static void *walk_next(walk_worker *w) {
+
+    walk *wk = w->walk;
+
+    for (;;) {
+
+        if (__atomic_load_n(&wk->cancel, __ATOMIC_RELAXED)) {
+            return NULL;
+        }
+
+        void *task = queue_take(&w->queue, 0);
+
+        for (int i = 1; !task && i < wk->threads; i++) {
+            task = queue_take(&wk->workers[(w->index + i) % wk->threads].queue, 1);
+        }
+
+        if (task) {
+
+            __atomic_sub_fetch(&wk->queued, 1, __ATOMIC_SEQ_CST);
+            return task;
+        }
+
+        /* nothing to steal, sleep until some worker pushes or the last task is visited */
+        pthread_mutex_lock(&wk->lock);
+        __atomic_add_fetch(&wk->idle, 1, __ATOMIC_SEQ_CST);
+
+        while (!__atomic_load_n(&wk->cancel, __ATOMIC_SEQ_CST) &&
+               __atomic_load_n(&wk->queued, __ATOMIC_SEQ_CST) == 0 &&
+               __atomic_load_n(&wk->outstanding, __ATOMIC_SEQ_CST) > 0) {
+            pthread_cond_wait(&wk->wake, &wk->lock);
+        }
+
+        __atomic_sub_fetch(&wk->idle, 1, __ATOMIC_SEQ_CST);
+        pthread_mutex_unlock(&wk->lock);
+
+        if (__atomic_load_n(&wk->outstanding, __ATOMIC_SEQ_CST) == 0) {
+            return NULL;
+        }
+    }
+}
+
+static void *walk_thread(void *arg) {
+
+    walk_worker *w = arg;
+    walk *wk = w->walk;
+    void *task;
+
+    while ((task = walk_next(w)) != NULL) {
+
+        wk->visit(w, task);
+
+        /* the last task wakes everyone up to leave */
+        if (__atomic_sub_fetch(&wk->outstanding, 1, __ATOMIC_SEQ_CST) == 0) {
+
+            pthread_mutex_lock(&wk->lock);
+            pthread_cond_broadcast(&wk->wake);
+            pthread_mutex_unlock(&wk->lock);
+        }
+    }
+
+    return NULL;
+}
+
+int walk_start(walk *wk, void *root) {
+
+    if (walk_push(&wk->workers[0], root) != 0) {
+        return -1;
+    }
+
+    int started = 0;
+
+    for (int i = 0; i < wk->threads; i++) {
+
+        walk_worker *w = &wk->workers[i];
+
+        w->buf = malloc(GETDENTS_BUF_SIZE);
+        w->started = w->buf && pthread_create(&w->thread, NULL, walk_thread, w) == 0;
+        started += w->started;
+    }
+
+    if (started == 0) {
+
+        /* nobody is going to visit it */
+        __atomic_store_n(&wk->outstanding, 0, __ATOMIC_SEQ_CST);
+        return -1;
+    }
+
+    return 0;
+}
+
+int walk_running(walk *wk) {
+
+    return __atomic_load_n(&wk->outstanding, __ATOMIC_ACQUIRE) > 0 && !walk_cancelled(wk);
+}
+
+int walk_cancelled(walk *wk) {
+
+    return __atomic_load_n(&wk->cancel, __ATOMIC_RELAXED);
+}
+
+void walk_cancel(walk *wk) {
+
+    __atomic_store_n(&wk->cancel, 1, __ATOMIC_SEQ_CST);
+
+    pthread_mutex_lock(&wk->lock);
+    pthread_cond_broadcast(&wk->wake);
+    pthread_mutex_unlock(&wk->lock);
+}
+
+void walk_join(walk *wk) {
+
+    if (wk->joined) {
+        return;
+    }
+
+    for (int i = 0; i < wk->threads; i++) {
+        if (wk->workers[i].started) {
+            pthread_join(wk->workers[i].thread, NULL);
+        }
+    }
+
+    wk->joined = 1;
+}
+
+void walk_free(walk *wk) {
+
+    walk_cancel(wk);
+    walk_join(wk);
+
+    for (int i = 0; i < WALK_MAX_THREADS; i++) {
+
+        walk_worker *w = &wk->workers[i];
+
+        pthread_mutex_destroy(&w->queue.lock);
+        free(w->queue.items);
+        arena_free(&w->arena);
+        free(w->buf);
+    }
+
+    pthread_mutex_destroy(&wk->lock);
+    pthread_cond_destroy(&wk->wake);
+}
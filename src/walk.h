@@ -0,0 +1,72 @@
+#ifndef WALK_H
+#define WALK_H
+
+#include "arena.h"
+#include <pthread.h>
+
+/* a pool of threads walking a directory tree. every task (a directory, in whatever form the user
+ * of the walk likes) is visited once by some worker, which pushes the tasks it finds. workers go
+ * depth first through their own queue and steal from the head of the others' when it runs dry,
+ * where the directories closest to the root and so the most work sit. */
+
+#define WALK_MAX_THREADS 64
+
+typedef struct walk walk;
+
+typedef struct walk_queue {
+    pthread_mutex_t lock;
+    void **items;
+    int head, tail, capacity;
+} walk_queue;
+
+typedef struct walk_worker {
+    walk *walk;
+    pthread_t thread;
+    int started;
+    int index;
+    walk_queue queue;
+    arena arena; /* for tasks and whatever else the visits need, lives as long as the walk */
+    char *buf;   /* GETDENTS_BUF_SIZE bytes for getdents64 */
+} walk_worker;
+
+typedef void (*walk_visit)(walk_worker *w, void *task);
+
+struct walk {
+    walk_visit visit;
+    void *data; /* for the visits */
+    int threads;
+    int joined;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    int queued;      /* tasks sitting in queues, atomic */
+    int outstanding; /* tasks not visited yet, atomic */
+    int idle;        /* workers waiting on wake, atomic */
+    int cancel;      /* atomic */
+    walk_worker workers[WALK_MAX_THREADS];
+};
+
+/* `configured` threads, or four per online CPU for 0: walking is mostly waiting for the disk */
+int walk_threads(int configured);
+
+void walk_init(walk *wk, int threads, walk_visit visit, void *data);
+
+/* queues a task found by worker w. returns -1 if memory ran out, the task is then never visited */
+int walk_push(walk_worker *w, void *task);
+
+/* starts the workers on root, returns -1 if not a single one could be started */
+int walk_start(walk *wk, void *root);
+
+/* 1 until every task was visited or the walk was cancelled */
+int walk_running(walk *wk);
+int walk_cancelled(walk *wk);
+
+/* stops handing out tasks, visits that already started run to their end */
+void walk_cancel(walk *wk);
+
+/* waits for the workers to leave, right away once the walk is no longer running */
+void walk_join(walk *wk);
+
+/* cancels, joins and frees everything the workers allocated */
+void walk_free(walk *wk);
+
+#endif
@@ -0,0 +1,405 @@
+/* Copyright 2025 Henryk Szenkowicz Holtman
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files(the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in all copies
+    or
+    substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED “AS IS”,
+    WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "watch.h"
+#include "config.h"
+#include "native.h"
+#include <fcntl.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define WATCH_EVENTS (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB | \
+                      IN_CLOSE_WRITE | IN_MODIFY | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR)
+#define WATCH_IDLE_POLL_MS 250
+
+/* replaced entries stay in the listing's arena until it is repacked, which happens once they take
+ * up half of it and at least this much */
+#define WATCH_REPACK_MIN_BYTES (64 * 1024)
+
+struct ls_watch {
+    int wd;
+    int dfd;
+    char *path;
+    char **names; /* changed since the last update, each name once */
+    int name_count, name_capacity;
+    int reload; /* too many events or a queue overflow, re-read everything */
+    struct timespec first_event, last_event;
+};
+
+/* one inotify instance for the whole program, only the current directory is ever watched */
+static int inotify_fd = -1;
+
+static long ms_since(const struct timespec *since) {
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - since->tv_sec) * 1000 + (now.tv_nsec - since->tv_nsec) / 1000000;
+}
+
+int listing_watch(ls_listing *listing, const char *path) {
+
+    if (!USE_INOTIFY) {
+        return -1;
+    }
+
+    if (inotify_fd < 0) {
+
+        inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (inotify_fd < 0) {
+            return -1;
+        }
+    }
+
+    struct ls_watch *w = calloc(1, sizeof(struct ls_watch));
+
+    w->wd = inotify_add_watch(inotify_fd, path, WATCH_EVENTS);
+    w->dfd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+    if (w->wd < 0 || w->dfd < 0) {
+
+        if (w->wd >= 0) {
+            inotify_rm_watch(inotify_fd, w->wd);
+        }
+        if (w->dfd >= 0) {
+            close(w->dfd);
+        }
+        free(w);
+        return -1;
+    }
+
+    w->path = strdup(path);
+    listing->watch = w;
+    return 0;
+}
+
+static void clear_names(struct ls_watch *w) {
+
+    for (int i = 0; i < w->name_count; i++) {
+        free(w->names[i]);
+    }
+
+    w->name_count = 0;
+}
+
+void listing_unwatch(ls_listing *listing) {
+
+    struct ls_watch *w = listing->watch;
+    if (!w) {
+        return;
+    }
+
+    inotify_rm_watch(inotify_fd, w->wd);
+    close(w->dfd);
+    clear_names(w);
+    free(w->names);
+    free(w->path);
+    free(w);
+    listing->watch = NULL;
+}
+
+static void queue_name(struct ls_watch *w, const char *name) {
+
+    if (w->name_count == 0 && !w->reload) {
+        clock_gettime(CLOCK_MONOTONIC, &w->first_event);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &w->last_event);
+
+    if (w->reload) {
+        return;
+    }
+
+    for (int i = 0; i < w->name_count; i++) {
+
+        if (strcmp(w->names[i], name) == 0) {
+            return;
+        }
+    }
+
+    /* past this point patching entries one by one costs more than listing the directory again */
+    if (w->name_count >= WATCH_STORM_EVENTS) {
+
+        clear_names(w);
+        w->reload = 1;
+        return;
+    }
+
+    if (w->name_count >= w->name_capacity) {
+
+        int capacity = w->name_capacity ? w->name_capacity * 2 : 16;
+        char **grown = realloc(w->names, capacity * sizeof(char *));
+
+        if (!grown) {
+
+            /* the name is lost, listing everything again picks it up */
+            w->reload = 1;
+            return;
+        }
+
+        w->names = grown;
+        w->name_capacity = capacity;
+    }
+
+    char *copy = strdup(name);
+    if (!copy) {
+
+        w->reload = 1;
+        return;
+    }
+
+    w->names[w->name_count++] = copy;
+}
+
+static void read_events(struct ls_watch *w) {
+
+    char buf[16 * (sizeof(struct inotify_event) + NAME_MAX + 1)]
+        __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    while (1) {
+
+        ssize_t len = read(inotify_fd, buf, sizeof(buf));
+        if (len <= 0) {
+            break;
+        }
+
+        for (char *p = buf; p < buf + len;) {
+
+            struct inotify_event *ev = (struct inotify_event *)p;
+            p += sizeof(struct inotify_event) + ev->len;
+
+            if (ev->mask & IN_Q_OVERFLOW) {
+
+                queue_name(w, ".");
+                clear_names(w);
+                w->reload = 1;
+                continue;
+            }
+
+            /* leftovers from the previously watched directory */
+            if (ev->wd != w->wd) {
+                continue;
+            }
+
+            if (ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+
+                w->reload = 1;
+                continue;
+            }
+
+            queue_name(w, ev->len > 0 ? ev->name : ".");
+        }
+    }
+}
+
+/* copies the live names into a fresh arena and drops the old one with everything replaced in it */
+static void repack_listing(ls_listing *listing) {
+
+    ls_table *t = &listing->table;
+    arena packed = {0};
+
+    for (int i = 0; i < t->count; i++) {
+        t->fname[i] = arena_strndup(&packed, t->fname[i], strlen(t->fname[i]));
+    }
+
+    arena_free(&t->arena);
+    t->arena = packed;
+    listing->garbage = 0;
+}
+
+/* re-stats one name and replaces, inserts or removes its row. rows are formatted when they are drawn,
+ * so a wider entry just widens the columns. returns -1 if memory runs out */
+static int apply_name(ls_listing *listing, struct ls_watch *w, const char *name, int *selected) {
+
+    ls_table *t = &listing->table;
+    native_entry ne = {0};
+    ne.name = (char *)name;
+
+    stat_native_entries(w->dfd, &ne, 1);
+
+    int insert_at = 0;
+    int index = listing_find(&listing->table, name, &insert_at);
+
+    if (!ne.stat_ok) {
+
+        free(ne.link_target);
+
+        if (index < 0) {
+            return 0;
+        }
+
+        listing->garbage += strlen(t->fname[index]) + 1;
+        table_remove_row(t, index);
+
+        if (index < *selected) {
+            (*selected)--;
+        }
+
+        return 0;
+    }
+
+    measure_widths(&ne, 1, t->widths);
+
+    if (index >= 0) {
+
+        listing->garbage += strlen(t->fname[index]) + 1;
+
+    } else if (table_insert_rows(t, insert_at, 1) != 0) {
+
+        free(ne.link_target);
+        return -1;
+    }
+
+    int row = index >= 0 ? index : insert_at;
+    int ret = store_native_entry(t, row, &ne, &t->arena);
+    free(ne.link_target);
+
+    if (ret != 0) {
+
+        /* keep the row valid, the reload this triggers replaces it anyway */
+        t->fname[row] = (char *)"";
+        t->name_len[row] = 0;
+        return -1;
+    }
+
+    if (index < 0 && insert_at <= *selected && *selected < t->count - 1) {
+        (*selected)++;
+    }
+
+    return 0;
+}
+
+/* a symlink shows the -F mark of its target, so it changes when a target in this directory does */
+static int refresh_links_to_names(ls_listing *listing, struct ls_watch *w, int *selected) {
+
+    const ls_table *t = &listing->table;
+
+    for (int i = 0; i < t->count; i++) {
+
+        /* a link whose target could not be read ends at its name */
+        if (t->type[i] != file_link || strncmp(t->fname[i] + t->name_len[i], " -> ", strlen(" -> ")) != 0) {
+            continue;
+        }
+
+        const char *target = t->fname[i] + t->name_len[i] + strlen(" -> ");
+        size_t target_len = strlen(target);
+
+        for (int n = 0; n < w->name_count; n++) {
+
+            size_t len = strlen(w->names[n]);
+
+            if (strncmp(target, w->names[n], len) == 0 && (target_len == len || target_len == len + 1)) {
+
+                char name[NAME_MAX + 1];
+                int name_len = t->name_len[i] < NAME_MAX ? t->name_len[i] : NAME_MAX;
+
+                memcpy(name, t->fname[i], name_len);
+                name[name_len] = '\0';
+
+                if (apply_name(listing, w, name, selected) != 0) {
+                    return -1;
+                }
+                break;
+            }
+        }
+    }
+
+    return 0;
+}
+
+int listing_watch_timeout(const ls_listing *listing) {
+
+    const struct ls_watch *w = listing->watch;
+    if (!w) {
+        return -1;
+    }
+
+    if (w->name_count == 0 && !w->reload) {
+        return WATCH_IDLE_POLL_MS;
+    }
+
+    long wait = WATCH_DEBOUNCE_MS - ms_since(&w->last_event);
+    return wait > 0 ? (int)wait : 1;
+}
+
+int listing_watch_poll(ls_listing *listing, int *selected) {
+
+    struct ls_watch *w = listing->watch;
+    if (!w) {
+        return 0;
+    }
+
+    read_events(w);
+
+    /* changes that arrive while loading are applied on top of the finished listing */
+    if (listing->loading || (w->name_count == 0 && !w->reload)) {
+        return 0;
+    }
+
+    /* wait for a burst to settle, but never let a steady stream of events starve the screen */
+    if (ms_since(&w->last_event) < WATCH_DEBOUNCE_MS && ms_since(&w->first_event) < WATCH_MAX_DELAY_MS) {
+        return 0;
+    }
+
+    int reload = w->reload || !listing->table.native;
+
+    if (!reload) {
+
+        /* "." changes with every entry that comes or goes */
+        queue_name(w, ".");
+        reload = w->reload;
+
+        /* a file touched just now would otherwise be dated as if it came from the future */
+        listing->table.now = time(NULL);
+
+        for (int i = 0; i < w->name_count; i++) {
+
+            if (apply_name(listing, w, w->names[i], selected) != 0) {
+
+                reload = 1;
+                break;
+            }
+        }
+    }
+
+    if (!reload) {
+        reload = refresh_links_to_names(listing, w, selected) != 0;
+    }
+
+    clear_names(w);
+    w->reload = 0;
+
+    if (reload) {
+
+        /* listing_open() replaces this watch, keep the path alive across it */
+        char *path = strdup(w->path);
+        listing_open(listing, path, *selected);
+        free(path);
+        return 1;
+    }
+
+    if (listing->garbage >= WATCH_REPACK_MIN_BYTES && listing->garbage * 2 >= listing->table.arena.used) {
+        repack_listing(listing);
+    }
+
+    /* the listing now matches the directory again, so it can be cached under its new state */
+    struct stat st;
+    if (fstat(w->dfd, &st) == 0) {
+        listing_rekey(listing, &st);
+    }
+
+    return 1;
+}
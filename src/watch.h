@@ -0,0 +1,19 @@
+#ifndef WATCH_H
+#define WATCH_H
+
+#include "listing.h"
+
+/* keeps an open listing in step with its directory through inotify, so changes made by tired or by
+ * anyone else show up as in-place updates instead of a full reload */
+
+int listing_watch(ls_listing *listing, const char *path);
+
+/* reads pending events and applies them once they settle. returns 1 if the listing changed */
+int listing_watch_poll(ls_listing *listing, int *selected);
+
+/* milliseconds until listing_watch_poll() should run again, -1 if the listing is not watched */
+int listing_watch_timeout(const ls_listing *listing);
+
+void listing_unwatch(ls_listing *listing);
+
+#endif
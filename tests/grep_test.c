@@ -0,0 +1,120 @@
+/* Copyright 2025 Henryk Szenkowicz Holtman
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files(the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in all copies
+    or
+    substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED “AS IS”,
+    WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "../src/grep.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int failed;
+
+static int count_hit(void *ctx, long line, const char *text, size_t len) {
+
+    (void)line;
+    (void)len;
+    *(long *)ctx += text != NULL;
+    return 0;
+}
+
+/* adds up the line numbers of the hits, and gives up at the first chance when ctx[1] is set */
+static int sum_lines(void *ctx, long line, const char *text, size_t len) {
+
+    long *sum = ctx;
+    (void)len;
+
+    if (!text) {
+        return sum[1] != 0;
+    }
+
+    sum[0] += line;
+    return 0;
+}
+
+/* the lines of text matching pattern as an extended regex (not checked if lines < 0), and the literal
+ * it was prefiltered on */
+static void expect(const char *pattern, const char *text, long lines, const char *literal) {
+
+    grep_pattern p;
+
+    if (grep_compile(&p, pattern, 1) != 0) {
+
+        printf("FAIL %s: does not compile\n", pattern);
+        failed++;
+        return;
+    }
+
+    long hits = 0;
+    grep_buffer(&p, text, strlen(text), count_hit, &hits);
+
+    if ((lines >= 0 && hits != lines) || strcmp(p.literal, literal) != 0) {
+
+        printf("FAIL %s: %ld lines (expected %ld), literal '%s' (expected '%s')\n", pattern, hits, lines, p.literal,
+               literal);
+        failed++;
+    }
+
+    grep_free(&p);
+}
+
+int main(void) {
+
+    const char *text = "foo bar\nfood\nbar foo\n<foo>\nint x;\nprint\n";
+
+    /* word boundaries match no character, the literal is what lies between them */
+    expect("\\<foo\\>", text, 3, "foo");
+    expect("\\<int", text, 1, "int");
+
+    /* \` and \' anchor to the buffer, glibc decides where that is with REG_STARTEND */
+    expect("\\`foo", text, -1, "foo");
+    expect("foo\\'", text, -1, "foo");
+
+    expect("fo+d", text, 1, "");
+    expect("bar foo", text, 1, "bar foo");
+    expect("a|b", text, 2, "");
+
+    /* a few MB are searched in chunks, line numbers carry over and the search can stop in between */
+    size_t size = 0, cap = 4 * 1024 * 1024;
+    char *big = malloc(cap);
+    long expected = 0;
+
+    for (long line = 1; big && size + 64 < cap; line++) {
+
+        size += sprintf(big + size, line % 1000 ? "line %ld\n" : "line %ld needle\n", line);
+        expected += line % 1000 ? 0 : line;
+    }
+
+    for (int regex = 0; big && regex < 2; regex++) {
+
+        grep_pattern p;
+        long sum[2] = {0, 0}, stopped[2] = {0, 1};
+
+        if (grep_compile(&p, regex ? "ne+dle$" : "needle", regex) == 0) {
+
+            grep_buffer(&p, big, size, sum_lines, sum);
+            grep_buffer(&p, big, size, sum_lines, stopped);
+            grep_free(&p);
+        }
+
+        /* the first chunk is searched before the first question */
+        if (sum[0] != expected || stopped[0] >= expected / 2) {
+
+            printf("FAIL chunks (%s): line numbers add up to %ld (expected %ld), %ld after stopping\n",
+                   regex ? "regex" : "literal", sum[0], expected, stopped[0]);
+            failed++;
+        }
+    }
+
+    free(big);
+
+    printf("%s\n", failed ? "grep tests failed" : "grep tests passed");
+    return failed != 0;
+}
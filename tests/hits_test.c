@@ -0,0 +1,224 @@
+/* Copyright 2025 Henryk Szenkowicz Holtman
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files(the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in all copies
+    or
+    substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED “AS IS”,
+    WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "../src/hits.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int failed;
+
+/* xorshift, every run goes through the same rows */
+static unsigned long long state = 88172645463325252ULL;
+
+static unsigned next_random(void) {
+
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return (unsigned)(state >> 32);
+}
+
+static const char letters[] = "abcd.";
+
+static void insert_rows(ls_table *t, int at, int n) {
+
+    if (table_insert_rows(t, at, n) != 0) {
+
+        printf("FAIL out of memory\n");
+        exit(1);
+    }
+
+    for (int row = at; row < at + n; row++) {
+
+        char name[16];
+        int len = 1 + next_random() % 8;
+
+        for (int i = 0; i < len; i++) {
+            name[i] = letters[next_random() % (sizeof(letters) - 1)];
+        }
+
+        t->fname[row] = arena_strndup(&t->arena, name, len);
+        t->name_len[row] = len;
+    }
+}
+
+/* insertions of up to two words of rows, so the bits shift across word boundaries by any amount,
+ * and single row removals, which is all the table makes. the table stays around a few thousand rows */
+static void change_rows(ls_table *t, int n) {
+
+    for (int i = 0; i < n; i++) {
+
+        if (t->count < 200 || next_random() % (t->count < 3000 ? 2 : 64) == 0) {
+
+            int at = next_random() % (t->count + 1);
+
+            /* right at or next to a word boundary now and then */
+            if (next_random() % 4 == 0) {
+                at = (at / 64) * 64 + (int)(next_random() % 3) - 1;
+                at = at < 0 ? 0 : at > t->count ? t->count : at;
+            }
+
+            insert_rows(t, at, 1 + next_random() % 130);
+
+        } else {
+
+            table_remove_row(t, next_random() % t->count);
+        }
+    }
+}
+
+static int matches(const ls_table *t, int row, const char *query) {
+
+    int positions[FUZZY_MAX_QUERY];
+    return fuzzy_positions(t->fname[row], t->name_len[row], query, positions) >= 0;
+}
+
+/* brings h up to date with t and compares every bit with matching every row again */
+static void check(ls_hits *h, const ls_table *t, const char *query, const char *what) {
+
+    if (hits_update(h, t) != 0) {
+
+        printf("FAIL %s: update failed\n", what);
+        failed++;
+        return;
+    }
+
+    int count = 0;
+
+    for (int row = 0; row < t->count; row++) {
+
+        int want = matches(t, row, query);
+        count += want;
+
+        if (hits_test(h, row) != want) {
+
+            printf("FAIL %s: row %d of %d ('%.*s') is %s\n", what, row, t->count, t->name_len[row], t->fname[row],
+                   want ? "missing" : "a hit");
+            failed++;
+            return;
+        }
+    }
+
+    /* the bits past the rows stay zero, or they would come back when rows open */
+    for (int row = t->count; row < h->words * 64; row++) {
+
+        if (h->bits[row / 64] >> (row % 64) & 1) {
+
+            printf("FAIL %s: bit %d set past %d rows\n", what, row, t->count);
+            failed++;
+            return;
+        }
+    }
+
+    if (h->rows != t->count || h->count != count) {
+
+        printf("FAIL %s: %d rows and %d hits (expected %d and %d)\n", what, h->rows, h->count, t->count, count);
+        failed++;
+        return;
+    }
+
+    /* in name order a jump goes to the next hit after the cursor, round the end */
+    ls_listing listing;
+    memset(&listing, 0, sizeof(listing));
+    listing.table = *t;
+
+    int selected = t->count ? (int)(next_random() % t->count) : 0;
+    int want = -1;
+
+    for (int i = 1; i <= t->count && want < 0; i++) {
+
+        int row = (selected + i) % t->count;
+        if (matches(t, row, query)) {
+            want = row;
+        }
+    }
+
+    int got = hits_next(h, &listing, selected, 1);
+
+    if (got != want) {
+
+        printf("FAIL %s: next hit after %d is %d (expected %d)\n", what, selected, got, want);
+        failed++;
+    }
+}
+
+int main(void) {
+
+    /* about half of the names hold it, so both set and clear bits move */
+    const char *query = "a";
+
+    ls_table t;
+    table_init(&t, 1);
+    insert_rows(&t, 0, 1000);
+
+    /* the finder hands over the rows it matched */
+    int *rows = malloc(t.count * sizeof(int));
+    int count = 0;
+
+    for (int row = 0; row < t.count; row++) {
+        if (matches(&t, row, query)) {
+            rows[count++] = row;
+        }
+    }
+
+    ls_hits h;
+    hits_init(&h);
+
+    if (hits_set(&h, &t, query, rows, count) != 0) {
+
+        printf("FAIL set: out of memory\n");
+        failed++;
+    }
+
+    free(rows);
+    check(&h, &t, query, "set");
+
+    /* a few changes at a time are followed through the log */
+    for (int round = 0; round < 2000; round++) {
+
+        change_rows(&t, 1 + next_random() % 6);
+        check(&h, &t, query, "replay");
+    }
+
+    /* shrunk by single rows to a few words and grown back */
+    while (t.count > 150) {
+
+        for (int i = 0; i < 40 && t.count > 0; i++) {
+            table_remove_row(&t, next_random() % t.count);
+        }
+        check(&h, &t, query, "removals");
+    }
+
+    change_rows(&t, 50);
+    check(&h, &t, query, "regrown");
+
+    /* more changes than the table's log holds, everything is matched again */
+    for (int i = 0; i < 1100; i++) {
+
+        if (next_random() % 2) {
+            insert_rows(&t, next_random() % (t.count + 1), 1);
+        } else if (t.count > 0) {
+            table_remove_row(&t, next_random() % t.count);
+        }
+    }
+    check(&h, &t, query, "log overflow");
+
+    change_rows(&t, 4);
+    check(&h, &t, query, "replay after overflow");
+
+    hits_free(&h);
+    table_free(&t);
+
+    printf("%s\n", failed ? "hits tests failed" : "hits tests passed");
+    return failed != 0;
+}
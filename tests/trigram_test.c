@@ -0,0 +1,220 @@
+/* Copyright 2025 Henryk Szenkowicz Holtman
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files(the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in all copies
+    or
+    substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED “AS IS”,
+    WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "../src/trigram.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int failed;
+
+/* xorshift, every run goes through the same rows */
+static unsigned long long state = 88172645463325252ULL;
+
+static unsigned next_random(void) {
+
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return (unsigned)(state >> 32);
+}
+
+/* few letters, so names share their runs and most needles match something */
+static const char letters[] = "abcAB.";
+
+static void random_text(char *s, int len) {
+
+    for (int i = 0; i < len; i++) {
+        s[i] = letters[next_random() % (sizeof(letters) - 1)];
+    }
+    s[len] = '\0';
+}
+
+static char fold(char c) {
+
+    return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+}
+
+static void insert_rows(ls_table *t, int at, int n) {
+
+    if (table_insert_rows(t, at, n) != 0) {
+
+        printf("FAIL out of memory\n");
+        exit(1);
+    }
+
+    for (int row = at; row < at + n; row++) {
+
+        char name[16];
+        int len = 1 + next_random() % 10;
+
+        random_text(name, len);
+        t->fname[row] = arena_strndup(&t->arena, name, len);
+        t->name_len[row] = len;
+    }
+}
+
+/* n single row changes anywhere in the table, more insertions than removals while it is small */
+static void change_rows(ls_table *t, int n) {
+
+    for (int i = 0; i < n; i++) {
+
+        if (t->count < 100 || next_random() % 2) {
+            insert_rows(t, next_random() % (t->count + 1), 1 + next_random() % 3);
+        } else {
+            table_remove_row(t, next_random() % t->count);
+        }
+    }
+}
+
+/* what the index is there to avoid: every name read in full */
+static int contains(const char *name, int len, const char *needle, int n) {
+
+    for (int i = 0; i + n <= len; i++) {
+
+        int j = 0;
+        while (j < n && fold(name[i + j]) == fold(needle[j])) {
+            j++;
+        }
+
+        if (j == n) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/* brings ix up to date with t and compares its answers with a linear scan */
+static void check(trigram_index *ix, const ls_table *t, const char *what) {
+
+    if (trigram_update(ix, t) != 0) {
+
+        printf("FAIL %s: update failed\n", what);
+        failed++;
+        return;
+    }
+
+    for (int row = 0; row < t->count; row++) {
+
+        const char *folded = trigram_folded(ix, row);
+
+        for (int i = 0; i <= t->name_len[row]; i++) {
+
+            if (folded[i] != (i < t->name_len[row] ? fold(t->fname[row][i]) : '\0')) {
+
+                printf("FAIL %s: row %d folds to '%s', its name is '%.*s'\n", what, row, folded, t->name_len[row],
+                       t->fname[row]);
+                failed++;
+                return;
+            }
+        }
+    }
+
+    int *rows = malloc((t->count + 1) * sizeof(int));
+    int *found = calloc(t->count + 1, sizeof(int));
+
+    for (int k = 0; k < 40; k++) {
+
+        char needle[8];
+        int len = 1 + next_random() % 5;
+        random_text(needle, len);
+
+        int n = trigram_search(ix, needle, len, rows);
+        memset(found, 0, t->count * sizeof(int));
+
+        for (int i = 0; i < n; i++) {
+
+            if (rows[i] < 0 || rows[i] >= t->count) {
+
+                printf("FAIL %s: '%s' found row %d of %d\n", what, needle, rows[i], t->count);
+                failed++;
+                goto done;
+            }
+
+            found[rows[i]]++;
+        }
+
+        for (int row = 0; row < t->count; row++) {
+
+            if (found[row] != contains(t->fname[row], t->name_len[row], needle, len)) {
+
+                printf("FAIL %s: '%s' found row %d ('%.*s') %d times\n", what, needle, row, t->name_len[row],
+                       t->fname[row], found[row]);
+                failed++;
+                goto done;
+            }
+        }
+    }
+
+done:
+    free(rows);
+    free(found);
+}
+
+int main(void) {
+
+    ls_table t;
+    table_init(&t, 1);
+    insert_rows(&t, 0, 3000);
+
+    trigram_index *ix = trigram_new();
+    check(ix, &t, "build");
+
+    /* a few changes at a time are replayed on the row map */
+    for (int round = 0; round < 200; round++) {
+
+        change_rows(&t, 1 + next_random() % 8);
+        check(ix, &t, "replay");
+    }
+
+    /* removed names pile up in the posting lists until half of them are dead */
+    while (t.count > 600) {
+
+        for (int i = 0; i < 200; i++) {
+            table_remove_row(&t, next_random() % t.count);
+        }
+        check(ix, &t, "removals");
+    }
+
+    /* too many changes to replay, then more than the table's log holds */
+    change_rows(&t, 300);
+    check(ix, &t, "many changes");
+
+    change_rows(&t, 1100);
+    check(ix, &t, "log overflow");
+
+    /* reordered rows start the log over */
+    int *order = malloc(t.count * sizeof(int));
+    for (int i = 0; i < t.count; i++) {
+        order[i] = i;
+    }
+    for (int i = t.count - 1; i > 0; i--) {
+
+        int j = next_random() % (i + 1), swap = order[i];
+        order[i] = order[j];
+        order[j] = swap;
+    }
+
+    table_permute(&t, order);
+    free(order);
+    check(ix, &t, "permuted");
+
+    change_rows(&t, 5);
+    check(ix, &t, "replay after permute");
+
+    trigram_free(ix);
+    table_free(&t);
+
+    printf("%s\n", failed ? "trigram tests failed" : "trigram tests passed");
+    return failed != 0;
+}